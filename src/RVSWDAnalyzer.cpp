@@ -24,24 +24,46 @@ void RVSWDAnalyzer::SetupResults()
     SetAnalyzerResults( mResults.get() );
 
     // set which channels will carry bubbles
-    mResults->AddChannelBubblesWillAppearOn( mSettings.mDIO );
-    mResults->AddChannelBubblesWillAppearOn( mSettings.mCLK );
+    for( U32 bus = 0; bus < mSettings.mNumBuses; ++bus )
+    {
+        mResults->AddChannelBubblesWillAppearOn( mSettings.mDIO[ bus ] );
+        mResults->AddChannelBubblesWillAppearOn( mSettings.mCLK[ bus ] );
+    }
 }
 
 void RVSWDAnalyzer::WorkerThread()
 {
+    // several buses are decoded on threads of their own and merged
+    if( mSettings.mNumBuses > 1 )
+    {
+        mMultiBusDecoder.Run( this, mResults.get() );
+        return;
+    }
+
     // SetupResults();
     // get the channel pointers
-    mDIO = GetAnalyzerChannelData( mSettings.mDIO );
-    mCLK = GetAnalyzerChannelData( mSettings.mCLK );
+    mDIO = GetAnalyzerChannelData( mSettings.mDIO[ 0 ] );
+    mCLK = GetAnalyzerChannelData( mSettings.mCLK[ 0 ] );
+
+    // what we decode is counted, and the counters go to the results with the frames
+    mCaptureStats.Clear();
+
+    // frames and markers are staged and committed in batches
+    mResultStage.Setup( mResults.get(), this, &mCaptureStats );
 
-    mRVSWDParser.Setup( mDIO, mCLK, this );
+    mDIOChannel.Setup( mDIO );
+    mCLKChannel.Setup( mCLK );
 
-    // these are our three objects that SWDParser will fill with data
+    mRVSWDParser.Setup( &mDIOChannel, &mCLKChannel, &mResultStage );
+
+    // these are our two objects that SWDParser will fill with data
     // on calls to IsOperation or IsLineReset
     RVSWDOperation tran;
     RVSWDLineReset reset;
-    RVSWDBit error_bit;
+    RVSWDIdle idle;
+
+    // every operation and line reset is a packet, and the memory accesses are transactions
+    RVSWDTransactionTracker transactions;
 
     mRVSWDParser.Clear();
 
@@ -52,28 +74,45 @@ void RVSWDAnalyzer::WorkerThread()
     // A valid line reset has at least 50 high bits in succession.
     for( ;; )
     {
-        if( mRVSWDParser.IsOperation( tran ) )
+        if( mRVSWDParser.IsIdle( idle ) )
         {
-            tran.AddFrames( mResults.get() );
-            tran.AddMarkers( mResults.get() );
+            idle.AddFrames( &mResultStage );
+            mCaptureStats.AddIdle( idle );
 
-            mResults->CommitResults();
+            mResultStage.EndOperation( mCLK->GetSampleNumber() );
+        }
+        else if( mRVSWDParser.IsOperation( tran ) )
+        {
+            mResultStage.StartPacket();
+            tran.AddFrames( &mResultStage );
+            tran.AddMarkers( &mResultStage );
+            mResultStage.IndexOperation( tran );
+            mCaptureStats.AddOperation( tran );
+            mResultStage.EndPacket( transactions.AddOperation( tran ) );
+
+            mResultStage.EndOperation( mCLK->GetSampleNumber() );
         }
         else if( mRVSWDParser.IsLineReset( reset ) )
         {
-            reset.AddFrames( mResults.get() );
+            mResultStage.StartPacket();
+            reset.AddFrames( &mResultStage );
+            transactions.AddLineReset();
+            mCaptureStats.AddLineReset( reset );
+            mResultStage.EndPacket( RVSWDTransactionTracker::NO_TRANSACTION );
 
-            mResults->CommitResults();
+            mResultStage.EndOperation( mCLK->GetSampleNumber() );
         }
         else
         {
             // This is neither a valid transaction nor a valid reset,
-            // so remove the first bit and try again.
-            // We're dropping the error bit into oblivion.
-            error_bit = mRVSWDParser.PopFrontBit();
-        }
+            // so skip ahead to the next bit that can start one and try again.
+            // The skipped bits are dropped, only counted.
+            if( mRVSWDParser.HadDataParityError() )
+                mCaptureStats.AddParityError();
+            mCaptureStats.AddDropped( mRVSWDParser.SkipToCandidate() );
 
-        ReportProgress( mDIO->GetSampleNumber() );
+            mResultStage.ReportProgress( mCLK->GetSampleNumber() );
+        }
     }
 }
 
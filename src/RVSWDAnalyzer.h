@@ -2,12 +2,61 @@
 #define RVSWD_ANALYZER_H
 
 #include <Analyzer.h>
+#include <AnalyzerChannelData.h>
 
 #include "RVSWDAnalyzerSettings.h"
 #include "RVSWDAnalyzerResults.h"
 #include "RVSWDSimulationDataGenerator.h"
 
-#include "RVSWDTypes.h"
+#include "RVSWDParser.h"
+#include "RVSWDMultiBus.h"
+
+// hands the SDK's channel data to the parser
+class RVSWDAnalyzerChannel : public RVSWDChannel
+{
+  public:
+    RVSWDAnalyzerChannel() : mData( 0 )
+    {
+    }
+
+    void Setup( AnalyzerChannelData* pData )
+    {
+        mData = pData;
+    }
+
+    virtual U64 GetSampleNumber()
+    {
+        return mData->GetSampleNumber();
+    }
+
+    virtual BitState GetBitState()
+    {
+        return mData->GetBitState();
+    }
+
+    virtual void AdvanceToNextEdge()
+    {
+        mData->AdvanceToNextEdge();
+    }
+
+    virtual void AdvanceToAbsPosition( U64 sample_number )
+    {
+        mData->AdvanceToAbsPosition( sample_number );
+    }
+
+    virtual U64 GetSampleOfNextEdge()
+    {
+        return mData->GetSampleOfNextEdge();
+    }
+
+    virtual bool DoMoreTransitionsExistInCurrentData()
+    {
+        return mData->DoMoreTransitionsExistInCurrentData();
+    }
+
+  protected:
+    AnalyzerChannelData* mData;
+};
 
 class RVSWDAnalyzer : public Analyzer2
 {
@@ -23,6 +72,17 @@ class RVSWDAnalyzer : public Analyzer2
     virtual const char* GetAnalyzerName() const;
     virtual bool NeedsRerun();
 
+    const RVSWDStageStats& GetStageStats() const
+    {
+        return mResultStage.GetStats();
+    }
+
+    // only kept when more than one bus is decoded
+    const RVSWDMultiBusDecoder& GetMultiBusDecoder() const
+    {
+        return mMultiBusDecoder;
+    }
+
   protected: // vars
     RVSWDAnalyzerSettings mSettings;
     std::unique_ptr<RVSWDAnalyzerResults> mResults;
@@ -30,9 +90,16 @@ class RVSWDAnalyzer : public Analyzer2
     AnalyzerChannelData* mDIO;
     AnalyzerChannelData* mCLK;
 
+    RVSWDAnalyzerChannel mDIOChannel;
+    RVSWDAnalyzerChannel mCLKChannel;
+
     RVSWDSimulationDataGenerator mSimulationDataGenerator;
 
     RVSWDParser mRVSWDParser;
+    RVSWDResultStage mResultStage;
+    RVSWDCaptureStats mCaptureStats; // of the single bus, the result stage hands them to the results
+
+    RVSWDMultiBusDecoder mMultiBusDecoder;
 
     bool mSimulationInitilized;
 };
@@ -1,17 +1,23 @@
-#include <iostream>
-#include <fstream>
+#include <cstdio>
+#include <cstring>
 #include <algorithm>
-
-#include <AnalyzerHelpers.h>
+#include <functional>
+#include <chrono>
 
 #include "RVSWDAnalyzerResults.h"
 #include "RVSWDAnalyzer.h"
 #include "RVSWDAnalyzerSettings.h"
+#include "RVSWDExportFilter.h"
+#include "RVSWDMemoryImage.h"
+#include "RVSWDNumberFormat.h"
+#include "RVSWDOperationFile.h"
+#include "RVSWDTextExport.h"
 #include "RVSWDUtils.h"
 
 RVSWDAnalyzerResults::RVSWDAnalyzerResults( RVSWDAnalyzer* analyzer, RVSWDAnalyzerSettings* settings )
-    : mSettings( settings ), mAnalyzer( analyzer )
+    : mSettings( settings ), mAnalyzer( analyzer ), mIndexing( false )
 {
+    memset( &mExportStats, 0, sizeof( mExportStats ) );
 }
 
 RVSWDAnalyzerResults::~RVSWDAnalyzerResults()
@@ -25,53 +31,117 @@ double RVSWDAnalyzerResults::GetSampleTime( S64 sample ) const
 
 std::string RVSWDAnalyzerResults::GetSampleTimeStr( S64 sample ) const
 {
-    char time_str[ 128 ];
-    AnalyzerHelpers::GetTimeString( sample, mAnalyzer->GetTriggerSample(), mAnalyzer->GetSampleRate(), time_str, sizeof( time_str ) );
-
-    // remove trailing zeros
-    int l = strlen( time_str );
-    if( l > 7 )
-        time_str[ l - 7 ] = '\0';
+    char time_str[ TIME_STR_SIZE ];
+    FormatSampleTime( sample, mAnalyzer->GetTriggerSample(), mAnalyzer->GetSampleRate(), time_str );
 
     return time_str;
 }
 
-void RVSWDAnalyzerResults::GetBubbleText( const Frame& f, DisplayBase display_base, std::vector<std::string>& results )
+void RVSWDAnalyzerResults::GetFrameText( const Frame& f, DisplayBase display_base, std::string& text )
 {
-    results.clear();
-
-    std::string result;
+    text.clear();
 
     if( f.mType == RVSWDFT_Request )
     {
-        RVSWDRequestFrame& req( ( RVSWDRequestFrame& )f );
+        const RVSWDRequestFrame& req( ( const RVSWDRequestFrame& )f );
 
-        std::string addr_str( int2str_sal( req.GetAddr(), display_base, 4 ) );
-        std::string reg_name( req.GetRegisterName() );
+        text += "Request ";
+        text += req.IsAccessPort() ? " AccessPort" : " DebugPort";
+        text += req.IsRead() ? " Read " : " Write ";
+        text += req.GetRegisterName();
+    }
+    else if( f.mType == RVSWDFT_LineReset )
+    {
+        text += "Line Reset ";
+        text += int2str( f.mData1 );
+        text += " bits";
+    }
+    else if( f.mType == RVSWDFT_Turnaround )
+    {
+        text += "Turnaround";
+    }
+    else if( f.mType == RVSWDFT_ACK )
+    {
+        if( f.mData1 == ACK_OK )
+            text += "ACK OK";
+        else if( f.mData1 == ACK_WAIT )
+            text += "ACK WAIT";
+        else if( f.mData1 == ACK_FAULT )
+            text += "ACK FAULT";
+        else
+            text += "ACK <unknown> probably disconnected";
+    }
+    else if( f.mType == RVSWDFT_WData )
+    {
+        RVSWDRegisters reg( RVSWDRegisters( f.mData2 ) );
+        char number_str[ 128 ];
+        FormatNumber( f.mData1, display_base, 32, number_str, sizeof( number_str ) );
 
-        results.push_back( std::string( "Request " ) + ( req.IsAccessPort() ? " AccessPort" : " DebugPort" ) +
-                           ( req.IsRead() ? " Read" : " Write" ) + " " + reg_name );
+        text += "WData ";
+        text += number_str;
+        text += " reg ";
+        text += GetRegisterName( reg );
+
+        char reg_value[ REGISTER_DESC_SIZE ];
+        if( FormatRegisterValue( reg, U32( f.mData1 ), display_base, reg_value, sizeof( reg_value ) ) != 0 )
+        {
+            text += " bits ";
+            text += reg_value;
+        }
+    }
+    else if( f.mType == RVSWDFT_DataParity )
+    {
+        text += "Data parity";
+        text += f.mData2 ? "ok" : "NOT OK";
+    }
+    else if( f.mType == RVSWDFT_TrailingBits )
+    {
+        text += "Trailing bits";
+    }
+    else if( f.mType == RVSWDFT_Idle )
+    {
+        text += "Idle ";
+        text += int2str( f.mData1 );
+        text += " bits";
+    }
+    else if( f.mType == RVSWDFT_Bit )
+    {
+        text += "bit ";
+        text += int2str( f.mData2 );
+    }
+    else if( f.mType == RVSWDFT_Error )
+    {
+        text += "err";
+    }
+}
+
+void RVSWDAnalyzerResults::GetBubbleText( const Frame& f, DisplayBase display_base, std::vector<std::string>& results )
+{
+    // the longest first, then shorter ones for when the bubble is narrow
+    results.resize( 1 );
+    GetFrameText( f, display_base, results.front() );
+
+    if( f.mType == RVSWDFT_Request )
+    {
+        const RVSWDRequestFrame& req( ( const RVSWDRequestFrame& )f );
+        std::string reg_name( req.GetRegisterName() );
 
         results.push_back( int2str_sal( req.mData2, display_base ) );
         results.push_back( "rq" );
         results.push_back( "req" );
         results.push_back( "request" );
-        results.push_back( std::string( "request " ) + ( req.IsAccessPort() ? "AP" : "DP" ) + ( req.IsRead() ? " R" : " W" ) + " " +
+        results.push_back( std::string( "request " ) + ( req.IsAccessPort() ? "AP" : "DP" ) + ( req.IsRead() ? " R " : " W " ) + reg_name );
+        results.push_back( std::string( "Request " ) + ( req.IsAccessPort() ? "AccessPort" : "DebugPort" ) + ( req.IsRead() ? " Read " : " Write " ) +
                            reg_name );
-
-        results.push_back( std::string( "Request " ) + ( req.IsAccessPort() ? "AccessPort" : "DebugPort" ) +
-                           ( req.IsRead() ? " Read" : " Write" ) + " " + reg_name );
     }
     else if( f.mType == RVSWDFT_LineReset )
     {
-        results.push_back( "Line Reset " + int2str( f.mData1 ) + " bits" );
         results.push_back( "rst" );
         results.push_back( "reset" );
         results.push_back( "Line Reset" );
     }
     else if( f.mType == RVSWDFT_Turnaround )
     {
-        results.push_back( "Turnaround" );
         results.push_back( "T" );
         results.push_back( "trn" );
         results.push_back( "turn" );
@@ -80,22 +150,18 @@ void RVSWDAnalyzerResults::GetBubbleText( const Frame& f, DisplayBase display_ba
     {
         if( f.mData1 == ACK_OK )
         {
-            results.push_back( "ACK OK" );
             results.push_back( "OK" );
         }
         else if( f.mData1 == ACK_WAIT )
         {
-            results.push_back( "ACK WAIT" );
             results.push_back( "WAIT" );
         }
         else if( f.mData1 == ACK_FAULT )
         {
-            results.push_back( "ACK FAULT" );
             results.push_back( "FAULT" );
         }
         else
         {
-            results.push_back( "ACK <unknown> probably disconnected" );
             results.push_back( "ACK <unknown>" );
             results.push_back( "disc" );
         }
@@ -104,53 +170,29 @@ void RVSWDAnalyzerResults::GetBubbleText( const Frame& f, DisplayBase display_ba
     }
     else if( f.mType == RVSWDFT_WData )
     {
+        // the first has the register's fields after this, if it has any
         std::string data_str( int2str_sal( f.mData1, display_base, 32 ) );
-        RVSWDRegisters reg( RVSWDRegisters( f.mData2 ) );
-        std::string reg_name( GetRegisterName( reg ) );
-        std::string reg_value( GetRegisterValueDesc( reg, U32( f.mData1 ), display_base ) );
+        std::string with_reg( "WData " + data_str + " reg " + GetRegisterName( RVSWDRegisters( f.mData2 ) ) );
 
-        if( !reg_value.empty() )
-            results.push_back( "WData " + data_str + " reg " + reg_name + " bits " + reg_value );
-        results.push_back( "WData " + data_str + " reg " + reg_name );
+        if( results.front() != with_reg )
+            results.push_back( with_reg );
         results.push_back( "WData" );
         results.push_back( "WData " + data_str );
     }
     else if( f.mType == RVSWDFT_DataParity )
     {
-        results.push_back( std::string( "Data parity" ) + ( f.mData2 ? "ok" : "NOT OK" ) );
         results.push_back( f.mData1 ? "1" : "0" );
         results.push_back( "prty" );
         results.push_back( "Parity" );
     }
     else if( f.mType == RVSWDFT_TrailingBits )
     {
-        results.push_back( "Trailing bits" );
         results.push_back( "Trail" );
     }
-    else
+    else if( f.mType == RVSWDFT_Idle )
     {
-        std::string msg;
-
-        switch( f.mType )
-        {
-        case RVSWDFT_Bit:
-            msg = "bit " + int2str( f.mData2 );
-            break;
-        case RVSWDFT_WData:
-            msg = "data";
-            break;
-        case RVSWDFT_DataParity:
-            msg = "dprty";
-            break;
-        case RVSWDFT_Error:
-            msg = "err";
-            break;
-        case RVSWDFT_Request:
-            msg = "request";
-            break;
-        }
-
-        results.push_back( msg );
+        results.push_back( "idle" );
+        results.push_back( "Idle" );
     }
 }
 
@@ -159,121 +201,797 @@ void RVSWDAnalyzerResults::GenerateBubbleText( U64 frame_index, Channel& channel
     ClearResultStrings();
     Frame f = GetFrame( frame_index );
 
-    std::vector<std::string> results;
-    GetBubbleText( f, display_base, results );
+    // with several buses, the bubbles only go on the frame's own bus
+    U32 bus = GetFrameBus( f );
+    if( mSettings->mNumBuses > 1 && channel != mSettings->mDIO[ bus ] && channel != mSettings->mCLK[ bus ] )
+        return;
+
+    std::lock_guard<std::mutex> lock( mTextCacheMutex );
 
-    for( std::vector<std::string>::iterator ri( results.begin() ); ri != results.end(); ++ri )
+    RVSWDTextCache::Entry& entry( mTextCache.Find( f, display_base ) );
+    if( !entry.has_bubbles )
+    {
+        GetBubbleText( f, display_base, entry.bubbles );
+        entry.has_bubbles = true;
+    }
+
+    for( std::vector<std::string>::const_iterator ri( entry.bubbles.begin() ); ri != entry.bubbles.end(); ++ri )
         AddResultString( ri->c_str() );
 }
 
-#define EXP_RECORD_FIELDS 9
+// an operation record starts with its request, its ACK follows
+static bool RecordMatches( const std::vector<Frame>& open, const RVSWDExportFilter& filter )
+{
+    if( open.front().mType == RVSWDFT_LineReset )
+        return filter.MatchesLineReset();
 
-void SaveRecord( std::vector<std::string>& rec, std::ofstream& of )
+    const RVSWDRequestFrame& req( ( const RVSWDRequestFrame& )open.front() );
+
+    U8 ack = 0;
+    for( std::vector<Frame>::const_iterator fi( open.begin() ); fi != open.end(); ++fi )
+    {
+        if( fi->mType == RVSWDFT_ACK )
+            ack = U8( fi->mData1 );
+    }
+
+    return filter.MatchesOperation( req.GetRegister(), req.IsRead(), req.IsAccessPort(), ack );
+}
+
+static bool RecordMatches( const RVSWDOperationRecord& rec, const RVSWDExportFilter& filter )
 {
-    if( rec.empty() )
+    if( rec.flags & RVSWDOF_LINE_RESET )
+        return filter.MatchesLineReset();
+
+    return filter.MatchesOperation( RVSWDRegisters( rec.reg ), ( rec.flags & RVSWDOF_READ ) != 0, ( rec.flags & RVSWDOF_ACCESS_PORT ) != 0,
+                                    rec.ack );
+}
+
+// moves the frames of a bus's record into the chunk, if the filter wants it
+static void CloseRecord( std::vector<Frame>& open, U32 bus, RVSWDExportPipeline::Chunk& chunk, const RVSWDExportFilter& filter )
+{
+    if( open.empty() )
         return;
 
-    while( rec.size() < EXP_RECORD_FIELDS )
-        rec.push_back( "" );
+    if( RecordMatches( open, filter ) )
+    {
+        RVSWDExportPipeline::Record rec = { U32( chunk.frames.size() ), U32( open.size() ), bus };
+        chunk.frames.insert( chunk.frames.end(), open.begin(), open.end() );
+        chunk.records.push_back( rec );
+    }
+
+    open.clear();
+}
+
+static bool HasOpenRecords( const std::vector<std::vector<Frame> >& records )
+{
+    for( size_t bus = 0; bus < records.size(); ++bus )
+    {
+        if( !records[ bus ].empty() )
+            return true;
+    }
+
+    return false;
+}
+
+U64 RVSWDAnalyzerResults::FindFrame( S64 sample, bool after )
+{
+    // the frames are committed in the order they start
+    U64 lo = 0;
+    U64 hi = GetNumFrames();
+    while( lo < hi )
+    {
+        U64 mid = lo + ( hi - lo ) / 2;
+        S64 start = GetFrame( mid ).mStartingSampleInclusive;
+
+        if( start < sample || after && start == sample )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+void RVSWDAnalyzerResults::FindExportFrames( const RVSWDExportFilter& filter, U64& first_frame, U64& end_frame )
+{
+    first_frame = FindFrame( filter.start_sample, false );
+    end_frame = FindFrame( filter.end_sample, true );
+}
+
+void RVSWDAnalyzerResults::StartIndex()
+{
+    std::lock_guard<std::mutex> lock( mIndexMutex );
+
+    mIndex.Clear();
+    mIndexing = true;
+}
+
+void RVSWDAnalyzerResults::AddToIndex( const std::vector<RVSWDIndexedOperation>& ops )
+{
+    std::lock_guard<std::mutex> lock( mIndexMutex );
+
+    for( std::vector<RVSWDIndexedOperation>::const_iterator oi( ops.begin() ); oi != ops.end(); ++oi )
+        mIndex.AddOperation( *oi );
+}
+
+void RVSWDAnalyzerResults::SetCaptureStats( U32 bus, const RVSWDCaptureStats& stats )
+{
+    std::lock_guard<std::mutex> lock( mCaptureStatsMutex );
+
+    if( bus >= mCaptureStats.size() )
+    {
+        RVSWDCaptureStats no_stats;
+        no_stats.Clear();
+        mCaptureStats.resize( bus + 1, no_stats );
+    }
+
+    mCaptureStats[ bus ] = stats;
+}
+
+bool RVSWDAnalyzerResults::FindIndexedSpans( const RVSWDExportFilter& filter, U64 end_frame, std::vector<ExportSpan>& spans, U64& index_bytes )
+{
+    if( !filter.HasPredicate() )
+        return false;
+
+    std::vector<U32> found;
+    std::vector<S64> starts;
+    {
+        std::lock_guard<std::mutex> lock( mIndexMutex );
+
+        if( !mIndexing || !mIndex.IsComplete() )
+            return false;
 
-    for( std::vector<std::string>::iterator ri( rec.begin() ); ri != rec.end(); ++ri )
+        mIndex.Query( RVSWDIndexQuery( filter ), found );
+
+        starts.reserve( found.size() );
+        for( std::vector<U32>::const_iterator fi( found.begin() ); fi != found.end(); ++fi )
+            starts.push_back( mIndex.GetOperation( *fi ).start_sample );
+
+        index_bytes = mIndex.GetMemoryBytes();
+    }
+
+    // only the operations whose frames were committed are indexed, so their requests are there
+    const U64 num_frames = GetNumFrames();
+    for( std::vector<S64>::const_iterator si( starts.begin() ); si != starts.end(); ++si )
     {
-        if( ri != rec.begin() )
-            of << "\t";
+        U64 request = FindFrame( *si, false );
+        ExportSpan span = { request, request + 1, false };
+        if( span.first >= end_frame || GetFrame( span.first ).mType != RVSWDFT_Request )
+            return false;
 
-        of << *ri;
+        for( ; span.end < num_frames; ++span.end )
+        {
+            U8 type = GetFrame( span.end ).mType;
+            if( type == RVSWDFT_Request || type == RVSWDFT_LineReset )
+            {
+                span.close = true;
+                break;
+            }
+        }
+
+        spans.push_back( span );
     }
 
-    of << std::endl;
+    return true;
+}
+
+bool RVSWDAnalyzerResults::FindExportSpans( const RVSWDExportFilter& filter, U64 first_frame, U64 end_frame, std::vector<ExportSpan>& spans,
+                                            U64& index_bytes )
+{
+    spans.clear();
+    index_bytes = 0;
 
-    rec.clear();
+    if( FindIndexedSpans( filter, end_frame, spans, index_bytes ) )
+        return true;
+
+    spans.clear();
+    index_bytes = 0;
+
+    ExportSpan all = { first_frame, GetNumFrames(), false };
+    spans.push_back( all );
+
+    return false;
 }
 
 void RVSWDAnalyzerResults::GenerateExportFile( const char* file, DisplayBase display_base, U32 export_type_user_id )
 {
-    std::ofstream of( file, std::ios::out );
+    if( export_type_user_id == RVSWDAnalyzerSettings::EXPORT_OPERATIONS )
+        GenerateOperationFile( file );
+    else if( export_type_user_id == RVSWDAnalyzerSettings::EXPORT_MEMORY_HEX )
+        GenerateMemoryFile( file, true );
+    else if( export_type_user_id == RVSWDAnalyzerSettings::EXPORT_MEMORY_BINARY )
+        GenerateMemoryFile( file, false );
+    else if( export_type_user_id == RVSWDAnalyzerSettings::EXPORT_STATISTICS )
+        GenerateStatsFile( file );
+    else
+        GenerateTextFile( file, display_base );
+}
 
-    U64 trigger_sample = mAnalyzer->GetTriggerSample();
-    U32 sample_rate = mAnalyzer->GetSampleRate();
+void RVSWDAnalyzerResults::GenerateTextFile( const char* file, DisplayBase display_base )
+{
+    // with several buses there's a bus column, and the frames of the buses' operations are interleaved
+    RVSWDTextFormat fmt;
+    fmt.display_base = display_base;
+    fmt.trigger_sample = mAnalyzer->GetTriggerSample();
+    fmt.sample_rate = mAnalyzer->GetSampleRate();
+    fmt.multi_bus = mSettings->mNumBuses > 1;
+
+    const RVSWDExportFilter filter( mSettings->GetExportFilter( fmt.trigger_sample, fmt.sample_rate ) );
+
+    // only the frames that start in the range are read, and after them the ones that finish its last operations
+    U64 first_frame, end_frame;
+    FindExportFrames( filter, first_frame, end_frame );
+
+    // the records are grouped here, in the order their lines go in the file, and formatted on the pipeline's threads,
+    // but for ASCII and AsciiHex, which only the SDK formats, and that's left to this thread
+    RVSWDExportPipeline pipeline;
+    if( !pipeline.Start( file, fmt.GetHeader(), std::bind( FormatTextChunk, std::placeholders::_1, fmt ),
+                         IsFastNumberBase( display_base ) ? U32( RVSWDExportPipeline::MAX_THREADS ) : 0 ) )
+    {
+        memset( &mExportStats, 0, sizeof( mExportStats ) );
+        mExportStats.error = "the export file can't be created";
+        UpdateExportProgressAndCheckForCancel( 1, 1 );
+        return;
+    }
 
-    of << "Time\tType\tR/W\tAP/DP\tRegister\tRequest byte\tACK\tWData\tWData details" << std::endl;
+    // with a filter the index finds the operations, and only their frames are read
+    std::vector<ExportSpan> spans;
+    U64 index_bytes;
+    bool indexed = FindExportSpans( filter, first_frame, end_frame, spans, index_bytes );
 
     Frame f;
-    const U64 num_frames = GetNumFrames();
-    std::vector<std::string> record;
-    for( U64 fcnt = 0; fcnt < num_frames; fcnt++ )
+    std::vector<std::vector<Frame> > records( mSettings->mNumBuses );
+    U64 num_read = 0;
+    std::vector<ExportSpan>::const_iterator si( spans.begin() );
+    for( U64 fcnt = spans.empty() ? 0 : si->first; si != spans.end(); fcnt++ )
     {
+        if( fcnt == si->end )
+        {
+            // the next operation's request ends the one the index found, like it does in the scan
+            if( si->close )
+                CloseRecord( records[ 0 ], 0, pipeline.GetChunk(), filter );
+
+            if( ++si == spans.end() )
+                break;
+
+            fcnt = si->first;
+        }
+
+        bool in_range = fcnt < end_frame;
+        if( !in_range && !HasOpenRecords( records ) )
+            break;
+
         // get the frame
         f = GetFrame( fcnt );
 
+        U32 bus = GetFrameBus( f );
+        if( bus >= records.size() )
+            bus = 0;
+
+        std::vector<Frame>& record( records[ bus ] );
+        RVSWDExportPipeline::Chunk& chunk( pipeline.GetChunk() );
+
         if( f.mType == RVSWDFT_LineReset )
         {
-            SaveRecord( record, of );
+            CloseRecord( record, bus, chunk, filter );
 
-            record.push_back( GetSampleTimeStr( f.mStartingSampleInclusive ) );
-            record.push_back( "Line reset" );
-            SaveRecord( record, of );
+            if( in_range )
+            {
+                record.push_back( f );
+                CloseRecord( record, bus, chunk, filter );
+            }
         }
         else if( f.mType == RVSWDFT_Request )
         {
-            SaveRecord( record, of );
-
-            RVSWDRequestFrame& req( ( RVSWDRequestFrame& )f );
-            record.push_back( GetSampleTimeStr( f.mStartingSampleInclusive ) );
-            record.push_back( "Operation" );
-            record.push_back( req.IsRead() ? "read" : "write" );
-            record.push_back( req.IsAccessPort() ? "AccessPort" : "DebugPort" );
-            record.push_back( req.GetRegisterName() );
-            record.push_back( int2str_sal( req.mData1, display_base, 8 ) );
+            CloseRecord( record, bus, chunk, filter );
+
+            if( in_range )
+                record.push_back( f );
+        }
+        else if( record.empty() )
+        {
+            // the rest of an operation that started before the range
         }
         else if( f.mType == RVSWDFT_ACK )
         {
-            if( f.mData1 == ACK_OK )
-                record.push_back( "OK" );
-            else if( f.mData1 == ACK_WAIT )
-                record.push_back( "WAIT" );
-            else if( f.mData1 == ACK_FAULT )
-                record.push_back( "FAULT" );
-            else
-                record.push_back( "<disc>" );
+            record.push_back( f );
         }
         else if( f.mType == RVSWDFT_WData )
         {
-            record.push_back( int2str_sal( f.mData1, display_base, 32 ) );
+            record.push_back( f );
+
+            CloseRecord( record, bus, chunk, filter );
+        }
+
+        if( chunk.records.size() >= RVSWDExportPipeline::CHUNK_RECORDS )
+            pipeline.Submit();
+
+        if( ( num_read++ % EXPORT_PROGRESS_FRAMES ) == 0 &&
+            UpdateExportProgressAndCheckForCancel( std::min( fcnt, end_frame ) - first_frame, end_frame - first_frame ) )
+        {
+            pipeline.Cancel();
+            mExportStats = pipeline.GetStats();
+            return;
+        }
+    }
+
+    // like before, an operation that's still open at the end isn't written
+    pipeline.Finish();
+
+    mExportStats = pipeline.GetStats();
+    mExportStats.num_frames = num_read;
+    mExportStats.num_index_hits = indexed ? spans.size() : 0;
+    mExportStats.index_bytes = index_bytes;
+
+    UpdateExportProgressAndCheckForCancel( end_frame - first_frame, end_frame - first_frame );
+}
+
+void RVSWDAnalyzerResults::GenerateOperationFile( const char* file )
+{
+    std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+
+    RVSWDOperationFileWriter writer;
+    if( !writer.Open( file, mAnalyzer->GetSampleRate(), mAnalyzer->GetTriggerSample() ) )
+    {
+        memset( &mExportStats, 0, sizeof( mExportStats ) );
+        mExportStats.error = "the operations file can't be created";
+        UpdateExportProgressAndCheckForCancel( 1, 1 );
+        return;
+    }
+
+    RVSWDOperationRecordBuilder builder;
+    builder.Setup( mSettings->mNumBuses );
+
+    const RVSWDExportFilter filter( mSettings->GetExportFilter( mAnalyzer->GetTriggerSample(), mAnalyzer->GetSampleRate() ) );
+
+    U64 first_frame, end_frame;
+    FindExportFrames( filter, first_frame, end_frame );
+
+    std::vector<ExportSpan> spans;
+    U64 index_bytes;
+    bool indexed = FindExportSpans( filter, first_frame, end_frame, spans, index_bytes );
+
+    // the records are only a copy away from the frames, there's nothing to gain from the text export's threads
+    std::vector<RVSWDOperationRecord> records;
+    U64 num_read = 0;
+    std::vector<ExportSpan>::const_iterator si( spans.begin() );
+    for( U64 fcnt = spans.empty() ? 0 : si->first; si != spans.end(); fcnt++ )
+    {
+        if( fcnt == si->end )
+        {
+            if( si->close )
+                builder.Close( 0, records );
 
-            RVSWDRegisters reg( RVSWDRegisters( f.mData2 ) );
-            record.push_back( GetRegisterValueDesc( reg, U32( f.mData1 ), display_base ) );
+            if( ++si == spans.end() )
+                break;
 
-            SaveRecord( record, of );
+            fcnt = si->first;
         }
 
-        if( UpdateExportProgressAndCheckForCancel( fcnt, num_frames ) )
+        bool in_range = fcnt < end_frame;
+        if( !in_range && !builder.HasOpenRecords() )
+            break;
+
+        Frame f = GetFrame( fcnt );
+        U32 bus = GetFrameBus( f );
+
+        // past the range, the next operation or line reset of a bus only ends its open operation
+        if( in_range || f.mType != RVSWDFT_Request && f.mType != RVSWDFT_LineReset )
+            builder.AddFrame( f, bus, records );
+        else
+            builder.Close( bus, records );
+
+        for( std::vector<RVSWDOperationRecord>::const_iterator ri( records.begin() ); ri != records.end(); ++ri )
+        {
+            if( RecordMatches( *ri, filter ) )
+                writer.Write( *ri );
+        }
+
+        records.clear();
+
+        if( ( num_read++ % EXPORT_PROGRESS_FRAMES ) == 0 &&
+            UpdateExportProgressAndCheckForCancel( std::min( fcnt, end_frame ) - first_frame, end_frame - first_frame ) )
+        {
+            writer.Close();
+            return;
+        }
+    }
+
+    builder.Finish( records );
+    for( std::vector<RVSWDOperationRecord>::const_iterator ri( records.begin() ); ri != records.end(); ++ri )
+    {
+        if( RecordMatches( *ri, filter ) )
+            writer.Write( *ri );
+    }
+
+    memset( &mExportStats, 0, sizeof( mExportStats ) );
+    mExportStats.num_frames = num_read;
+    mExportStats.num_records = writer.GetNumRecords();
+    mExportStats.num_index_hits = indexed ? spans.size() : 0;
+    mExportStats.index_bytes = index_bytes;
+    mExportStats.num_bytes = sizeof( RVSWDOperationFileHeader ) + writer.GetNumRecords() * sizeof( RVSWDOperationRecord );
+
+    if( !writer.Close() )
+        mExportStats.error = "writing the operations file failed";
+
+    mExportStats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+    UpdateExportProgressAndCheckForCancel( end_frame - first_frame, end_frame - first_frame );
+}
+
+void RVSWDAnalyzerResults::GenerateMemoryFile( const char* file, bool hex )
+{
+    std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+
+    // the buses are different targets, their memory can't go in one image
+    RVSWDOperationRecordBuilder builder;
+    builder.Setup( 1 );
+
+    RVSWDMemoryImage image;
+    RVSWDMemoryTracker tracker;
+    tracker.Setup( &image, true );
+
+    std::vector<RVSWDOperationRecord> records;
+    const U64 num_frames = GetNumFrames();
+    for( U64 fcnt = 0; fcnt < num_frames; fcnt++ )
+    {
+        Frame f = GetFrame( fcnt );
+        if( GetFrameBus( f ) != 0 )
+            continue;
+
+        builder.AddFrame( f, 0, records );
+        for( std::vector<RVSWDOperationRecord>::const_iterator ri( records.begin() ); ri != records.end(); ++ri )
+            tracker.AddRecord( *ri );
+
+        records.clear();
+
+        if( ( fcnt % EXPORT_PROGRESS_FRAMES ) == 0 && UpdateExportProgressAndCheckForCancel( fcnt, num_frames ) )
             return;
     }
 
+    builder.Finish( records );
+    for( std::vector<RVSWDOperationRecord>::const_iterator ri( records.begin() ); ri != records.end(); ++ri )
+        tracker.AddRecord( *ri );
+
+    tracker.Finish();
+
+    memset( &mExportStats, 0, sizeof( mExportStats ) );
+    mExportStats.num_frames = num_frames;
+    mExportStats.num_records = tracker.GetStats().num_writes + tracker.GetStats().num_reads;
+
+    FILE* f = fopen( file, hex ? "w" : "wb" );
+    if( f == NULL )
+    {
+        mExportStats.error = "the memory image file can't be created";
+        UpdateExportProgressAndCheckForCancel( num_frames, num_frames );
+        return;
+    }
+
+    // A binary image that's too big leaves the file empty, anything in it would be taken for
+    // the image. Only the statistics export says why.
+    U32 first, last;
+    if( !hex && image.GetRange( first, last ) && U64( last - first ) + 1 > RVSWDMemoryImage::MAX_BINARY_SPAN )
+    {
+        mExportStats.error = "the memory image spans more than a raw binary file takes, export it as Intel HEX";
+    }
+    else if( !( hex ? image.SaveHex( f ) : image.SaveBinary( f ) ) )
+    {
+        mExportStats.error = "writing the memory image failed";
+    }
+
+    mExportStats.num_bytes = U64( ftell( f ) );
+
+    if( fclose( f ) != 0 && mExportStats.error == NULL )
+        mExportStats.error = "writing the memory image failed";
+
+    mExportStats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
     UpdateExportProgressAndCheckForCancel( num_frames, num_frames );
 }
 
+void RVSWDAnalyzerResults::GenerateStatsFile( const char* file )
+{
+    std::vector<RVSWDCaptureStats> stats;
+    {
+        std::lock_guard<std::mutex> lock( mCaptureStatsMutex );
+        stats = mCaptureStats;
+    }
+
+    FILE* f = fopen( file, "w" );
+    if( f == NULL )
+        return;
+
+    for( size_t bus = 0; bus < stats.size(); ++bus )
+    {
+        if( stats.size() > 1 )
+            fprintf( f, "%sBus %u\n", bus != 0 ? "\n" : "", unsigned( bus + 1 ) );
+
+        stats[ bus ].Write( f, mAnalyzer->GetSampleRate() );
+    }
+
+    // what the export before this one did, there's nowhere else to show it
+    if( mExportStats.num_bytes != 0 || mExportStats.error != NULL )
+    {
+        fprintf( f, "\nlast export: " );
+        mExportStats.Write( f );
+    }
+
+    memset( &mExportStats, 0, sizeof( mExportStats ) );
+    mExportStats.num_records = stats.size();
+    mExportStats.num_bytes = U64( ftell( f ) );
+
+    fclose( f );
+
+    UpdateExportProgressAndCheckForCancel( 1, 1 );
+}
+
 void RVSWDAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBase display_base )
 {
     ClearTabularText();
 
-    std::vector<std::string> results;
     Frame f = GetFrame( frame_index );
-    GetBubbleText( f, display_base, results );
 
-    if( !results.empty() )
-        AddTabularText( results.front().c_str() );
+    std::lock_guard<std::mutex> lock( mTextCacheMutex );
+
+    // the table only shows the longest text, the shorter bubble ones aren't made for it
+    RVSWDTextCache::Entry& entry( mTextCache.Find( f, display_base ) );
+    if( !entry.has_tabular )
+    {
+        if( entry.has_bubbles )
+            entry.tabular = entry.bubbles.front();
+        else
+            GetFrameText( f, display_base, entry.tabular );
+
+        entry.has_tabular = true;
+    }
+
+    if( mSettings->mNumBuses > 1 )
+    {
+        mTabularText = "Bus ";
+        mTabularText += int2str( GetFrameBus( f ) + 1 );
+        mTabularText += ' ';
+        mTabularText += entry.tabular;
+
+        AddTabularText( mTabularText.c_str() );
+    }
+    else
+    {
+        AddTabularText( entry.tabular.c_str() );
+    }
+}
+
+std::string RVSWDAnalyzerResults::GetPacketText( U64 packet_id, DisplayBase display_base )
+{
+    U64 first_frame, last_frame;
+    GetFramesContainedInPacket( packet_id, &first_frame, &last_frame );
+
+    // a packet is a line reset, or an operation's frames
+    std::string text;
+    for( U64 ndx = first_frame; ndx <= last_frame; ++ndx )
+    {
+        Frame f = GetFrame( ndx );
+
+        if( f.mType == RVSWDFT_LineReset )
+        {
+            text = "Line Reset " + int2str( f.mData1 ) + " bits";
+        }
+        else if( f.mType == RVSWDFT_Request )
+        {
+            const RVSWDRequestFrame& req( ( const RVSWDRequestFrame& )f );
+            text = std::string( req.IsAccessPort() ? "AP" : "DP" ) + ( req.IsRead() ? " read " : " write " ) + req.GetRegisterName();
+        }
+        else if( f.mType == RVSWDFT_ACK )
+        {
+            text += std::string( " " ) + GetACKName( f.mData1 );
+        }
+        else if( f.mType == RVSWDFT_WData )
+        {
+            text += " " + int2str_sal( f.mData1, display_base, 32 );
+        }
+        else if( f.mType == RVSWDFT_DataParity && f.mData2 == 0 )
+        {
+            text += " parity NOT OK";
+        }
+    }
+
+    return text;
 }
 
 void RVSWDAnalyzerResults::GeneratePacketTabularText( U64 packet_id, DisplayBase display_base )
 {
-    ClearResultStrings();
-    AddResultString( "not supported" );
+    ClearTabularText();
+    AddTabularText( GetPacketText( packet_id, display_base ).c_str() );
 }
 
 void RVSWDAnalyzerResults::GenerateTransactionTabularText( U64 transaction_id, DisplayBase display_base )
 {
-    ClearResultStrings();
-    AddResultString( "not supported" );
+    ClearTabularText();
+
+    U64* packets;
+    U64 num_packets;
+    GetPacketsContainedInTransaction( transaction_id, &packets, &num_packets );
+
+    if( num_packets == 0 )
+        return;
+
+    // A transaction can have millions of DRW accesses, only its setup is looked at.
+    // The address is the last TAR write of the setup.
+    std::string address;
+    for( U64 ndx = 0; ndx < num_packets && ndx < TRANSACTION_SETUP_PACKETS; ++ndx )
+    {
+        U64 first_frame, last_frame;
+        GetFramesContainedInPacket( packets[ ndx ], &first_frame, &last_frame );
+
+        Frame f = GetFrame( first_frame );
+        const RVSWDRequestFrame& req( ( const RVSWDRequestFrame& )f );
+        if( req.mType != RVSWDFT_Request || req.GetRegister() != RVSWDR_AP_TAR || req.IsRead() )
+            continue;
+
+        for( U64 fndx = first_frame + 1; fndx <= last_frame; ++fndx )
+        {
+            Frame data = GetFrame( fndx );
+            if( data.mType == RVSWDFT_WData )
+                address = " at " + int2str_sal( data.mData1, display_base, 32 );
+        }
+    }
+
+    AddTabularText( ( "Memory access" + address + ", " + int2str( num_packets ) + " operations" ).c_str() );
+}
+
+// ********************************************************************************
+
+RVSWDResultStage::RVSWDResultStage()
+    : mResults( 0 ),
+      mAnalyzer( 0 ),
+      mCaptureStats( 0 ),
+      mShowIdle( true ),
+      mPacketStart( 0 ),
+      mNumOperations( 0 ),
+      mMaxSpan( 0 ),
+      mProgressSpan( 0 ),
+      mNextProgress( 0 )
+{
+    memset( &mStats, 0, sizeof( mStats ) );
+}
+
+void RVSWDResultStage::Setup( RVSWDAnalyzerResults* pResults, RVSWDAnalyzer* pAnalyzer, const RVSWDCaptureStats* pCaptureStats )
+{
+    mResults = pResults;
+    mAnalyzer = pAnalyzer;
+    mCaptureStats = pCaptureStats;
+
+    mMarkerChannel = mResults->GetSettings()->mCLK[ 0 ];
+    mShowIdle = mResults->GetSettings()->mShowIdle;
+
+    mFrames.clear();
+    mMarkers.clear();
+    mPackets.clear();
+    mIndexed.clear();
+    mPacketStart = 0;
+    mNumOperations = 0;
+
+    mResults->StartIndex();
+
+    U64 sample_rate = mAnalyzer->GetSampleRate();
+    mMaxSpan = std::max<U64>( sample_rate * MAX_SPAN_MS / 1000, 1 );
+    mProgressSpan = std::max<U64>( sample_rate * PROGRESS_SPAN_MS / 1000, 1 );
+    mNextProgress = 0;
+
+    memset( &mStats, 0, sizeof( mStats ) );
+}
+
+void RVSWDResultStage::AddFrame( const Frame& f )
+{
+    if( f.mType == RVSWDFT_Idle && !mShowIdle )
+        return;
+
+    mFrames.push_back( f );
+}
+
+void RVSWDResultStage::AddMarker( S64 sample_number, RVSWDMarkerTypes marker_type )
+{
+    static const AnalyzerResults::MarkerType marker_types[] = { AnalyzerResults::Zero, AnalyzerResults::One, AnalyzerResults::X };
+
+    StagedMarker m = { sample_number, marker_types[ marker_type ] };
+    mMarkers.push_back( m );
+}
+
+void RVSWDResultStage::EndPacket( U64 transaction_id )
+{
+    StagedPacket p = { mPacketStart, mFrames.size(), transaction_id };
+    mPackets.push_back( p );
+}
+
+void RVSWDResultStage::IndexOperation( RVSWDOperation& tran )
+{
+    RVSWDIndexedOperation op;
+    RVSWDOperationIndex::GetIndexedOperation( tran, op );
+    mIndexed.push_back( op );
+}
+
+void RVSWDResultStage::EndOperation( U64 sample_number )
+{
+    ++mNumOperations;
+    ++mStats.num_operations;
+
+    if( mNumOperations >= MAX_OPERATIONS ||
+        !mFrames.empty() && sample_number - mFrames.front().mStartingSampleInclusive >= mMaxSpan )
+        Flush();
+
+    ReportProgress( sample_number );
+}
+
+void RVSWDResultStage::ReportProgress( U64 sample_number )
+{
+    if( sample_number < mNextProgress )
+        return;
+
+    mAnalyzer->ReportProgress( sample_number );
+    mNextProgress = sample_number + mProgressSpan;
+    ++mStats.num_progress_reports;
+}
+
+void RVSWDResultStage::OnStall( U64 sample_number )
+{
+    Flush();
+    ReportProgress( sample_number );
+}
+
+void RVSWDResultStage::Flush()
+{
+    if( mNumOperations == 0 )
+        return;
+
+    // the frames between the packets are left out of them
+    size_t frame = 0;
+    for( std::vector<StagedPacket>::const_iterator pi( mPackets.begin() ); pi != mPackets.end(); ++pi )
+    {
+        if( frame < pi->first_frame )
+        {
+            for( ; frame < pi->first_frame; ++frame )
+                mResults->AddFrame( mFrames[ frame ] );
+
+            mResults->CancelPacketAndStartNewPacket();
+        }
+
+        for( ; frame < pi->end_frame; ++frame )
+            mResults->AddFrame( mFrames[ frame ] );
+
+        U64 packet_id = mResults->CommitPacketAndStartNewPacket();
+        if( pi->transaction_id != RVSWDTransactionTracker::NO_TRANSACTION && packet_id != INVALID_RESULT_INDEX )
+            mResults->AddPacketToTransaction( pi->transaction_id, packet_id );
+    }
+
+    if( frame < mFrames.size() )
+    {
+        for( ; frame < mFrames.size(); ++frame )
+            mResults->AddFrame( mFrames[ frame ] );
+
+        mResults->CancelPacketAndStartNewPacket();
+    }
+
+    for( std::vector<StagedMarker>::iterator mi( mMarkers.begin() ); mi != mMarkers.end(); ++mi )
+        mResults->AddMarker( mi->sample_number, mi->marker_type, mMarkerChannel );
+
+    mResults->CommitResults();
+
+    // the exports find the indexed operations' frames, so they're indexed once they're committed
+    if( !mIndexed.empty() )
+        mResults->AddToIndex( mIndexed );
+
+    if( mCaptureStats != NULL )
+        mResults->SetCaptureStats( 0, *mCaptureStats );
+
+    mStats.num_frames += mFrames.size();
+    mStats.num_markers += mMarkers.size();
+    mStats.num_packets += mPackets.size();
+    mStats.num_indexed += mIndexed.size();
+    ++mStats.num_commits;
+
+    // clear() keeps the capacity, so the next batch doesn't allocate
+    mFrames.clear();
+    mMarkers.clear();
+    mPackets.clear();
+    mIndexed.clear();
+    mNumOperations = 0;
 }
@@ -1,14 +1,31 @@
 #ifndef RVSWD_ANALYZER_RESULTS_H
 #define RVSWD_ANALYZER_RESULTS_H
 
+#include <vector>
+#include <string>
+#include <mutex>
+
 #include <AnalyzerResults.h>
 
+#include "RVSWDTypes.h"
+#include "RVSWDCaptureStats.h"
+#include "RVSWDExportPipeline.h"
+#include "RVSWDOperationIndex.h"
+#include "RVSWDTextCache.h"
+
 class RVSWDAnalyzer;
 class RVSWDAnalyzerSettings;
+struct RVSWDExportFilter;
 
 class RVSWDAnalyzerResults : public AnalyzerResults
 {
   public:
+    enum
+    {
+        EXPORT_PROGRESS_FRAMES = 1024, // frames between progress reports while exporting
+        TRANSACTION_SETUP_PACKETS = 4, // packets at the start of a transaction that are searched for its address
+    };
+
     RVSWDAnalyzerResults( RVSWDAnalyzer* analyzer, RVSWDAnalyzerSettings* settings );
     virtual ~RVSWDAnalyzerResults();
 
@@ -19,6 +36,10 @@ class RVSWDAnalyzerResults : public AnalyzerResults
     virtual void GeneratePacketTabularText( U64 packet_id, DisplayBase display_base );
     virtual void GenerateTransactionTabularText( U64 transaction_id, DisplayBase display_base );
 
+    // The index of the first frame that starts at sample or later, or later than sample if
+    // after is set. GetNumFrames() if there's none. It's a binary search over the frames.
+    U64 FindFrame( S64 sample, bool after );
+
     double GetSampleTime( S64 sample ) const;
     std::string GetSampleTimeStr( S64 sample ) const;
 
@@ -27,12 +48,175 @@ class RVSWDAnalyzerResults : public AnalyzerResults
         return mSettings;
     }
 
+    const RVSWDExportStats& GetExportStats() const
+    {
+        return mExportStats;
+    }
+
+    // the operations of a single bus are indexed as they're committed, the multi-bus decoder doesn't start the index
+    void StartIndex();
+    void AddToIndex( const std::vector<RVSWDIndexedOperation>& ops );
+
+    // the decoders hand over what they've counted on a bus so far, with the frames they commit
+    void SetCaptureStats( U32 bus, const RVSWDCaptureStats& stats );
+
   protected: // functions
+    // the longest of the frame's bubble texts, the one the data table shows
+    void GetFrameText( const Frame& f, DisplayBase display_base, std::string& text );
     void GetBubbleText( const Frame& f, DisplayBase display_base, std::vector<std::string>& results );
 
+    // the operation or line reset of a packet in a line
+    std::string GetPacketText( U64 packet_id, DisplayBase display_base );
+
+    // the frames that start in the filter's range are first_frame up to end_frame
+    void FindExportFrames( const RVSWDExportFilter& filter, U64& first_frame, U64& end_frame );
+
+    // frames first up to end are read, and with close set the frame at end ends the operation
+    struct ExportSpan
+    {
+        U64 first;
+        U64 end;
+        bool close;
+    };
+
+    // The frames of the operations the filter picks, looked up in the index, each from its
+    // request up to the next request or line reset. Returns false if the frames have to be
+    // scanned: the filter only has a range, or there's no complete index.
+    bool FindIndexedSpans( const RVSWDExportFilter& filter, U64 end_frame, std::vector<ExportSpan>& spans, U64& index_bytes );
+
+    // The spans an export reads, one for all the frames from first_frame on if the index
+    // can't help. Returns true if they came from the index.
+    bool FindExportSpans( const RVSWDExportFilter& filter, U64 first_frame, U64 end_frame, std::vector<ExportSpan>& spans, U64& index_bytes );
+
+    void GenerateTextFile( const char* file, DisplayBase display_base );
+    void GenerateOperationFile( const char* file );
+
+    // the memory image of the whole capture, the export filter would lose the TAR and CSW writes
+    void GenerateMemoryFile( const char* file, bool hex );
+
+    // the capture statistics of every bus, for the whole capture
+    void GenerateStatsFile( const char* file );
+
   protected: // vars
     RVSWDAnalyzerSettings* mSettings;
     RVSWDAnalyzer* mAnalyzer;
+
+    RVSWDExportStats mExportStats;
+
+    // the texts of the frames the bubbles and the data table showed, the lock is for the cache and mTabularText
+    std::mutex mTextCacheMutex;
+    RVSWDTextCache mTextCache;
+    std::string mTabularText; // reused for the bus prefix
+
+    // the decoder adds to the index while the exports read it
+    std::mutex mIndexMutex;
+    RVSWDOperationIndex mIndex;
+    bool mIndexing;
+
+    // a bus each, set while decoding and read by the export
+    std::mutex mCaptureStatsMutex;
+    std::vector<RVSWDCaptureStats> mCaptureStats;
+};
+
+// counters kept by the result stage, to keep an eye on the commit overhead
+struct RVSWDStageStats
+{
+    U64 num_operations; // operations, idle periods and line resets
+    U64 num_frames;
+    U64 num_markers;
+    U64 num_packets;
+    U64 num_commits;
+    U64 num_progress_reports;
+    U64 num_indexed;
+};
+
+// Collects the frames and markers of a batch of operations and hands them to the
+// results with a single commit. Idle frames are dropped here if they're switched off.
+// A batch is flushed once it has MAX_OPERATIONS operations or spans more than
+// MAX_SPAN_MS of samples, and whenever the parser is about to wait for more data, so
+// the live view doesn't fall behind.
+// The frames added between StartPacket and EndPacket become a packet when they're
+// committed, the frames outside of packets, the idle periods, don't belong to any.
+class RVSWDResultStage : public RVSWDFrameSink
+{
+  public:
+    enum
+    {
+        MAX_OPERATIONS = 256,
+        MAX_SPAN_MS = 50,
+        PROGRESS_SPAN_MS = 10,
+    };
+
+    RVSWDResultStage();
+
+    // pCaptureStats is what the decoder counts, it's handed to the results on every commit
+    void Setup( RVSWDAnalyzerResults* pResults, RVSWDAnalyzer* pAnalyzer, const RVSWDCaptureStats* pCaptureStats );
+
+    virtual void AddFrame( const Frame& f );
+    virtual void AddMarker( S64 sample_number, RVSWDMarkerTypes marker_type );
+
+    void StartPacket()
+    {
+        mPacketStart = mFrames.size();
+    }
+
+    // transaction_id is the transaction the packet goes into, or RVSWDTransactionTracker::NO_TRANSACTION
+    void EndPacket( U64 transaction_id );
+
+    // the operation goes in the results' index with its frames, call before the parser moves on
+    void IndexOperation( RVSWDOperation& tran );
+
+    // call after the frames and markers of an operation or line reset have been added
+    void EndOperation( U64 sample_number );
+
+    // reports progress if we've moved far enough since the last report
+    void ReportProgress( U64 sample_number );
+
+    // the parser has used up the available data, commit what we have
+    virtual void OnStall( U64 sample_number );
+
+    void Flush();
+
+    const RVSWDStageStats& GetStats() const
+    {
+        return mStats;
+    }
+
+  protected:
+    struct StagedMarker
+    {
+        S64 sample_number;
+        AnalyzerResults::MarkerType marker_type;
+    };
+
+    RVSWDAnalyzerResults* mResults;
+    RVSWDAnalyzer* mAnalyzer;
+    const RVSWDCaptureStats* mCaptureStats;
+
+    // the markers go on CLK
+    Channel mMarkerChannel;
+    bool mShowIdle;
+
+    // the frames first_frame up to end_frame of mFrames
+    struct StagedPacket
+    {
+        size_t first_frame;
+        size_t end_frame;
+        U64 transaction_id;
+    };
+
+    std::vector<Frame> mFrames;
+    std::vector<StagedMarker> mMarkers;
+    std::vector<StagedPacket> mPackets;
+    std::vector<RVSWDIndexedOperation> mIndexed;
+    size_t mPacketStart;
+    size_t mNumOperations;
+
+    U64 mMaxSpan;
+    U64 mProgressSpan;
+    U64 mNextProgress;
+
+    RVSWDStageStats mStats;
 };
 
 #endif // RVSWD_ANALYZER_RESULTS_H
\ No newline at end of file
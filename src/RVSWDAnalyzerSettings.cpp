@@ -1,30 +1,142 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
 #include <AnalyzerHelpers.h>
 
 #include "RVSWDAnalyzerSettings.h"
 #include "RVSWDAnalyzerResults.h"
 #include "RVSWDTypes.h"
+#include "RVSWDUtils.h"
+
+// Reads a time of the export range. It's in seconds, and empty if the range is open on that side.
+static bool ParseExportTime( const std::string& text, bool& is_set, double& seconds )
+{
+    const char* begin = text.c_str();
+    while( *begin == ' ' )
+        ++begin;
+
+    is_set = *begin != '\0';
+    if( !is_set )
+        return true;
+
+    char* end;
+    seconds = strtod( begin, &end );
+    while( *end == ' ' )
+        ++end;
 
-RVSWDAnalyzerSettings::RVSWDAnalyzerSettings() : mDIO( UNDEFINED_CHANNEL ), mCLK( UNDEFINED_CHANNEL )
+    return end != begin && *end == '\0' && std::isfinite( seconds );
+}
+
+RVSWDAnalyzerSettings::RVSWDAnalyzerSettings()
+    : mNumBuses( 1 ),
+      mShowIdle( true ),
+      mExportRegister( RVSWDR_undefined ),
+      mExportRnW( RVSWDExportFilter::ANY ),
+      mExportPort( RVSWDExportFilter::ANY ),
+      mExportACK( RVSWDExportFilter::ANY )
 {
     // init the interface
-    mDIOInterface.SetTitleAndTooltip( "DIO", "DIO" );
-    mDIOInterface.SetChannel( mDIO );
+    for( U32 bus = 0; bus < MAX_BUSES; ++bus )
+    {
+        mDIO[ bus ] = UNDEFINED_CHANNEL;
+        mCLK[ bus ] = UNDEFINED_CHANNEL;
+
+        // the first bus keeps the names it had before there were more
+        mDIOTitle[ bus ] = bus == 0 ? "DIO" : "DIO " + int2str( bus + 1 );
+        mCLKTitle[ bus ] = bus == 0 ? "CLK" : "CLK " + int2str( bus + 1 );
+
+        mDIOInterface[ bus ].SetTitleAndTooltip( mDIOTitle[ bus ].c_str(), mDIOTitle[ bus ].c_str() );
+        mDIOInterface[ bus ].SetChannel( mDIO[ bus ] );
+
+        mCLKInterface[ bus ].SetTitleAndTooltip( mCLKTitle[ bus ].c_str(), mCLKTitle[ bus ].c_str() );
+        mCLKInterface[ bus ].SetChannel( mCLK[ bus ] );
+
+        // the other buses are optional
+        if( bus != 0 )
+        {
+            mDIOInterface[ bus ].SetSelectionOfNoneIsAllowed( true );
+            mCLKInterface[ bus ].SetSelectionOfNoneIsAllowed( true );
+        }
+    }
+
+    mShowIdleInterface.SetTitleAndTooltip( "", "Add a frame for the low bits the host clocks out between operations" );
+    mShowIdleInterface.SetCheckBoxText( "Show idle periods" );
+    mShowIdleInterface.SetValue( mShowIdle );
+
+    mExportStartInterface.SetTitleAndTooltip( "Export from (s)",
+                                              "Only export what starts at or after this time, from the trigger. Empty for the start. "
+                                              "Changing it decodes the capture again." );
+    mExportStartInterface.SetText( mExportStart.c_str() );
+
+    mExportEndInterface.SetTitleAndTooltip( "Export to (s)",
+                                            "Only export what starts at or before this time, from the trigger. Empty for the end. "
+                                            "Changing it decodes the capture again." );
+    mExportEndInterface.SetText( mExportEnd.c_str() );
+
+    mExportRegisterInterface.SetTitleAndTooltip( "Export register",
+                                                 "Only export the operations on this register. Changing it decodes the capture again." );
+    mExportRegisterInterface.AddNumber( RVSWDR_undefined, "Any register", "" );
+    for( U32 reg = RVSWDR_DP_IDCODE; reg <= RVSWDR_AP_IDR; ++reg )
+        mExportRegisterInterface.AddNumber( reg, GetRegisterName( RVSWDRegisters( reg ) ), "" );
+    mExportRegisterInterface.SetNumber( mExportRegister );
+
+    mExportRnWInterface.SetTitleAndTooltip( "Export reads/writes",
+                                            "Only export the reads, or the writes. Changing it decodes the capture again." );
+    mExportRnWInterface.AddNumber( RVSWDExportFilter::ANY, "Reads and writes", "" );
+    mExportRnWInterface.AddNumber( RVSWDExportFilter::READ, "Reads", "" );
+    mExportRnWInterface.AddNumber( RVSWDExportFilter::WRITE, "Writes", "" );
+    mExportRnWInterface.SetNumber( mExportRnW );
+
+    mExportPortInterface.SetTitleAndTooltip( "Export port", "Only export the operations on the DebugPort, or on the AccessPort. "
+                                                            "Changing it decodes the capture again." );
+    mExportPortInterface.AddNumber( RVSWDExportFilter::ANY, "DebugPort and AccessPort", "" );
+    mExportPortInterface.AddNumber( RVSWDExportFilter::DEBUG_PORT, "DebugPort", "" );
+    mExportPortInterface.AddNumber( RVSWDExportFilter::ACCESS_PORT, "AccessPort", "" );
+    mExportPortInterface.SetNumber( mExportPort );
 
-    mCLKInterface.SetTitleAndTooltip( "CLK", "CLK" );
-    mCLKInterface.SetChannel( mCLK );
+    mExportACKInterface.SetTitleAndTooltip( "Export ACK",
+                                            "Only export the operations with this ACK. Changing it decodes the capture again." );
+    mExportACKInterface.AddNumber( RVSWDExportFilter::ANY, "Any ACK", "" );
+    mExportACKInterface.AddNumber( ACK_OK, "OK", "" );
+    mExportACKInterface.AddNumber( ACK_WAIT, "WAIT", "" );
+    mExportACKInterface.AddNumber( ACK_FAULT, "FAULT", "" );
+    mExportACKInterface.SetNumber( mExportACK );
 
     // add the interface
-    AddInterface( &mDIOInterface );
-    AddInterface( &mCLKInterface );
+    for( U32 bus = 0; bus < MAX_BUSES; ++bus )
+    {
+        AddInterface( &mDIOInterface[ bus ] );
+        AddInterface( &mCLKInterface[ bus ] );
+    }
+    AddInterface( &mShowIdleInterface );
+    AddInterface( &mExportStartInterface );
+    AddInterface( &mExportEndInterface );
+    AddInterface( &mExportRegisterInterface );
+    AddInterface( &mExportRnWInterface );
+    AddInterface( &mExportPortInterface );
+    AddInterface( &mExportACKInterface );
 
     // describe export
-    AddExportOption( 0, "Export as text file" );
-    AddExportExtension( 0, "text", "txt" );
+    AddExportOption( EXPORT_TEXT, "Export as text file" );
+    AddExportExtension( EXPORT_TEXT, "text", "txt" );
+
+    AddExportOption( EXPORT_OPERATIONS, "Export as binary operation records" );
+    AddExportExtension( EXPORT_OPERATIONS, "binary operation records", "bin" );
+
+    AddExportOption( EXPORT_MEMORY_HEX, "Export memory image as Intel HEX" );
+    AddExportExtension( EXPORT_MEMORY_HEX, "Intel HEX", "hex" );
+
+    AddExportOption( EXPORT_MEMORY_BINARY, "Export memory image as raw binary" );
+    AddExportExtension( EXPORT_MEMORY_BINARY, "raw binary", "bin" );
+
+    AddExportOption( EXPORT_STATISTICS, "Export capture statistics" );
+    AddExportExtension( EXPORT_STATISTICS, "text", "txt" );
 
     ClearChannels();
 
-    AddChannel( mDIO, "DIO", false );
-    AddChannel( mCLK, "CLK", false );
+    AddChannel( mDIO[ 0 ], "DIO", false );
+    AddChannel( mCLK[ 0 ], "CLK", false );
 }
 
 RVSWDAnalyzerSettings::~RVSWDAnalyzerSettings()
@@ -33,39 +145,139 @@ RVSWDAnalyzerSettings::~RVSWDAnalyzerSettings()
 
 bool RVSWDAnalyzerSettings::SetSettingsFromInterfaces()
 {
-    if( mDIOInterface.GetChannel() == UNDEFINED_CHANNEL )
+    if( mDIOInterface[ 0 ].GetChannel() == UNDEFINED_CHANNEL )
     {
         SetErrorText( "Please select an input for the channel 1." );
         return false;
     }
 
-    if( mCLKInterface.GetChannel() == UNDEFINED_CHANNEL )
+    if( mCLKInterface[ 0 ].GetChannel() == UNDEFINED_CHANNEL )
     {
         SetErrorText( "Please select an input for the channel 2." );
         return false;
     }
 
-    mDIO = mDIOInterface.GetChannel();
-    mCLK = mCLKInterface.GetChannel();
+    // the buses that have both channels selected, in order
+    Channel dio[ MAX_BUSES ];
+    Channel clk[ MAX_BUSES ];
+    U32 num_buses = 0;
+    for( U32 bus = 0; bus < MAX_BUSES; ++bus )
+    {
+        Channel bus_dio( mDIOInterface[ bus ].GetChannel() );
+        Channel bus_clk( mCLKInterface[ bus ].GetChannel() );
+
+        if( bus_dio == UNDEFINED_CHANNEL && bus_clk == UNDEFINED_CHANNEL )
+            continue;
+
+        if( bus_dio == UNDEFINED_CHANNEL || bus_clk == UNDEFINED_CHANNEL )
+        {
+            SetErrorText( "Please select both DIO and CLK for every bus you use." );
+            return false;
+        }
+
+        dio[ num_buses ] = bus_dio;
+        clk[ num_buses ] = bus_clk;
+        ++num_buses;
+    }
+
+    for( U32 ndx = 0; ndx < num_buses * 2; ++ndx )
+    {
+        const Channel& ch( ndx & 1 ? clk[ ndx / 2 ] : dio[ ndx / 2 ] );
+        for( U32 other = ndx + 1; other < num_buses * 2; ++other )
+        {
+            if( ch == ( other & 1 ? clk[ other / 2 ] : dio[ other / 2 ] ) )
+            {
+                SetErrorText( "Please select different inputs for the channels." );
+                return false;
+            }
+        }
+    }
 
-    if( mDIO == mCLK )
+    std::string export_start( mExportStartInterface.GetText() );
+    std::string export_end( mExportEndInterface.GetText() );
+    bool start_set, end_set;
+    double start_time, end_time;
+    if( !ParseExportTime( export_start, start_set, start_time ) || !ParseExportTime( export_end, end_set, end_time ) )
     {
-        SetErrorText( "Please select different inputs for the channels." );
+        SetErrorText( "Please enter the export times in seconds, or leave them empty." );
         return false;
     }
 
-    ClearChannels();
+    if( start_set && end_set && end_time < start_time )
+    {
+        SetErrorText( "The export can't end before it starts." );
+        return false;
+    }
 
-    AddChannel( mDIO, "DIO", true );
-    AddChannel( mCLK, "CLK", true );
+    // everything's been checked, the settings only change together
+    for( U32 bus = 0; bus < MAX_BUSES; ++bus )
+    {
+        mDIO[ bus ] = bus < num_buses ? dio[ bus ] : UNDEFINED_CHANNEL;
+        mCLK[ bus ] = bus < num_buses ? clk[ bus ] : UNDEFINED_CHANNEL;
+    }
+
+    mNumBuses = num_buses;
+    mShowIdle = mShowIdleInterface.GetValue();
+
+    mExportStart = export_start;
+    mExportEnd = export_end;
+    mExportRegister = U32( mExportRegisterInterface.GetNumber() );
+    mExportRnW = U32( mExportRnWInterface.GetNumber() );
+    mExportPort = U32( mExportPortInterface.GetNumber() );
+    mExportACK = U32( mExportACKInterface.GetNumber() );
+
+    AddBusChannels();
 
     return true;
 }
 
+void RVSWDAnalyzerSettings::AddBusChannels()
+{
+    ClearChannels();
+
+    for( U32 bus = 0; bus < mNumBuses; ++bus )
+    {
+        AddChannel( mDIO[ bus ], mDIOTitle[ bus ].c_str(), true );
+        AddChannel( mCLK[ bus ], mCLKTitle[ bus ].c_str(), true );
+    }
+}
+
 void RVSWDAnalyzerSettings::UpdateInterfacesFromSettings()
 {
-    mDIOInterface.SetChannel( mDIO );
-    mCLKInterface.SetChannel( mCLK );
+    for( U32 bus = 0; bus < MAX_BUSES; ++bus )
+    {
+        mDIOInterface[ bus ].SetChannel( mDIO[ bus ] );
+        mCLKInterface[ bus ].SetChannel( mCLK[ bus ] );
+    }
+
+    mShowIdleInterface.SetValue( mShowIdle );
+
+    mExportStartInterface.SetText( mExportStart.c_str() );
+    mExportEndInterface.SetText( mExportEnd.c_str() );
+    mExportRegisterInterface.SetNumber( mExportRegister );
+    mExportRnWInterface.SetNumber( mExportRnW );
+    mExportPortInterface.SetNumber( mExportPort );
+    mExportACKInterface.SetNumber( mExportACK );
+}
+
+RVSWDExportFilter RVSWDAnalyzerSettings::GetExportFilter( U64 trigger_sample, U32 sample_rate ) const
+{
+    RVSWDExportFilter filter;
+
+    bool is_set;
+    double seconds;
+    if( ParseExportTime( mExportStart, is_set, seconds ) && is_set )
+        filter.start_sample = S64( trigger_sample ) + S64( std::ceil( seconds * sample_rate ) );
+
+    if( ParseExportTime( mExportEnd, is_set, seconds ) && is_set )
+        filter.end_sample = S64( trigger_sample ) + S64( std::floor( seconds * sample_rate ) );
+
+    filter.reg = RVSWDRegisters( mExportRegister );
+    filter.rnw = mExportRnW;
+    filter.port = mExportPort;
+    filter.ack = mExportACK;
+
+    return filter;
 }
 
 void RVSWDAnalyzerSettings::LoadSettings( const char* settings )
@@ -73,13 +285,47 @@ void RVSWDAnalyzerSettings::LoadSettings( const char* settings )
     SimpleArchive text_archive;
     text_archive.SetString( settings );
 
-    text_archive >> mDIO;
-    text_archive >> mCLK;
+    text_archive >> mDIO[ 0 ];
+    text_archive >> mCLK[ 0 ];
 
-    ClearChannels();
+    // settings saved before the idle option existed don't have it
+    if( !( text_archive >> mShowIdle ) )
+        mShowIdle = true;
+
+    // and the ones saved before there were more buses only have the first one
+    if( !( text_archive >> mNumBuses ) || mNumBuses < 1 || mNumBuses > MAX_BUSES )
+        mNumBuses = 1;
+
+    for( U32 bus = 1; bus < MAX_BUSES; ++bus )
+    {
+        if( bus >= mNumBuses || !( text_archive >> mDIO[ bus ] ) || !( text_archive >> mCLK[ bus ] ) )
+        {
+            mDIO[ bus ] = UNDEFINED_CHANNEL;
+            mCLK[ bus ] = UNDEFINED_CHANNEL;
+            mNumBuses = std::min( mNumBuses, bus );
+        }
+    }
 
-    AddChannel( mDIO, "DIO", true );
-    AddChannel( mCLK, "CLK", true );
+    // nor the export filter, which exports everything by default
+    const char* export_start;
+    const char* export_end;
+    if( text_archive >> &export_start && text_archive >> &export_end && text_archive >> mExportRegister && text_archive >> mExportRnW &&
+        text_archive >> mExportPort && text_archive >> mExportACK )
+    {
+        mExportStart = export_start;
+        mExportEnd = export_end;
+    }
+    else
+    {
+        mExportStart.clear();
+        mExportEnd.clear();
+        mExportRegister = RVSWDR_undefined;
+        mExportRnW = RVSWDExportFilter::ANY;
+        mExportPort = RVSWDExportFilter::ANY;
+        mExportACK = RVSWDExportFilter::ANY;
+    }
+
+    AddBusChannels();
 
     UpdateInterfacesFromSettings();
 }
@@ -88,8 +334,23 @@ const char* RVSWDAnalyzerSettings::SaveSettings()
 {
     SimpleArchive text_archive;
 
-    text_archive << mDIO;
-    text_archive << mCLK;
+    text_archive << mDIO[ 0 ];
+    text_archive << mCLK[ 0 ];
+    text_archive << mShowIdle;
+    text_archive << mNumBuses;
+
+    for( U32 bus = 1; bus < mNumBuses; ++bus )
+    {
+        text_archive << mDIO[ bus ];
+        text_archive << mCLK[ bus ];
+    }
+
+    text_archive << mExportStart.c_str();
+    text_archive << mExportEnd.c_str();
+    text_archive << mExportRegister;
+    text_archive << mExportRnW;
+    text_archive << mExportPort;
+    text_archive << mExportACK;
 
     return SetReturnString( text_archive.GetString() );
 }
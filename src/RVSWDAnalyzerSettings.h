@@ -5,10 +5,26 @@
 #include <AnalyzerTypes.h>
 
 #include "RVSWDTypes.h"
+#include "RVSWDExportFilter.h"
 
 class RVSWDAnalyzerSettings : public AnalyzerSettings
 {
   public:
+    enum
+    {
+        MAX_BUSES = 8,
+    };
+
+    // the export options
+    enum
+    {
+        EXPORT_TEXT,
+        EXPORT_OPERATIONS, // the binary operations file, see RVSWDOperationFile.h
+        EXPORT_MEMORY_HEX, // the memory the first bus wrote and read, see RVSWDMemoryImage.h
+        EXPORT_MEMORY_BINARY,
+        EXPORT_STATISTICS, // what the decoder counted, see RVSWDCaptureStats.h
+    };
+
     RVSWDAnalyzerSettings();
     virtual ~RVSWDAnalyzerSettings();
 
@@ -18,12 +34,44 @@ class RVSWDAnalyzerSettings : public AnalyzerSettings
 
     void UpdateInterfacesFromSettings();
 
-    Channel mDIO;
-    Channel mCLK;
+    // the export filter, with its range converted to samples
+    RVSWDExportFilter GetExportFilter( U64 trigger_sample, U32 sample_rate ) const;
+
+    // the first mNumBuses entries are the DIO/CLK pairs of the buses we decode
+    Channel mDIO[ MAX_BUSES ];
+    Channel mCLK[ MAX_BUSES ];
+    U32 mNumBuses;
+
+    bool mShowIdle;
+
+    // The range and filter of the exports. The times are in seconds from the trigger, as
+    // typed in, empty for the start or end of the capture. The rest are RVSWDExportFilter's.
+    // The SDK only has analyzer settings, and the app decodes the capture again whenever one
+    // of those changes, so changing the filter costs a whole decode before the export.
+    std::string mExportStart;
+    std::string mExportEnd;
+    U32 mExportRegister;
+    U32 mExportRnW;
+    U32 mExportPort;
+    U32 mExportACK;
 
   protected:
-    AnalyzerSettingInterfaceChannel mDIOInterface;
-    AnalyzerSettingInterfaceChannel mCLKInterface;
+    void AddBusChannels();
+
+    AnalyzerSettingInterfaceChannel mDIOInterface[ MAX_BUSES ];
+    AnalyzerSettingInterfaceChannel mCLKInterface[ MAX_BUSES ];
+    AnalyzerSettingInterfaceBool mShowIdleInterface;
+
+    AnalyzerSettingInterfaceText mExportStartInterface;
+    AnalyzerSettingInterfaceText mExportEndInterface;
+    AnalyzerSettingInterfaceNumberList mExportRegisterInterface;
+    AnalyzerSettingInterfaceNumberList mExportRnWInterface;
+    AnalyzerSettingInterfaceNumberList mExportPortInterface;
+    AnalyzerSettingInterfaceNumberList mExportACKInterface;
+
+    // the channel titles, "DIO", "CLK", "DIO 2", ...
+    std::string mDIOTitle[ MAX_BUSES ];
+    std::string mCLKTitle[ MAX_BUSES ];
 };
 
-#endif // RVSWD_ANALYZER_SETTINGS_H
\ No newline at end of file
+#endif // RVSWD_ANALYZER_SETTINGS_H
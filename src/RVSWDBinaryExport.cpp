@@ -0,0 +1,261 @@
+#include <cstring>
+#include <cmath>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "RVSWDBinaryExport.h"
+
+RVSWDBinaryChannelFile::RVSWDBinaryChannelFile()
+    : mData( 0 ), mSize( 0 ),
+#ifdef _WIN32
+      mFileHandle( INVALID_HANDLE_VALUE ), mMappingHandle( NULL ),
+#endif
+      mInitialState( BIT_LOW ), mBeginTime( 0 ), mNumTransitions( 0 ), mReleased( 0 )
+{
+}
+
+RVSWDBinaryChannelFile::~RVSWDBinaryChannelFile()
+{
+    Close();
+}
+
+bool RVSWDBinaryChannelFile::Open( const char* file_name )
+{
+    Close();
+
+#ifdef _WIN32
+    // the sequential scan hint makes Windows read ahead more aggressively
+    mFileHandle = CreateFileA( file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( mFileHandle == INVALID_HANDLE_VALUE )
+    {
+        mError = std::string( "can't open " ) + file_name;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx( mFileHandle, &size ) )
+    {
+        mError = std::string( "can't read " ) + file_name;
+        Close();
+        return false;
+    }
+
+    mSize = U64( size.QuadPart );
+    if( mSize > 0 )
+    {
+        mMappingHandle = CreateFileMappingA( mFileHandle, NULL, PAGE_READONLY, 0, 0, NULL );
+        if( mMappingHandle != NULL )
+            mData = ( const U8* )MapViewOfFile( mMappingHandle, FILE_MAP_READ, 0, 0, 0 );
+    }
+#else
+    int fd = open( file_name, O_RDONLY );
+    if( fd < 0 )
+    {
+        mError = std::string( "can't open " ) + file_name;
+        return false;
+    }
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 )
+    {
+        close( fd );
+        mError = std::string( "can't read " ) + file_name;
+        return false;
+    }
+
+    mSize = U64( st.st_size );
+    if( mSize > 0 )
+    {
+        void* data = mmap( NULL, size_t( mSize ), PROT_READ, MAP_PRIVATE, fd, 0 );
+        if( data != MAP_FAILED )
+        {
+            mData = ( const U8* )data;
+
+            // the transitions are read front to back once, so read ahead as far as the kernel will,
+            // and let it back the mapping with huge pages where the file system can
+            madvise( data, size_t( mSize ), MADV_SEQUENTIAL );
+#ifdef MADV_HUGEPAGE
+            madvise( data, size_t( mSize ), MADV_HUGEPAGE );
+#endif
+        }
+    }
+
+    // the mapping keeps the file open
+    close( fd );
+#endif
+
+    if( mData == 0 && mSize > 0 )
+    {
+        mError = std::string( "can't map " ) + file_name;
+        Close();
+        return false;
+    }
+
+    // the header
+    S32 version;
+    S32 type;
+    U32 initial_state;
+    if( mSize < HEADER_SIZE || memcmp( mData, "<SALEAE>", 8 ) != 0 )
+    {
+        mError = std::string( file_name ) + " isn't a Logic 2 binary export";
+        Close();
+        return false;
+    }
+
+    memcpy( &version, mData + 8, 4 );
+    memcpy( &type, mData + 12, 4 );
+    memcpy( &initial_state, mData + 16, 4 );
+    memcpy( &mBeginTime, mData + 20, 8 );
+    memcpy( &mNumTransitions, mData + 36, 8 );
+
+    if( version != 0 || type != 0 )
+    {
+        mError = std::string( file_name ) + " isn't a digital channel of a version 0 binary export";
+        Close();
+        return false;
+    }
+
+    if( ( mSize - HEADER_SIZE ) / 8 < mNumTransitions )
+    {
+        mError = std::string( file_name ) + " is truncated";
+        Close();
+        return false;
+    }
+
+    mInitialState = initial_state ? BIT_HIGH : BIT_LOW;
+    mReleased = 0;
+
+    return true;
+}
+
+void RVSWDBinaryChannelFile::Close()
+{
+#ifdef _WIN32
+    if( mData != 0 )
+        UnmapViewOfFile( mData );
+
+    if( mMappingHandle != NULL )
+        CloseHandle( mMappingHandle );
+
+    if( mFileHandle != INVALID_HANDLE_VALUE )
+        CloseHandle( mFileHandle );
+
+    mMappingHandle = NULL;
+    mFileHandle = INVALID_HANDLE_VALUE;
+#else
+    if( mData != 0 )
+        munmap( ( void* )mData, size_t( mSize ) );
+#endif
+
+    mData = 0;
+    mSize = 0;
+    mNumTransitions = 0;
+}
+
+double RVSWDBinaryChannelFile::GetTransitionTime( U64 ndx ) const
+{
+    double time;
+    memcpy( &time, mData + HEADER_SIZE + ndx * 8, 8 );
+    return time;
+}
+
+void RVSWDBinaryChannelFile::ReleaseBefore( U64 ndx )
+{
+#ifndef _WIN32
+    // only whole pages, the mapping starts at a page boundary
+    U64 page_size = U64( sysconf( _SC_PAGESIZE ) );
+    U64 end = ( HEADER_SIZE + ndx * 8 ) / page_size * page_size;
+    if( end <= mReleased )
+        return;
+
+    // the pages are read again from the file if they're ever touched
+    madvise( ( void* )( mData + mReleased ), size_t( end - mReleased ), MADV_DONTNEED );
+    mReleased = end;
+#endif
+}
+
+// ********************************************************************************
+
+RVSWDBinaryChannel::RVSWDBinaryChannel()
+    : mFile( 0 ), mStartTime( 0 ), mSampleRate( 0 ), mState( BIT_LOW ), mSampleNumber( 0 ), mNextEdge( 0 ), mNextRelease( RELEASE_EDGES )
+{
+}
+
+void RVSWDBinaryChannel::Setup( RVSWDBinaryChannelFile* pFile, double start_time, U64 sample_rate )
+{
+    mFile = pFile;
+    mStartTime = start_time;
+    mSampleRate = double( sample_rate );
+    mState = pFile->GetInitialState();
+    mSampleNumber = 0;
+    mNextEdge = 0;
+    mNextRelease = RELEASE_EDGES;
+}
+
+U64 RVSWDBinaryChannel::GetEdge( U64 ndx ) const
+{
+    // rounded like the CSV export's times
+    return U64( std::floor( ( mFile->GetTransitionTime( ndx ) - mStartTime ) * mSampleRate + 0.5 ) );
+}
+
+U64 RVSWDBinaryChannel::GetSampleNumber()
+{
+    return mSampleNumber;
+}
+
+BitState RVSWDBinaryChannel::GetBitState()
+{
+    return mState;
+}
+
+void RVSWDBinaryChannel::AdvanceToNextEdge()
+{
+    if( mNextEdge == mFile->GetNumTransitions() )
+        throw RVSWDEndOfData();
+
+    mSampleNumber = GetEdge( mNextEdge++ );
+    mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+
+    if( mNextEdge >= mNextRelease )
+    {
+        mFile->ReleaseBefore( mNextEdge );
+        mNextRelease = mNextEdge + RELEASE_EDGES;
+    }
+}
+
+void RVSWDBinaryChannel::AdvanceToAbsPosition( U64 sample_number )
+{
+    while( mNextEdge < mFile->GetNumTransitions() && GetEdge( mNextEdge ) <= sample_number )
+    {
+        mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+        ++mNextEdge;
+    }
+
+    mSampleNumber = sample_number;
+
+    if( mNextEdge >= mNextRelease )
+    {
+        mFile->ReleaseBefore( mNextEdge );
+        mNextRelease = mNextEdge + RELEASE_EDGES;
+    }
+}
+
+U64 RVSWDBinaryChannel::GetSampleOfNextEdge()
+{
+    if( mNextEdge == mFile->GetNumTransitions() )
+        throw RVSWDEndOfData();
+
+    return GetEdge( mNextEdge );
+}
+
+bool RVSWDBinaryChannel::DoMoreTransitionsExistInCurrentData()
+{
+    return mNextEdge < mFile->GetNumTransitions();
+}
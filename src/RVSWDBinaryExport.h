@@ -0,0 +1,106 @@
+#ifndef RVSWD_BINARY_EXPORT_H
+#define RVSWD_BINARY_EXPORT_H
+
+#include <string>
+
+#include "RVSWDParser.h"
+
+// One channel file of a Logic 2 binary digital export, mapped into memory. The file is
+// "<SALEAE>", the version and type (0, digital), the initial state, the begin and end times
+// and the number of transitions, followed by the times of the transitions, all little endian.
+// Opening only maps the file and checks the header, whatever its size.
+class RVSWDBinaryChannelFile
+{
+  public:
+    enum
+    {
+        HEADER_SIZE = 8 + 4 + 4 + 4 + 8 + 8 + 8,
+    };
+
+    RVSWDBinaryChannelFile();
+    ~RVSWDBinaryChannelFile();
+
+    bool Open( const char* file_name );
+    void Close();
+
+    const std::string& GetError() const
+    {
+        return mError;
+    }
+
+    BitState GetInitialState() const
+    {
+        return mInitialState;
+    }
+
+    double GetBeginTime() const
+    {
+        return mBeginTime;
+    }
+
+    U64 GetNumTransitions() const
+    {
+        return mNumTransitions;
+    }
+
+    // in seconds, the times in the file aren't aligned
+    double GetTransitionTime( U64 ndx ) const;
+
+    // the transitions before ndx won't be read again, their pages can go
+    void ReleaseBefore( U64 ndx );
+
+  protected:
+    const U8* mData;
+    U64 mSize;
+#ifdef _WIN32
+    void* mFileHandle;
+    void* mMappingHandle;
+#endif
+
+    BitState mInitialState;
+    double mBeginTime;
+    U64 mNumTransitions;
+
+    // the pages up to here have been released
+    U64 mReleased;
+
+    std::string mError;
+};
+
+// Reads the transitions of a mapped channel file as edges, straight from the mapping.
+class RVSWDBinaryChannel : public RVSWDChannel
+{
+  public:
+    enum
+    {
+        RELEASE_EDGES = 1 << 23, // 64 MB of transition times
+    };
+
+    RVSWDBinaryChannel();
+
+    // sample 0 is at start_time
+    void Setup( RVSWDBinaryChannelFile* pFile, double start_time, U64 sample_rate );
+
+    virtual U64 GetSampleNumber();
+    virtual BitState GetBitState();
+
+    virtual void AdvanceToNextEdge();
+    virtual void AdvanceToAbsPosition( U64 sample_number );
+    virtual U64 GetSampleOfNextEdge();
+
+    virtual bool DoMoreTransitionsExistInCurrentData();
+
+  protected:
+    U64 GetEdge( U64 ndx ) const;
+
+    RVSWDBinaryChannelFile* mFile;
+    double mStartTime;
+    double mSampleRate;
+
+    BitState mState;
+    U64 mSampleNumber;
+    U64 mNextEdge;
+    U64 mNextRelease;
+};
+
+#endif // RVSWD_BINARY_EXPORT_H
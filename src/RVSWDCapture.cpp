@@ -0,0 +1,434 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+#include "RVSWDCapture.h"
+
+RVSWDCaptureChannel::RVSWDCaptureChannel() : mEdges( 0 ), mNumEdges( 0 ), mState( BIT_LOW ), mSampleNumber( 0 ), mNextEdge( 0 )
+{
+}
+
+void RVSWDCaptureChannel::Setup( const U64* edges, size_t num_edges, BitState state, U64 sample_number )
+{
+    mEdges = edges;
+    mNumEdges = num_edges;
+    mState = state;
+    mSampleNumber = sample_number;
+    mNextEdge = 0;
+}
+
+U64 RVSWDCaptureChannel::GetSampleNumber()
+{
+    return mSampleNumber;
+}
+
+BitState RVSWDCaptureChannel::GetBitState()
+{
+    return mState;
+}
+
+void RVSWDCaptureChannel::AdvanceToNextEdge()
+{
+    if( mNextEdge == mNumEdges )
+        throw RVSWDEndOfData();
+
+    mSampleNumber = mEdges[ mNextEdge++ ];
+    mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+}
+
+void RVSWDCaptureChannel::AdvanceToAbsPosition( U64 sample_number )
+{
+    while( mNextEdge < mNumEdges && mEdges[ mNextEdge ] <= sample_number )
+    {
+        mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+        ++mNextEdge;
+    }
+
+    mSampleNumber = sample_number;
+}
+
+U64 RVSWDCaptureChannel::GetSampleOfNextEdge()
+{
+    if( mNextEdge == mNumEdges )
+        throw RVSWDEndOfData();
+
+    return mEdges[ mNextEdge ];
+}
+
+bool RVSWDCaptureChannel::DoMoreTransitionsExistInCurrentData()
+{
+    return mNextEdge < mNumEdges;
+}
+
+// ********************************************************************************
+
+enum CSVLine
+{
+    CSV_SAMPLE,
+    CSV_NO_SAMPLE,
+    CSV_MISSING_COLUMN,
+};
+
+// parses a line of a Logic 2 digital CSV export: the time, then the channels
+static CSVLine ParseCSVLine( char* line, size_t dio_column, size_t clk_column, double& time, BitState& dio, BitState& clk )
+{
+    char* pos;
+    time = strtod( line, &pos );
+    if( pos == line )
+        return CSV_NO_SAMPLE;
+
+    dio = BIT_LOW;
+    clk = BIT_LOW;
+    size_t column = 0;
+    size_t found = 0;
+    while( *pos == ',' )
+    {
+        char* next;
+        long value = strtol( pos + 1, &next, 10 );
+        if( next == pos + 1 )
+            break;
+
+        if( column == dio_column )
+        {
+            dio = value ? BIT_HIGH : BIT_LOW;
+            ++found;
+        }
+
+        if( column == clk_column )
+        {
+            clk = value ? BIT_HIGH : BIT_LOW;
+            ++found;
+        }
+
+        ++column;
+        pos = next;
+    }
+
+    return found < ( dio_column == clk_column ? 1 : 2 ) ? CSV_MISSING_COLUMN : CSV_SAMPLE;
+}
+
+static std::string GetMissingColumnError( const char* file_name, size_t line_num )
+{
+    char msg[ 64 ];
+    snprintf( msg, sizeof( msg ), ":%u: missing the DIO or CLK column", unsigned( line_num ) );
+    return file_name + std::string( msg );
+}
+
+static U64 GetSampleNumber( double time, double start_time, U64 sample_rate )
+{
+    return U64( std::floor( ( time - start_time ) * double( sample_rate ) + 0.5 ) );
+}
+
+// ********************************************************************************
+
+RVSWDCapture::RVSWDCapture() : mDIOInitialState( BIT_LOW ), mCLKInitialState( BIT_LOW ), mStartTime( 0 ), mSampleRate( 0 )
+{
+}
+
+void RVSWDCapture::SetupDIO( RVSWDCaptureChannel& channel ) const
+{
+    channel.Setup( mDIOEdges.data(), mDIOEdges.size(), mDIOInitialState, 0 );
+}
+
+void RVSWDCapture::SetupCLK( RVSWDCaptureChannel& channel ) const
+{
+    channel.Setup( mCLKEdges.data(), mCLKEdges.size(), mCLKInitialState, 0 );
+}
+
+bool RVSWDCapture::LoadCSV( const char* file_name, size_t dio_column, size_t clk_column, U64 sample_rate )
+{
+    FILE* f = fopen( file_name, "r" );
+    if( f == NULL )
+    {
+        mError = std::string( "can't open " ) + file_name;
+        return false;
+    }
+
+    mSampleRate = sample_rate;
+
+    char line[ 4096 ];
+
+    // skip the header
+    if( fgets( line, sizeof( line ), f ) == NULL )
+    {
+        fclose( f );
+        mError = std::string( file_name ) + " is empty";
+        return false;
+    }
+
+    std::vector<U64> dio_edges;
+    std::vector<U64> clk_edges;
+    BitState dio_state = BIT_LOW;
+    BitState clk_state = BIT_LOW;
+
+    size_t line_num = 1;
+    while( fgets( line, sizeof( line ), f ) != NULL )
+    {
+        ++line_num;
+
+        double time;
+        BitState dio;
+        BitState clk;
+        CSVLine parsed = ParseCSVLine( line, dio_column, clk_column, time, dio, clk );
+        if( parsed == CSV_NO_SAMPLE )
+            continue;
+
+        if( parsed == CSV_MISSING_COLUMN )
+        {
+            fclose( f );
+            mError = GetMissingColumnError( file_name, line_num );
+            return false;
+        }
+
+        // the first line has the states at the start of the capture
+        if( line_num == 2 )
+        {
+            mStartTime = time;
+            mDIOInitialState = dio_state = dio;
+            mCLKInitialState = clk_state = clk;
+            continue;
+        }
+
+        U64 sample_number = GetSampleNumber( time, mStartTime, sample_rate );
+
+        if( dio != dio_state )
+        {
+            dio_edges.push_back( sample_number );
+            dio_state = dio;
+        }
+
+        if( clk != clk_state )
+        {
+            clk_edges.push_back( sample_number );
+            clk_state = clk;
+        }
+    }
+
+    fclose( f );
+
+    if( line_num < 2 )
+    {
+        mError = std::string( file_name ) + " has no samples";
+        return false;
+    }
+
+    mDIOEdges.swap( dio_edges );
+    mCLKEdges.swap( clk_edges );
+
+    return true;
+}
+
+// ********************************************************************************
+
+RVSWDStreamChannel::RVSWDStreamChannel() : mStream( 0 ), mIsCLK( false ), mNextEdge( 0 ), mState( BIT_LOW ), mSampleNumber( 0 )
+{
+}
+
+void RVSWDStreamChannel::Setup( RVSWDCaptureStream* pStream, bool is_clk, BitState state )
+{
+    mStream = pStream;
+    mIsCLK = is_clk;
+    mEdges.clear();
+    mNextEdge = 0;
+    mState = state;
+    mSampleNumber = 0;
+}
+
+void RVSWDStreamChannel::PushEdge( U64 sample_number )
+{
+    // drop the passed edges once they're the bigger part of the buffer, so it doesn't grow
+    if( mNextEdge > 0 && mNextEdge >= mEdges.size() - mNextEdge )
+    {
+        mEdges.erase( mEdges.begin(), mEdges.begin() + mNextEdge );
+        mNextEdge = 0;
+    }
+
+    mEdges.push_back( sample_number );
+}
+
+U64 RVSWDStreamChannel::GetSampleNumber()
+{
+    return mSampleNumber;
+}
+
+BitState RVSWDStreamChannel::GetBitState()
+{
+    return mState;
+}
+
+void RVSWDStreamChannel::AdvanceToNextEdge()
+{
+    while( mNextEdge == mEdges.size() )
+    {
+        if( !mStream->ReadRows( RVSWDCaptureStream::READ_AHEAD_ROWS ) && mNextEdge == mEdges.size() )
+            throw RVSWDEndOfData();
+    }
+
+    mSampleNumber = mEdges[ mNextEdge++ ];
+    mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+}
+
+void RVSWDStreamChannel::AdvanceToAbsPosition( U64 sample_number )
+{
+    while( mNextEdge < mEdges.size() && mEdges[ mNextEdge ] <= sample_number )
+    {
+        mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+        ++mNextEdge;
+    }
+
+    mSampleNumber = sample_number;
+}
+
+U64 RVSWDStreamChannel::GetSampleOfNextEdge()
+{
+    while( mNextEdge == mEdges.size() )
+    {
+        if( !mStream->ReadRows( RVSWDCaptureStream::READ_AHEAD_ROWS ) && mNextEdge == mEdges.size() )
+            throw RVSWDEndOfData();
+    }
+
+    return mEdges[ mNextEdge ];
+}
+
+bool RVSWDStreamChannel::DoMoreTransitionsExistInCurrentData()
+{
+    while( mIsCLK && mNextEdge == mEdges.size() )
+    {
+        if( !mStream->ReadRows( RVSWDCaptureStream::READ_AHEAD_ROWS ) )
+            break;
+    }
+
+    return mNextEdge < mEdges.size();
+}
+
+// ********************************************************************************
+
+RVSWDCaptureStream::RVSWDCaptureStream()
+    : mFile( NULL ), mDIOColumn( 0 ), mCLKColumn( 0 ), mLineNum( 0 ), mStartTime( 0 ), mSampleRate( 0 ), mDIOInitialState( BIT_LOW ),
+      mCLKInitialState( BIT_LOW ), mDIOState( BIT_LOW ), mCLKState( BIT_LOW ), mDIO( 0 ), mCLK( 0 ), mLastCLKEdge( 0 ), mMaxBufferedEdges( 0 )
+{
+}
+
+RVSWDCaptureStream::~RVSWDCaptureStream()
+{
+    if( mFile != NULL )
+        fclose( mFile );
+}
+
+bool RVSWDCaptureStream::Open( const char* file_name, size_t dio_column, size_t clk_column, U64 sample_rate )
+{
+    mFileName = file_name;
+    mFile = fopen( file_name, "r" );
+    if( mFile == NULL )
+    {
+        mError = std::string( "can't open " ) + file_name;
+        return false;
+    }
+
+    mDIOColumn = dio_column;
+    mCLKColumn = clk_column;
+    mSampleRate = sample_rate;
+
+    char line[ 4096 ];
+
+    // skip the header
+    if( fgets( line, sizeof( line ), mFile ) == NULL )
+    {
+        mError = mFileName + " is empty";
+        return false;
+    }
+
+    // the first line has the states at the start of the capture
+    mLineNum = 1;
+    while( fgets( line, sizeof( line ), mFile ) != NULL )
+    {
+        ++mLineNum;
+
+        BitState dio;
+        BitState clk;
+        CSVLine parsed = ParseCSVLine( line, mDIOColumn, mCLKColumn, mStartTime, dio, clk );
+        if( parsed == CSV_NO_SAMPLE )
+            continue;
+
+        if( parsed == CSV_MISSING_COLUMN )
+        {
+            mError = GetMissingColumnError( file_name, mLineNum );
+            return false;
+        }
+
+        mDIOInitialState = mDIOState = dio;
+        mCLKInitialState = mCLKState = clk;
+
+        return true;
+    }
+
+    mError = mFileName + " has no samples";
+    return false;
+}
+
+void RVSWDCaptureStream::Setup( RVSWDStreamChannel& dio, RVSWDStreamChannel& clk )
+{
+    mDIO = &dio;
+    mCLK = &clk;
+    dio.Setup( this, false, mDIOInitialState );
+    clk.Setup( this, true, mCLKInitialState );
+}
+
+bool RVSWDCaptureStream::ReadRows( size_t num_rows )
+{
+    if( mFile == NULL )
+        return false;
+
+    char line[ 4096 ];
+    size_t row = 0;
+    while( row < num_rows && fgets( line, sizeof( line ), mFile ) != NULL )
+    {
+        ++mLineNum;
+
+        double time;
+        BitState dio;
+        BitState clk;
+        CSVLine parsed = ParseCSVLine( line, mDIOColumn, mCLKColumn, time, dio, clk );
+        if( parsed == CSV_NO_SAMPLE )
+            continue;
+
+        if( parsed == CSV_MISSING_COLUMN )
+        {
+            mError = GetMissingColumnError( mFileName.c_str(), mLineNum );
+            break;
+        }
+
+        ++row;
+
+        U64 sample_number = GetSampleNumber( time, mStartTime, mSampleRate );
+
+        if( dio != mDIOState )
+        {
+            // CLK isn't sampling DIO between two edges after its last one, they can go
+            if( mDIO->GetNumBuffered() > 0 && mDIO->mEdges.back() > mLastCLKEdge )
+                mDIO->mEdges.pop_back();
+            else
+                mDIO->PushEdge( sample_number );
+
+            mDIOState = dio;
+        }
+
+        if( clk != mCLKState )
+        {
+            mCLK->PushEdge( sample_number );
+            mLastCLKEdge = sample_number;
+            mCLKState = clk;
+        }
+    }
+
+    mMaxBufferedEdges = std::max( mMaxBufferedEdges, mDIO->GetNumBuffered() + mCLK->GetNumBuffered() );
+
+    if( row < num_rows )
+    {
+        fclose( mFile );
+        mFile = NULL;
+    }
+
+    return row > 0;
+}
@@ -0,0 +1,216 @@
+#ifndef RVSWD_CAPTURE_H
+#define RVSWD_CAPTURE_H
+
+#include <cstdio>
+#include <vector>
+#include <string>
+
+#include "RVSWDParser.h"
+
+// Reads a range of the edges of one channel of a capture loaded from a file.
+// Reading past the last edge throws RVSWDEndOfData.
+class RVSWDCaptureChannel : public RVSWDChannel
+{
+  public:
+    RVSWDCaptureChannel();
+
+    // the channel starts at sample_number in state, and then goes through
+    // the num_edges sorted edges, which stay owned by the caller
+    void Setup( const U64* edges, size_t num_edges, BitState state, U64 sample_number );
+
+    virtual U64 GetSampleNumber();
+    virtual BitState GetBitState();
+
+    virtual void AdvanceToNextEdge();
+    virtual void AdvanceToAbsPosition( U64 sample_number );
+    virtual U64 GetSampleOfNextEdge();
+
+    virtual bool DoMoreTransitionsExistInCurrentData();
+
+  protected:
+    const U64* mEdges;
+    size_t mNumEdges;
+
+    BitState mState;
+    U64 mSampleNumber;
+    size_t mNextEdge;
+};
+
+// DIO and CLK of a capture exported from Logic 2, for the headless decoder.
+class RVSWDCapture
+{
+  public:
+    RVSWDCapture();
+
+    // Loads a Logic 2 digital CSV export: a header line, then one line for the start of the
+    // capture and one for every transition, with the time in seconds and the state of each
+    // channel. dio_column and clk_column count the channel columns from 0. Times are
+    // converted to sample numbers with sample_rate.
+    bool LoadCSV( const char* file_name, size_t dio_column, size_t clk_column, U64 sample_rate );
+
+    const std::string& GetError() const
+    {
+        return mError;
+    }
+
+    // sets channel up to read DIO or CLK from the start of the capture
+    void SetupDIO( RVSWDCaptureChannel& channel ) const;
+    void SetupCLK( RVSWDCaptureChannel& channel ) const;
+
+    const std::vector<U64>& GetDIOEdges() const
+    {
+        return mDIOEdges;
+    }
+
+    const std::vector<U64>& GetCLKEdges() const
+    {
+        return mCLKEdges;
+    }
+
+    BitState GetDIOInitialState() const
+    {
+        return mDIOInitialState;
+    }
+
+    BitState GetCLKInitialState() const
+    {
+        return mCLKInitialState;
+    }
+
+    // the time of sample 0 in seconds
+    double GetStartTime() const
+    {
+        return mStartTime;
+    }
+
+    U64 GetSampleRate() const
+    {
+        return mSampleRate;
+    }
+
+  protected:
+    std::vector<U64> mDIOEdges;
+    std::vector<U64> mCLKEdges;
+    BitState mDIOInitialState;
+    BitState mCLKInitialState;
+
+    double mStartTime;
+    U64 mSampleRate;
+
+    std::string mError;
+};
+
+class RVSWDCaptureStream;
+
+// One channel of a capture that's streamed from a file. Only the edges that have been
+// read but not passed yet are kept. Reading past the last edge throws RVSWDEndOfData.
+class RVSWDStreamChannel : public RVSWDChannel
+{
+  public:
+    RVSWDStreamChannel();
+
+    void Setup( RVSWDCaptureStream* pStream, bool is_clk, BitState state );
+
+    virtual U64 GetSampleNumber();
+    virtual BitState GetBitState();
+
+    virtual void AdvanceToNextEdge();
+    virtual void AdvanceToAbsPosition( U64 sample_number );
+    virtual U64 GetSampleOfNextEdge();
+
+    // CLK reads ahead when it runs out of edges. DIO is only ever sampled at CLK's edges,
+    // and they're read together with all the DIO edges before them, so DIO never reads.
+    virtual bool DoMoreTransitionsExistInCurrentData();
+
+    size_t GetNumBuffered() const
+    {
+        return mEdges.size() - mNextEdge;
+    }
+
+  protected:
+    friend class RVSWDCaptureStream;
+
+    void PushEdge( U64 sample_number );
+
+    RVSWDCaptureStream* mStream;
+    bool mIsCLK;
+
+    // the edges from mNextEdge on haven't been passed yet
+    std::vector<U64> mEdges;
+    size_t mNextEdge;
+
+    BitState mState;
+    U64 mSampleNumber;
+};
+
+// Streams DIO and CLK from a Logic 2 digital CSV export, for the headless decoder, in
+// a fixed amount of memory whatever the length of the capture.
+class RVSWDCaptureStream
+{
+  public:
+    enum
+    {
+        READ_AHEAD_ROWS = 4096,
+    };
+
+    RVSWDCaptureStream();
+    ~RVSWDCaptureStream();
+
+    // opens the file and reads the states at the start of the capture, the arguments are as for RVSWDCapture::LoadCSV
+    bool Open( const char* file_name, size_t dio_column, size_t clk_column, U64 sample_rate );
+
+    // sets the channels up to read from the start of the capture
+    void Setup( RVSWDStreamChannel& dio, RVSWDStreamChannel& clk );
+
+    // Reads up to num_rows more rows into the channels. Returns false at the end of
+    // the file, or if a row couldn't be read, in which case GetError says why.
+    bool ReadRows( size_t num_rows );
+
+    const std::string& GetError() const
+    {
+        return mError;
+    }
+
+    double GetStartTime() const
+    {
+        return mStartTime;
+    }
+
+    U64 GetSampleRate() const
+    {
+        return mSampleRate;
+    }
+
+    // the most edges the channels held at once
+    size_t GetMaxBufferedEdges() const
+    {
+        return mMaxBufferedEdges;
+    }
+
+  protected:
+    std::string mFileName;
+    FILE* mFile;
+    size_t mDIOColumn;
+    size_t mCLKColumn;
+    size_t mLineNum;
+
+    double mStartTime;
+    U64 mSampleRate;
+
+    BitState mDIOInitialState;
+    BitState mCLKInitialState;
+    BitState mDIOState;
+    BitState mCLKState;
+
+    RVSWDStreamChannel* mDIO;
+    RVSWDStreamChannel* mCLK;
+
+    // the sample of the last CLK edge read, DIO edges after it come in pairs that cancel out
+    U64 mLastCLKEdge;
+
+    size_t mMaxBufferedEdges;
+
+    std::string mError;
+};
+
+#endif // RVSWD_CAPTURE_H
@@ -0,0 +1,92 @@
+#include <cstring>
+#include <algorithm>
+
+#include "RVSWDCaptureStats.h"
+
+void RVSWDCaptureStats::Clear()
+{
+    memset( this, 0, sizeof( *this ) );
+}
+
+void RVSWDCaptureStats::Add( const RVSWDCaptureStats& later )
+{
+    // our open run ends where the later part starts, its open run is the one that's open now
+    EndDroppedRun();
+
+    if( later.num_clock_periods != 0 )
+    {
+        min_period = num_clock_periods == 0 ? later.min_period : std::min( min_period, later.min_period );
+        max_period = num_clock_periods == 0 ? later.max_period : std::max( max_period, later.max_period );
+    }
+
+    num_operations += later.num_operations;
+    for( size_t ndx = 0; ndx < NUM_REGISTERS; ++ndx )
+    {
+        num_reads[ ndx ] += later.num_reads[ ndx ];
+        num_writes[ ndx ] += later.num_writes[ ndx ];
+    }
+    for( size_t ndx = 0; ndx < NUM_ACKS; ++ndx )
+        num_acks[ ndx ] += later.num_acks[ ndx ];
+    num_no_data += later.num_no_data;
+    num_parity_errors += later.num_parity_errors;
+    num_operation_bits += later.num_operation_bits;
+
+    num_line_resets += later.num_line_resets;
+    num_line_reset_bits += later.num_line_reset_bits;
+    num_idle_periods += later.num_idle_periods;
+    num_idle_bits += later.num_idle_bits;
+
+    num_dropped_bits += later.num_dropped_bits;
+    num_dropped_runs += later.num_dropped_runs;
+    longest_dropped_run = std::max( longest_dropped_run, later.longest_dropped_run );
+    dropped_run = later.dropped_run;
+
+    num_clock_periods += later.num_clock_periods;
+    clock_samples += later.clock_samples;
+}
+
+void RVSWDCaptureStats::Write( FILE* f, U64 sample_rate ) const
+{
+    // the open run counts as if it had ended
+    U64 num_runs = num_dropped_runs + ( dropped_run != 0 ? 1 : 0 );
+    U64 longest_run = std::max( longest_dropped_run, dropped_run );
+
+    U64 num_bits = num_operation_bits + num_idle_bits + num_line_reset_bits + num_dropped_bits;
+    fprintf( f, "bits: %llu, %llu in operations, %llu idle, %llu in line resets, %llu dropped (%.3f%%)\n", num_bits, num_operation_bits,
+             num_idle_bits, num_line_reset_bits, num_dropped_bits, num_bits != 0 ? 100.0 * double( num_dropped_bits ) / double( num_bits ) : 0.0 );
+    fprintf( f, "dropped runs: %llu, the longest %llu bits\n", num_runs, longest_run );
+
+    fprintf( f, "operations: %llu, %llu without a data phase, %llu more dropped for a data parity error\n", num_operations, num_no_data,
+             num_parity_errors );
+
+    U64 num_other_acks = 0;
+    for( size_t ndx = 0; ndx < NUM_ACKS; ++ndx )
+    {
+        if( ndx != ACK_OK && ndx != ACK_WAIT && ndx != ACK_FAULT )
+            num_other_acks += num_acks[ ndx ];
+    }
+
+    fprintf( f, "ACK: OK %llu, WAIT %llu, FAULT %llu, other %llu\n", num_acks[ ACK_OK ], num_acks[ ACK_WAIT ], num_acks[ ACK_FAULT ],
+             num_other_acks );
+    fprintf( f, "line resets: %llu\n", num_line_resets );
+    fprintf( f, "idle periods: %llu\n", num_idle_periods );
+
+    // a period in samples is sample_rate / period Hz
+    if( num_clock_periods != 0 && clock_samples != 0 && min_period > 0 )
+    {
+        fprintf( f, "SWCLK: %.3f MHz on average, %.3f to %.3f MHz per operation\n",
+                 double( sample_rate ) * double( num_clock_periods ) / double( clock_samples ) / 1e6, double( sample_rate ) / max_period / 1e6,
+                 double( sample_rate ) / min_period / 1e6 );
+    }
+    else
+    {
+        fprintf( f, "SWCLK: no operations to measure it on\n" );
+    }
+
+    fprintf( f, "register\treads\twrites\n" );
+    for( size_t ndx = 0; ndx < NUM_REGISTERS; ++ndx )
+    {
+        if( num_reads[ ndx ] != 0 || num_writes[ ndx ] != 0 )
+            fprintf( f, "%s\t%llu\t%llu\n", GetRegisterName( RVSWDRegisters( ndx ) ), num_reads[ ndx ], num_writes[ ndx ] );
+    }
+}
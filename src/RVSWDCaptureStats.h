@@ -0,0 +1,121 @@
+#ifndef RVSWD_CAPTURE_STATS_H
+#define RVSWD_CAPTURE_STATS_H
+
+#include <cstdio>
+
+#include "RVSWDTypes.h"
+
+// What the decoder saw on a bus, counted as it decodes. The counters are plain members so
+// the decode loops only pay for a few increments per operation, and the struct can be
+// zeroed with memset and copied to whoever shows it. Every bit the parser read, but the
+// few still buffered when the data ends, is counted in an operation, an idle period, a
+// line reset or a dropped run, the bits SkipToCandidate threw away. A dropped run ends
+// at the next thing that was decoded.
+struct RVSWDCaptureStats
+{
+    enum
+    {
+        NUM_REGISTERS = RVSWDR_AP_IDR + 1,
+        NUM_ACKS = 8, // indexed by the 3 ACK bits
+    };
+
+    U64 num_operations;
+    U64 num_reads[ NUM_REGISTERS ];
+    U64 num_writes[ NUM_REGISTERS ];
+    U64 num_acks[ NUM_ACKS ];
+    U64 num_no_data;       // operations that ended after the ACK
+    U64 num_parity_errors; // requests with an OK ACK turned down for their data parity, their bits are dropped
+    U64 num_operation_bits;
+
+    U64 num_line_resets;
+    U64 num_line_reset_bits;
+    U64 num_idle_periods;
+    U64 num_idle_bits;
+
+    U64 num_dropped_bits;
+    U64 num_dropped_runs; // the ones that have ended
+    U64 longest_dropped_run;
+    U64 dropped_run;      // bits in the run that's still open
+
+    // SWCLK, from the rising edges of the operations' bits
+    U64 num_clock_periods;
+    U64 clock_samples;
+    double min_period; // the fastest and slowest operation, in samples per bit
+    double max_period;
+
+    void Clear();
+
+    // adds what a later part of the same bus saw, the parallel decoder's segments
+    void Add( const RVSWDCaptureStats& later );
+
+    void AddOperation( RVSWDOperation& tran )
+    {
+        EndDroppedRun();
+
+        ++num_operations;
+        ++( tran.IsRead() ? num_reads : num_writes )[ tran.reg ];
+        ++num_acks[ tran.ACK & ( NUM_ACKS - 1 ) ];
+
+        size_t num_bits = tran.bits.Size();
+        num_operation_bits += num_bits;
+
+        if( num_bits < TRAN_READ_LENGTH )
+            ++num_no_data;
+
+        S64 samples = tran.bits[ num_bits - 1 ].rising - tran.bits[ 0 ].rising;
+        double period = double( samples ) / double( num_bits - 1 );
+        if( num_clock_periods == 0 || period < min_period )
+            min_period = period;
+        if( num_clock_periods == 0 || period > max_period )
+            max_period = period;
+
+        num_clock_periods += num_bits - 1;
+        clock_samples += U64( samples );
+    }
+
+    void AddLineReset( const RVSWDLineReset& reset )
+    {
+        EndDroppedRun();
+
+        ++num_line_resets;
+        num_line_reset_bits += reset.num_bits;
+    }
+
+    void AddIdle( const RVSWDIdle& idle )
+    {
+        EndDroppedRun();
+
+        ++num_idle_periods;
+        num_idle_bits += idle.num_bits;
+    }
+
+    // the parser's HadDataParityError, before the bits are dropped
+    void AddParityError()
+    {
+        ++num_parity_errors;
+    }
+
+    // num_bits is what SkipToCandidate returned
+    void AddDropped( size_t num_bits )
+    {
+        num_dropped_bits += num_bits;
+        dropped_run += num_bits;
+    }
+
+    void EndDroppedRun()
+    {
+        if( dropped_run == 0 )
+            return;
+
+        ++num_dropped_runs;
+        if( dropped_run > longest_dropped_run )
+            longest_dropped_run = dropped_run;
+
+        dropped_run = 0;
+    }
+
+    // writes a summary, a line for each kind of counter and a table of the registers
+    void Write( FILE* f, U64 sample_rate ) const;
+};
+
+#endif // RVSWD_CAPTURE_STATS_H
@@ -0,0 +1,64 @@
+#ifndef RVSWD_EXPORT_FILTER_H
+#define RVSWD_EXPORT_FILTER_H
+
+#include <limits>
+
+#include "RVSWDTypes.h"
+
+// Picks the operations and line resets an export writes. The range is in samples and
+// selects by the start of the operation's request or of the line reset, an operation
+// that starts in the range is written whole. The other fields match operations only,
+// a line reset is only written if none of them is set.
+struct RVSWDExportFilter
+{
+    enum
+    {
+        ANY = 0,
+
+        // rnw
+        READ = 1,
+        WRITE = 2,
+
+        // port
+        DEBUG_PORT = 1,
+        ACCESS_PORT = 2,
+    };
+
+    // the whole capture by default
+    S64 start_sample;
+    S64 end_sample; // inclusive
+
+    RVSWDRegisters reg; // RVSWDR_undefined for any
+    U32 rnw;
+    U32 port;
+    U32 ack; // ANY, or the ACK value
+
+    RVSWDExportFilter()
+        : start_sample( std::numeric_limits<S64>::min() ), end_sample( std::numeric_limits<S64>::max() ), reg( RVSWDR_undefined ),
+          rnw( ANY ), port( ANY ), ack( ANY )
+    {
+    }
+
+    bool InRange( S64 sample ) const
+    {
+        return sample >= start_sample && sample <= end_sample;
+    }
+
+    bool HasPredicate() const
+    {
+        return reg != RVSWDR_undefined || rnw != ANY || port != ANY || ack != ANY;
+    }
+
+    bool MatchesLineReset() const
+    {
+        return !HasPredicate();
+    }
+
+    bool MatchesOperation( RVSWDRegisters op_reg, bool is_read, bool is_access_port, U8 op_ack ) const
+    {
+        return ( reg == RVSWDR_undefined || reg == op_reg ) && ( rnw == ANY || ( rnw == READ ) == is_read ) &&
+               ( port == ANY || ( port == ACCESS_PORT ) == is_access_port ) && ( ack == ANY || ack == op_ack );
+    }
+};
+
+#endif // RVSWD_EXPORT_FILTER_H
@@ -0,0 +1,215 @@
+#include <cstring>
+#include <algorithm>
+
+#include "RVSWDExportPipeline.h"
+
+static const char* const WRITE_ERROR = "writing the export file failed";
+
+void RVSWDExportStats::Write( FILE* f ) const
+{
+    if( error != NULL )
+        fprintf( f, "FAILED (%s), ", error );
+
+    fprintf( f, "%llu frames read, %llu records, %llu bytes in %.3f s (%.1f MB/s), ", num_frames, num_records, num_bytes, seconds,
+             seconds > 0 ? double( num_bytes ) / seconds / 1e6 : 0.0 );
+    fprintf( f, "%llu chunks, %u formatting threads", num_chunks, num_threads );
+    if( num_index_hits != 0 || index_bytes != 0 )
+        fprintf( f, ", %llu operations found in the index of %llu bytes", num_index_hits, index_bytes );
+    fprintf( f, "\n" );
+}
+
+RVSWDExportPipeline::RVSWDExportPipeline()
+    : mFile( NULL ), mNextFill( 0 ), mNextFormat( 0 ), mNextWrite( 0 ), mFilling( false ), mDone( false ), mCancelled( false )
+{
+    memset( &mStats, 0, sizeof( mStats ) );
+}
+
+RVSWDExportPipeline::~RVSWDExportPipeline()
+{
+    Cancel();
+}
+
+bool RVSWDExportPipeline::Start( const char* file_name, const std::string& header, Formatter formatter, U32 max_threads )
+{
+    Cancel();
+
+    mFile = fopen( file_name, "w" );
+    if( mFile == NULL )
+        return false;
+
+    // the writer hands over whole chunks, a big buffer saves on system calls
+    mFileBuffer.resize( FILE_BUFFER_SIZE );
+    setvbuf( mFile, mFileBuffer.data(), _IOFBF, mFileBuffer.size() );
+
+    mFormatter = formatter;
+
+    memset( &mStats, 0, sizeof( mStats ) );
+    if( fwrite( header.data(), 1, header.size(), mFile ) != header.size() )
+        mStats.error = WRITE_ERROR;
+
+    U32 num_threads = std::max<U32>( std::thread::hardware_concurrency(), 2 ) - 1;
+    mStats.num_threads = std::min<U32>( num_threads, std::min<U32>( max_threads, MAX_THREADS ) );
+    mStats.num_bytes = header.size();
+    mStartTime = std::chrono::steady_clock::now();
+
+    // enough chunks to keep every thread busy while the writer and the caller have one each
+    mSlots.resize( mStats.num_threads * 2 + 2 );
+    for( size_t ndx = 0; ndx < mSlots.size(); ++ndx )
+        mSlots[ ndx ].state = SLOT_FREE;
+
+    mNextFill = 0;
+    mNextFormat = 0;
+    mNextWrite = 0;
+    mFilling = false;
+    mDone = false;
+    mCancelled = false;
+
+    for( U32 ndx = 0; ndx < mStats.num_threads; ++ndx )
+        mThreads.push_back( std::thread( &RVSWDExportPipeline::FormatThread, this ) );
+
+    mThreads.push_back( std::thread( &RVSWDExportPipeline::WriteThread, this ) );
+
+    return true;
+}
+
+RVSWDExportPipeline::Chunk& RVSWDExportPipeline::GetChunk()
+{
+    Slot& slot = mSlots[ mNextFill % mSlots.size() ];
+    if( mFilling )
+        return slot.chunk;
+
+    {
+        std::unique_lock<std::mutex> lock( mMutex );
+        while( slot.state != SLOT_FREE )
+            mChanged.wait( lock );
+
+        slot.state = SLOT_FILLING;
+    }
+
+    slot.chunk.frames.clear();
+    slot.chunk.records.clear();
+    mFilling = true;
+
+    return slot.chunk;
+}
+
+void RVSWDExportPipeline::Submit()
+{
+    Slot& slot = mSlots[ mNextFill % mSlots.size() ];
+
+    mStats.num_records += slot.chunk.records.size();
+    ++mStats.num_chunks;
+
+    if( mStats.num_threads == 0 )
+    {
+        slot.chunk.text.clear();
+        mFormatter( slot.chunk );
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        slot.state = mStats.num_threads == 0 ? SLOT_FORMATTED : SLOT_SUBMITTED;
+        ++mNextFill;
+        mFilling = false;
+    }
+
+    mChanged.notify_all();
+}
+
+void RVSWDExportPipeline::Finish()
+{
+    if( mFile == NULL )
+        return;
+
+    if( mFilling && !mSlots[ mNextFill % mSlots.size() ].chunk.records.empty() )
+        Submit();
+
+    Stop( false );
+}
+
+void RVSWDExportPipeline::Cancel()
+{
+    if( mFile != NULL )
+        Stop( true );
+}
+
+void RVSWDExportPipeline::Stop( bool cancel )
+{
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        mDone = true;
+        mCancelled = cancel;
+    }
+
+    mChanged.notify_all();
+
+    for( size_t ndx = 0; ndx < mThreads.size(); ++ndx )
+        mThreads[ ndx ].join();
+
+    mThreads.clear();
+
+    // with a full disk it's often only the last flush that fails
+    if( fclose( mFile ) != 0 && !cancel && mStats.error == NULL )
+        mStats.error = WRITE_ERROR;
+    mFile = NULL;
+
+    mStats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - mStartTime ).count();
+}
+
+void RVSWDExportPipeline::FormatThread()
+{
+    std::unique_lock<std::mutex> lock( mMutex );
+
+    for( ;; )
+    {
+        // the chunks are taken in order, so the writer gets the early ones first
+        while( !mCancelled && mNextFormat == mNextFill && !mDone )
+            mChanged.wait( lock );
+
+        if( mCancelled || mNextFormat == mNextFill )
+            return;
+
+        Slot& slot = mSlots[ mNextFormat % mSlots.size() ];
+        slot.state = SLOT_FORMATTING;
+        ++mNextFormat;
+
+        lock.unlock();
+
+        slot.chunk.text.clear();
+        mFormatter( slot.chunk );
+
+        lock.lock();
+
+        slot.state = SLOT_FORMATTED;
+        mChanged.notify_all();
+    }
+}
+
+void RVSWDExportPipeline::WriteThread()
+{
+    std::unique_lock<std::mutex> lock( mMutex );
+
+    for( ;; )
+    {
+        Slot& slot = mSlots[ mNextWrite % mSlots.size() ];
+        while( !mCancelled && slot.state != SLOT_FORMATTED && !( mDone && mNextWrite == mNextFill ) )
+            mChanged.wait( lock );
+
+        if( mCancelled || slot.state != SLOT_FORMATTED )
+            return;
+
+        lock.unlock();
+
+        // after the first failure the rest isn't written, the file is incomplete anyway
+        if( mStats.error == NULL && fwrite( slot.chunk.text.data(), 1, slot.chunk.text.size(), mFile ) != slot.chunk.text.size() )
+            mStats.error = WRITE_ERROR;
+        else
+            mStats.num_bytes += slot.chunk.text.size();
+
+        lock.lock();
+
+        slot.state = SLOT_FREE;
+        ++mNextWrite;
+        mChanged.notify_all();
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef RVSWD_EXPORT_PIPELINE_H
+#define RVSWD_EXPORT_PIPELINE_H
+
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+#include "RVSWDTypes.h"
+
+// counters of the last export
+struct RVSWDExportStats
+{
+    U64 num_frames;
+    U64 num_records;
+    U64 num_bytes;
+    U64 num_chunks;
+    U32 num_threads; // formatting threads
+    double seconds;
+
+    // the operations the operation index found, and its memory, both 0 if the frames were scanned
+    U64 num_index_hits;
+    U64 index_bytes;
+
+    const char* error; // why the export failed, NULL if it didn't
+
+    // a line with the counters and the throughput
+    void Write( FILE* f ) const;
+};
+
+// Writes an export file in three stages. The caller's thread groups the frames into
+// records and fills chunks with them, worker threads format whole chunks into text, and
+// a writer thread appends the text to the file in chunk order. The chunks and their
+// buffers are reused, so the caller waits when all of them are still in the pipeline.
+// A formatter that can't run off the caller's thread, one that calls into the SDK, gets
+// max_threads 0, and the chunks are formatted as they're submitted.
+class RVSWDExportPipeline
+{
+  public:
+    enum
+    {
+        CHUNK_RECORDS = 4096,
+        MAX_THREADS = 8,
+        FILE_BUFFER_SIZE = 1 << 20,
+    };
+
+    // the frames of a record are chunk.frames[ first_frame ] on
+    struct Record
+    {
+        U32 first_frame;
+        U32 num_frames;
+        U32 bus;
+    };
+
+    struct Chunk
+    {
+        std::vector<Frame> frames;
+        std::vector<Record> records;
+        std::string text;
+    };
+
+    // formats chunk.records into chunk.text, called on the worker threads
+    typedef std::function<void( Chunk& chunk )> Formatter;
+
+    RVSWDExportPipeline();
+    ~RVSWDExportPipeline();
+
+    // creates the file, writes the header and starts the threads
+    bool Start( const char* file_name, const std::string& header, Formatter formatter, U32 max_threads = MAX_THREADS );
+
+    // the chunk to fill, it's empty, waits until one is free
+    Chunk& GetChunk();
+
+    // hands the chunk from GetChunk on, formatting it first if there are no formatting threads
+    void Submit();
+
+    // submits the last chunk if it has records and waits for everything to be written
+    void Finish();
+
+    // stops without writing what's still in the pipeline
+    void Cancel();
+
+    // stats.error is set if the file couldn't be written, all of it
+    const RVSWDExportStats& GetStats() const
+    {
+        return mStats;
+    }
+
+  protected:
+    enum SlotState
+    {
+        SLOT_FREE,
+        SLOT_FILLING,
+        SLOT_SUBMITTED,
+        SLOT_FORMATTING,
+        SLOT_FORMATTED,
+    };
+
+    struct Slot
+    {
+        Chunk chunk;
+        SlotState state;
+    };
+
+    void FormatThread();
+    void WriteThread();
+    void Stop( bool cancel );
+
+    FILE* mFile;
+    std::vector<char> mFileBuffer;
+    Formatter mFormatter;
+
+    // chunk n goes through slot n % mSlots.size()
+    std::vector<Slot> mSlots;
+    U64 mNextFill;
+    U64 mNextFormat;
+    U64 mNextWrite;
+    bool mFilling;
+    bool mDone;
+    bool mCancelled;
+
+    std::mutex mMutex;
+    std::condition_variable mChanged;
+    std::vector<std::thread> mThreads;
+
+    std::chrono::steady_clock::time_point mStartTime;
+    RVSWDExportStats mStats;
+};
+
+#endif // RVSWD_EXPORT_PIPELINE_H
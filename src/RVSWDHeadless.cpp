@@ -0,0 +1,965 @@
+// Headless RVSWD decoder: decodes a capture exported from Logic 2 without the
+// Analyzer SDK, and writes the operations in the same layout as the plugin's export.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <new>
+
+#include "RVSWDBinaryExport.h"
+#include "RVSWDCapture.h"
+#include "RVSWDCaptureStats.h"
+#include "RVSWDMemoryImage.h"
+#include "RVSWDNumberFormat.h"
+#include "RVSWDOperationFile.h"
+#include "RVSWDOperationIndex.h"
+#include "RVSWDParallel.h"
+#include "RVSWDParser.h"
+#include "RVSWDRawSamples.h"
+#include "RVSWDTextExport.h"
+#include "RVSWDUtils.h"
+
+// counts the heap allocations, to check that decoding doesn't keep allocating
+static std::atomic<U64> gNumAllocations( 0 );
+
+void* operator new( size_t size )
+{
+    ++gNumAllocations;
+
+    void* p = malloc( size != 0 ? size : 1 );
+    if( p == NULL )
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void operator delete( void* p ) noexcept
+{
+    free( p );
+}
+
+// the output of the decoded operations, in one of the export's formats
+class RVSWDOutputSink : public RVSWDFrameSink
+{
+  public:
+    RVSWDOutputSink() : mNumOperations( 0 ), mNumLineResets( 0 )
+    {
+    }
+
+    virtual void AddMarker( S64 /*sample_number*/, RVSWDMarkerTypes /*marker_type*/ )
+    {
+    }
+
+    // writes what's left once decoding is done, returns false if that failed
+    virtual bool Finish() = 0;
+
+    U64 GetNumOperations() const
+    {
+        return mNumOperations;
+    }
+
+    U64 GetNumLineResets() const
+    {
+        return mNumLineResets;
+    }
+
+  protected:
+    U64 mNumOperations;
+    U64 mNumLineResets;
+};
+
+// writes the export records as the frames come in, with the plugin's text export's lines
+class RVSWDTextSink : public RVSWDOutputSink
+{
+  public:
+    RVSWDTextSink( FILE* f, const RVSWDTextFormat& fmt ) : mFile( f ), mFormat( fmt )
+    {
+        fputs( mFormat.GetHeader(), mFile );
+    }
+
+    // the record is grouped like the plugin's export groups it
+    virtual void AddFrame( const Frame& f )
+    {
+        if( f.mType == RVSWDFT_LineReset )
+        {
+            SaveRecord();
+
+            mRecord.push_back( f );
+            SaveRecord();
+
+            ++mNumLineResets;
+        }
+        else if( f.mType == RVSWDFT_Request )
+        {
+            SaveRecord();
+
+            mRecord.push_back( f );
+
+            ++mNumOperations;
+        }
+        else if( mRecord.empty() )
+        {
+            // the rest of an operation whose request wasn't decoded
+        }
+        else if( f.mType == RVSWDFT_ACK )
+        {
+            mRecord.push_back( f );
+        }
+        else if( f.mType == RVSWDFT_WData )
+        {
+            mRecord.push_back( f );
+
+            SaveRecord();
+        }
+    }
+
+    // like the plugin's export, an operation that's still open at the end isn't written
+    virtual bool Finish()
+    {
+        mRecord.clear();
+        return fflush( mFile ) == 0 && !ferror( mFile );
+    }
+
+  protected:
+    void SaveRecord()
+    {
+        if( mRecord.empty() )
+            return;
+
+        mText.clear();
+        FormatTextRecord( &mRecord[ 0 ], mRecord.size(), 0, mFormat, mText );
+        fwrite( mText.data(), 1, mText.size(), mFile );
+
+        mRecord.clear();
+    }
+
+    FILE* mFile;
+    RVSWDTextFormat mFormat;
+
+    std::vector<Frame> mRecord;
+    std::string mText; // the record's line, its buffer is reused
+};
+
+// writes the binary operations file, like the plugin's operations export
+class RVSWDOperationSink : public RVSWDOutputSink
+{
+  public:
+    RVSWDOperationSink( RVSWDOperationFileWriter* pWriter ) : mWriter( pWriter )
+    {
+        mBuilder.Setup( 1 );
+    }
+
+    virtual void AddFrame( const Frame& f )
+    {
+        if( f.mType == RVSWDFT_Request )
+            ++mNumOperations;
+        else if( f.mType == RVSWDFT_LineReset )
+            ++mNumLineResets;
+
+        mBuilder.AddFrame( f, 0, mRecords );
+        WriteRecords();
+    }
+
+    virtual bool Finish()
+    {
+        mBuilder.Finish( mRecords );
+        WriteRecords();
+
+        return mWriter->Close();
+    }
+
+  protected:
+    void WriteRecords()
+    {
+        for( std::vector<RVSWDOperationRecord>::const_iterator ri( mRecords.begin() ); ri != mRecords.end(); ++ri )
+            mWriter->Write( *ri );
+
+        mRecords.clear();
+    }
+
+    RVSWDOperationFileWriter* mWriter;
+    RVSWDOperationRecordBuilder mBuilder;
+    std::vector<RVSWDOperationRecord> mRecords;
+};
+
+// Passes the frames on to another sink, which it owns, if there is one, and hands the
+// records built from them to the memory tracker and the operation index, if they're set.
+class RVSWDRecordSink : public RVSWDOutputSink
+{
+  public:
+    RVSWDRecordSink( RVSWDOutputSink* pNext, RVSWDMemoryImage* pImage, RVSWDOperationIndex* pIndex )
+        : mNext( pNext ), mTracking( pImage != NULL ), mIndex( pIndex )
+    {
+        mBuilder.Setup( 1 );
+        mTracker.Setup( pImage, true );
+    }
+
+    virtual void AddFrame( const Frame& f )
+    {
+        if( f.mType == RVSWDFT_Request )
+            ++mNumOperations;
+        else if( f.mType == RVSWDFT_LineReset )
+            ++mNumLineResets;
+
+        if( mNext )
+            mNext->AddFrame( f );
+
+        mBuilder.AddFrame( f, 0, mRecords );
+        AddRecords();
+    }
+
+    virtual void AddMarker( S64 sample_number, RVSWDMarkerTypes marker_type )
+    {
+        if( mNext )
+            mNext->AddMarker( sample_number, marker_type );
+    }
+
+    virtual bool Finish()
+    {
+        mBuilder.Finish( mRecords );
+        AddRecords();
+
+        if( mTracking )
+            mTracker.Finish();
+
+        return !mNext || mNext->Finish();
+    }
+
+    const RVSWDMemoryStats& GetStats() const
+    {
+        return mTracker.GetStats();
+    }
+
+  protected:
+    void AddRecords()
+    {
+        for( std::vector<RVSWDOperationRecord>::const_iterator ri( mRecords.begin() ); ri != mRecords.end(); ++ri )
+        {
+            if( mTracking )
+                mTracker.AddRecord( *ri );
+            if( mIndex != NULL )
+                mIndex->AddRecord( *ri );
+        }
+
+        mRecords.clear();
+    }
+
+    std::unique_ptr<RVSWDOutputSink> mNext;
+    bool mTracking;
+    RVSWDOperationIndex* mIndex;
+    RVSWDOperationRecordBuilder mBuilder;
+    RVSWDMemoryTracker mTracker;
+    std::vector<RVSWDOperationRecord> mRecords;
+};
+
+// decodes on this thread, the same as RVSWDAnalyzer::WorkerThread, until we run out of edges
+static void Decode( RVSWDParser& parser, RVSWDOutputSink* pSink, RVSWDCaptureStats& stats )
+{
+    parser.Clear();
+    stats.Clear();
+
+    RVSWDOperation tran;
+    RVSWDLineReset reset;
+    RVSWDIdle idle;
+
+    try
+    {
+        for( ;; )
+        {
+            if( parser.IsIdle( idle ) )
+            {
+                idle.AddFrames( pSink );
+                stats.AddIdle( idle );
+            }
+            else if( parser.IsOperation( tran ) )
+            {
+                tran.AddFrames( pSink );
+                tran.AddMarkers( pSink );
+                stats.AddOperation( tran );
+            }
+            else if( parser.IsLineReset( reset ) )
+            {
+                reset.AddFrames( pSink );
+                stats.AddLineReset( reset );
+            }
+            else
+            {
+                if( parser.HadDataParityError() )
+                    stats.AddParityError();
+                stats.AddDropped( parser.SkipToCandidate() );
+            }
+        }
+    }
+    catch( RVSWDEndOfData& )
+    {
+    }
+}
+
+// times the kernels over the whole capture, a few times each
+static void BenchmarkKernels( const std::vector<U8>& samples, U32 dio_channel, U32 clk_channel )
+{
+    const size_t NUM_RUNS = 5;
+
+    std::vector<RVSWDRawEdge> edges( RVSWDRawBitSource::EDGE_BUFFER_SIZE );
+    for( int kernel = 0; kernel < NUM_RAW_KERNELS; ++kernel )
+    {
+        RVSWDEdgeScanner scanner = GetEdgeScanner( RVSWDRawKernel( kernel ) );
+        if( scanner == 0 )
+        {
+            fprintf( stderr, "%-8s not supported by this CPU\n", GetRawKernelName( RVSWDRawKernel( kernel ) ) );
+            continue;
+        }
+
+        double best = 0;
+        U64 num_edges = 0;
+        for( size_t run = 0; run < NUM_RUNS; ++run )
+        {
+            std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+
+            num_edges = 0;
+            size_t pos = 1;
+            while( pos < samples.size() )
+            {
+                size_t num_found = 0;
+                pos = scanner( samples.data(), pos, samples.size(), U8( 1 << dio_channel ), U8( 1 << clk_channel ), edges.data(), edges.size(),
+                               num_found );
+                num_edges += num_found;
+            }
+
+            double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+            if( run == 0 || seconds < best )
+                best = seconds;
+        }
+
+        fprintf( stderr, "%-8s %llu CLK edges, %.2f GB/s\n", GetRawKernelName( RVSWDRawKernel( kernel ) ), num_edges,
+                 best > 0 ? double( samples.size() ) / best / 1e9 : 0.0 );
+    }
+}
+
+// noise for the resync benchmark, random DIO states on a steady clock
+class RVSWDNoiseSource : public RVSWDBitSource
+{
+  public:
+    explicit RVSWDNoiseSource( U64 num_bits ) : mNumLeft( num_bits ), mRandom( 1 ), mSample( 0 )
+    {
+    }
+
+    virtual size_t ReadBits( RVSWDBit* bits, size_t max_bits )
+    {
+        if( mNumLeft == 0 )
+            throw RVSWDEndOfData();
+
+        size_t num_bits = size_t( std::min<U64>( mNumLeft, max_bits ) );
+        for( size_t ndx = 0; ndx < num_bits; ++ndx )
+            bits[ ndx ] = NextBit();
+
+        mNumLeft -= num_bits;
+        return num_bits;
+    }
+
+    RVSWDBit NextBit()
+    {
+        mRandom = mRandom * 6364136223846793005ull + 1442695040888963407ull;
+
+        RVSWDBit rbit;
+        rbit.state_rising = ( mRandom >> 63 ) != 0 ? BIT_HIGH : BIT_LOW;
+        rbit.state_falling = ( mRandom >> 62 & 1 ) != 0 ? BIT_HIGH : BIT_LOW;
+        rbit.low_start = mSample;
+        rbit.rising = mSample + 4;
+        rbit.falling = mSample + 5;
+        rbit.low_end = mSample + 10;
+
+        mSample += 5;
+        return rbit;
+    }
+
+  private:
+    U64 mNumLeft;
+    U64 mRandom;
+    S64 mSample;
+};
+
+// Times dropping bits while resyncing. The window is kept full at several capacities and
+// every dropped bit is a PopFront and a PushBack, or a Consume of 57 bits and the pushes
+// that refill it the way SkipToCandidate drops them, next to the vector the window
+// replaced, which shifted the whole buffer for every bit. Then SkipToCandidate is timed
+// on the parser itself, over random bits.
+static void BenchmarkResync()
+{
+    static const size_t capacities[] = { 128, 1024, 8192, 65536 };
+    const U64 NUM_DROPPED = 1 << 22;
+
+    for( size_t cndx = 0; cndx < sizeof( capacities ) / sizeof( capacities[ 0 ] ); ++cndx )
+    {
+        size_t capacity = capacities[ cndx ];
+        RVSWDNoiseSource noise( 0 );
+
+        RVSWDBitWindow window( capacity );
+        while( window.Size() < capacity )
+            window.PushBack( noise.NextBit() );
+
+        std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+        for( U64 ndx = 0; ndx < NUM_DROPPED; ++ndx )
+        {
+            window.PopFront();
+            window.PushBack( noise.NextBit() );
+        }
+        double pop_seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+        start = std::chrono::steady_clock::now();
+        for( U64 ndx = 0; ndx < NUM_DROPPED; ndx += 57 )
+        {
+            window.Consume( 57 );
+            for( size_t pushed = 0; pushed < 57; ++pushed )
+                window.PushBack( noise.NextBit() );
+        }
+        double consume_seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+        // the shifting vector is O(capacity) a bit, fewer bits keep the big ones short
+        U64 num_shifted = std::max<U64>( NUM_DROPPED / capacity, 1024 );
+        std::vector<RVSWDBit> shifting;
+        while( shifting.size() < capacity )
+            shifting.push_back( noise.NextBit() );
+
+        start = std::chrono::steady_clock::now();
+        for( U64 ndx = 0; ndx < num_shifted; ++ndx )
+        {
+            std::copy( shifting.begin() + 1, shifting.end(), shifting.begin() );
+            shifting.back() = noise.NextBit();
+        }
+        double shift_seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+        fprintf( stderr, "window of %6u bits: PopFront %.2f ns, Consume %.2f ns, shifting vector %.1f ns per dropped bit\n",
+                 unsigned( capacity ), pop_seconds * 1e9 / NUM_DROPPED, consume_seconds * 1e9 / NUM_DROPPED,
+                 shift_seconds * 1e9 / num_shifted );
+    }
+
+    RVSWDNoiseSource noise( NUM_DROPPED * 4 );
+    RVSWDParser parser;
+    parser.Setup( &noise );
+
+    U64 num_dropped = 0;
+    std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+    try
+    {
+        for( ;; )
+            num_dropped += parser.SkipToCandidate();
+    }
+    catch( RVSWDEndOfData& )
+    {
+    }
+    double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+    fprintf( stderr, "SkipToCandidate dropped %llu random bits, %.2f ns per dropped bit, window high-water %u bits\n", num_dropped,
+             num_dropped > 0 ? seconds * 1e9 / double( num_dropped ) : 0.0, unsigned( parser.GetMaxBufferedBits() ) );
+}
+
+// the whole of the text is a number, in C notation
+static bool ParseU32( const std::string& text, U32& val )
+{
+    char* end;
+    unsigned long long ull = strtoull( text.c_str(), &end, 0 );
+    if( text.empty() || *end != '\0' || text[ 0 ] == '-' || ull > 0xFFFFFFFFull )
+        return false;
+
+    val = U32( ull );
+    return true;
+}
+
+static bool ParseSeconds( const std::string& text, double& seconds )
+{
+    char* end;
+    seconds = strtod( text.c_str(), &end );
+    return !text.empty() && *end == '\0';
+}
+
+// Parses the -q query, comma separated key=value pairs: reg=<register name>, rw=read|write,
+// port=dp|ap, ack=ok|wait|fault|<1-7>, data=<value>, from=<seconds>, to=<seconds>. The
+// times are converted to samples once the capture's start time is known. An ACK value is
+// 1 to 7, 0 is the filter's ANY and can't be asked for.
+static bool ParseQuery( const char* spec, RVSWDIndexQuery& query, double& from, double& to )
+{
+    std::string rest( spec );
+    while( !rest.empty() )
+    {
+        size_t comma = rest.find( ',' );
+        std::string item( rest.substr( 0, comma ) );
+        rest = comma == std::string::npos ? std::string() : rest.substr( comma + 1 );
+
+        size_t eq = item.find( '=' );
+        if( eq == std::string::npos )
+            return false;
+
+        std::string key( item.substr( 0, eq ) );
+        std::string value( item.substr( eq + 1 ) );
+
+        if( key == "reg" )
+        {
+            int reg = RVSWDR_DP_IDCODE;
+            while( reg <= RVSWDR_AP_IDR && value != GetRegisterName( RVSWDRegisters( reg ) ) )
+                ++reg;
+
+            if( reg > RVSWDR_AP_IDR )
+                return false;
+
+            query.reg = RVSWDRegisters( reg );
+        }
+        else if( key == "rw" && ( value == "read" || value == "write" ) )
+            query.rnw = value == "read" ? RVSWDExportFilter::READ : RVSWDExportFilter::WRITE;
+        else if( key == "port" && ( value == "dp" || value == "ap" ) )
+            query.port = value == "ap" ? RVSWDExportFilter::ACCESS_PORT : RVSWDExportFilter::DEBUG_PORT;
+        else if( key == "ack" )
+        {
+            if( value == "ok" || value == "wait" || value == "fault" )
+                query.ack = value == "ok" ? U32( ACK_OK ) : value == "wait" ? U32( ACK_WAIT ) : U32( ACK_FAULT );
+            else if( !ParseU32( value, query.ack ) || query.ack == RVSWDExportFilter::ANY || query.ack > 7 )
+                return false;
+        }
+        else if( key == "data" )
+        {
+            query.match_data = true;
+            if( !ParseU32( value, query.data ) )
+                return false;
+        }
+        else if( key == "from" )
+        {
+            if( !ParseSeconds( value, from ) )
+                return false;
+        }
+        else if( key == "to" )
+        {
+            if( !ParseSeconds( value, to ) )
+                return false;
+        }
+        else
+            return false;
+    }
+
+    return true;
+}
+
+// writes the operations the query found, a line each
+static void WriteQueryResults( FILE* f, const RVSWDOperationIndex& index, const std::vector<U32>& found, double start_time, U64 sample_rate )
+{
+    fputs( "Time\tR/W\tAP/DP\tRegister\tACK\tData\n", f );
+
+    for( std::vector<U32>::const_iterator fi( found.begin() ); fi != found.end(); ++fi )
+    {
+        const RVSWDIndexedOperation& op( index.GetOperation( *fi ) );
+
+        char data_str[ NUMBER_STR_SIZE ] = "";
+        if( op.flags & RVSWDOF_HAS_DATA )
+            FormatNumberFast( op.data, Hexadecimal, 32, data_str );
+
+        fprintf( f, "%.9f\t%s\t%s\t%s\t%s\t%s\n", start_time + double( op.start_sample ) / double( sample_rate ),
+                 ( op.flags & RVSWDOF_READ ) ? "read" : "write", ( op.flags & RVSWDOF_ACCESS_PORT ) ? "AccessPort" : "DebugPort",
+                 GetRegisterName( RVSWDRegisters( op.reg ) ),
+                 op.ack == ACK_OK ? "OK" : op.ack == ACK_WAIT ? "WAIT" : op.ack == ACK_FAULT ? "FAULT" : "<disc>", data_str );
+    }
+}
+
+static void Usage()
+{
+    fprintf( stderr, "usage: rvswd_decode [options] capture\n"
+                     "  -o <file>      write the operations to file instead of stdout\n"
+                     "  -r <rate>      sample rate used to convert the times, in Hz (default 100000000)\n"
+                     "  -d <column>    channel column of DIO, counted from 0 (default 0)\n"
+                     "  -c <column>    channel column of CLK, counted from 0 (default 1)\n"
+                     "  -j <threads>   decode with this many threads, 0 for one per core (default 1)\n"
+                     "  -s             stream the capture from the file instead of loading it, on one thread\n"
+                     "  -f <format>    csv for a Logic 2 CSV export, raw for raw samples, a byte per sample\n"
+                     "                 and a channel per bit, -d and -c give the bits, bin for the directory\n"
+                     "                 of a Logic 2 binary export, -d and -c give the digital_N.bin files (default csv)\n"
+                     "  -k <kernel>    scan raw samples with scalar, sse2 or avx2 (default the fastest the CPU runs)\n"
+                     "  -b             time the raw sample kernels instead of decoding\n"
+                     "  -e <format>    write the operations as text, or as ops for the binary operations file (default text)\n"
+                     "  -m <file>      also write the memory the target wrote and read, as Intel HEX if file ends in .hex,\n"
+                     "                 raw binary otherwise\n"
+                     "  -w             time dropping bits while resyncing, at several bit window sizes, no capture needed\n"
+                     "  -t             write the capture statistics to stderr when done: the bits, dropped and decoded,\n"
+                     "                 the ACKs, parity errors, SWCLK frequency and the operations per register\n"
+                     "  -q <query>     index the operations and write the ones that match to stdout, the decoded operations\n"
+                     "                 are only written with -o. The query is key=value pairs separated by commas: reg=<name>,\n"
+                     "                 rw=read|write, port=dp|ap, ack=ok|wait|fault|<1-7>, data=<value>, from=<s>, to=<s>\n" );
+}
+
+int main( int argc, char* argv[] )
+{
+    const char* in_file = NULL;
+    const char* out_file = NULL;
+    U64 sample_rate = 100000000;
+    size_t dio_column = 0;
+    size_t clk_column = 1;
+    size_t num_threads = 1;
+    bool stream = false;
+    bool raw = false;
+    bool binary = false;
+    RVSWDRawKernel kernel = GetBestRawKernel();
+    bool benchmark = false;
+    bool ops = false;
+    const char* memory_file = NULL;
+    bool resync = false;
+    const char* query_spec = NULL;
+    bool capture_stats = false;
+
+    for( int ndx = 1; ndx < argc; ++ndx )
+    {
+        std::string arg( argv[ ndx ] );
+        bool has_value = ndx + 1 < argc;
+
+        if( arg == "-o" && has_value )
+            out_file = argv[ ++ndx ];
+        else if( arg == "-r" && has_value )
+            sample_rate = strtoull( argv[ ++ndx ], NULL, 10 );
+        else if( arg == "-d" && has_value )
+            dio_column = strtoul( argv[ ++ndx ], NULL, 10 );
+        else if( arg == "-c" && has_value )
+            clk_column = strtoul( argv[ ++ndx ], NULL, 10 );
+        else if( arg == "-j" && has_value )
+            num_threads = strtoul( argv[ ++ndx ], NULL, 10 );
+        else if( arg == "-s" )
+            stream = true;
+        else if( arg == "-f" && has_value )
+        {
+            std::string format( argv[ ++ndx ] );
+            if( format != "csv" && format != "raw" && format != "bin" )
+            {
+                Usage();
+                return 2;
+            }
+
+            raw = format == "raw";
+            binary = format == "bin";
+        }
+        else if( arg == "-k" && has_value )
+        {
+            // NUM_RAW_KERNELS if there's no such kernel
+            std::string name( argv[ ++ndx ] );
+            int found = 0;
+            while( found < NUM_RAW_KERNELS && name != GetRawKernelName( RVSWDRawKernel( found ) ) )
+                ++found;
+
+            kernel = RVSWDRawKernel( found );
+        }
+        else if( arg == "-b" )
+            benchmark = true;
+        else if( arg == "-e" && has_value )
+        {
+            std::string format( argv[ ++ndx ] );
+            if( format != "text" && format != "ops" )
+            {
+                Usage();
+                return 2;
+            }
+
+            ops = format == "ops";
+        }
+        else if( arg == "-w" )
+            resync = true;
+        else if( arg == "-m" && has_value )
+            memory_file = argv[ ++ndx ];
+        else if( arg == "-q" && has_value )
+            query_spec = argv[ ++ndx ];
+        else if( arg == "-t" )
+            capture_stats = true;
+        else if( arg[ 0 ] != '-' && in_file == NULL )
+            in_file = argv[ ndx ];
+        else
+        {
+            Usage();
+            return 2;
+        }
+    }
+
+    if( resync )
+    {
+        BenchmarkResync();
+        return 0;
+    }
+
+    RVSWDIndexQuery query;
+    double query_from = -HUGE_VAL;
+    double query_to = HUGE_VAL;
+    if( query_spec != NULL && !ParseQuery( query_spec, query, query_from, query_to ) )
+    {
+        fprintf( stderr, "rvswd_decode: bad query \"%s\"\n", query_spec );
+        Usage();
+        return 2;
+    }
+
+    if( in_file == NULL || sample_rate == 0 || dio_column == clk_column || ( stream && num_threads != 1 ) || kernel == NUM_RAW_KERNELS ||
+        ( raw && ( stream || num_threads != 1 || dio_column > 7 || clk_column > 7 ) ) || ( binary && ( stream || num_threads != 1 ) ) ||
+        ( benchmark && !raw ) || ( ops && out_file == NULL ) )
+    {
+        Usage();
+        return 2;
+    }
+
+    RVSWDEdgeScanner scanner = GetEdgeScanner( kernel );
+    if( scanner == 0 )
+    {
+        fprintf( stderr, "rvswd_decode: this CPU doesn't run the %s kernel\n", GetRawKernelName( kernel ) );
+        return 1;
+    }
+
+    if( num_threads == 0 )
+        num_threads = std::max( std::thread::hardware_concurrency(), 1u );
+
+    RVSWDCapture capture;
+    RVSWDCaptureStream capture_stream;
+    std::vector<U8> raw_samples;
+    std::string raw_error;
+    if( raw ? !LoadRawSamples( in_file, raw_samples, raw_error )
+            : stream ? !capture_stream.Open( in_file, dio_column, clk_column, sample_rate )
+                     : !binary && !capture.LoadCSV( in_file, dio_column, clk_column, sample_rate ) )
+    {
+        fprintf( stderr, "rvswd_decode: %s\n",
+                 raw ? raw_error.c_str() : stream ? capture_stream.GetError().c_str() : capture.GetError().c_str() );
+        return 1;
+    }
+
+    // the binary export has a file per channel, which are mapped rather than loaded
+    RVSWDBinaryChannelFile dio_file;
+    RVSWDBinaryChannelFile clk_file;
+    if( binary )
+    {
+        std::string dio_name( std::string( in_file ) + "/digital_" + std::to_string( dio_column ) + ".bin" );
+        std::string clk_name( std::string( in_file ) + "/digital_" + std::to_string( clk_column ) + ".bin" );
+        if( !dio_file.Open( dio_name.c_str() ) || !clk_file.Open( clk_name.c_str() ) )
+        {
+            fprintf( stderr, "rvswd_decode: %s\n", dio_file.GetError().empty() ? clk_file.GetError().c_str() : dio_file.GetError().c_str() );
+            return 1;
+        }
+    }
+
+    double start_time = raw ? 0.0 : binary ? std::min( dio_file.GetBeginTime(), clk_file.GetBeginTime() )
+                                           : stream ? capture_stream.GetStartTime() : capture.GetStartTime();
+
+    if( benchmark )
+    {
+        BenchmarkKernels( raw_samples, U32( dio_column ), U32( clk_column ) );
+        return 0;
+    }
+
+    // the operations file's header is rewritten at the end, so it can't go to stdout
+    RVSWDOperationFileWriter ops_writer;
+    if( ops && !ops_writer.Open( out_file, sample_rate, 0 ) )
+    {
+        fprintf( stderr, "rvswd_decode: can't create %s\n", out_file );
+        return 1;
+    }
+
+    // with a query, its results go to stdout, and the decoded operations only to a file
+    FILE* of = stdout;
+    if( out_file != NULL && !ops )
+    {
+        of = fopen( out_file, "w" );
+        if( of == NULL )
+        {
+            fprintf( stderr, "rvswd_decode: can't create %s\n", out_file );
+            return 1;
+        }
+    }
+
+    // the records are written as they're decoded, give them a big buffer
+    static char out_buffer[ 1 << 16 ];
+    setvbuf( of, out_buffer, _IOFBF, sizeof( out_buffer ) );
+
+    std::unique_ptr<RVSWDOutputSink> sink;
+    if( ops )
+        sink.reset( new RVSWDOperationSink( &ops_writer ) );
+    else if( query_spec == NULL || out_file != NULL )
+    {
+        // the times are the capture's, the trigger is where its time 0 would be
+        RVSWDTextFormat fmt;
+        fmt.display_base = Hexadecimal;
+        fmt.trigger_sample = U64( -llround( start_time * double( sample_rate ) ) );
+        fmt.sample_rate = U32( sample_rate );
+        fmt.multi_bus = false;
+
+        sink.reset( new RVSWDTextSink( of, fmt ) );
+    }
+
+    RVSWDMemoryImage memory;
+    RVSWDOperationIndex index;
+    RVSWDRecordSink* record_sink = NULL;
+    if( memory_file != NULL || query_spec != NULL )
+    {
+        record_sink = new RVSWDRecordSink( sink.release(), memory_file != NULL ? &memory : NULL, query_spec != NULL ? &index : NULL );
+        sink.reset( record_sink );
+    }
+
+    std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+    U64 start_allocations = gNumAllocations;
+
+    U64 num_bits;
+    size_t max_buffered_bits = 0;
+    RVSWDRawBitSource raw_source;
+    RVSWDCaptureStats stats;
+    if( num_threads > 1 )
+    {
+        RVSWDParallelDecoder decoder( capture );
+        decoder.Decode( num_threads, sink.get() );
+
+        num_bits = decoder.GetNumBits();
+        stats = decoder.GetCaptureStats();
+    }
+    else if( raw )
+    {
+        raw_source.Setup( raw_samples.data(), raw_samples.size(), U32( dio_column ), U32( clk_column ), scanner );
+
+        RVSWDParser parser;
+        parser.Setup( &raw_source );
+        Decode( parser, sink.get(), stats );
+
+        num_bits = parser.GetNumBits();
+        max_buffered_bits = parser.GetMaxBufferedBits();
+    }
+    else if( binary )
+    {
+        RVSWDBinaryChannel dio;
+        RVSWDBinaryChannel clk;
+        dio.Setup( &dio_file, start_time, sample_rate );
+        clk.Setup( &clk_file, start_time, sample_rate );
+
+        RVSWDParser parser;
+        parser.Setup( &dio, &clk, sink.get() );
+        Decode( parser, sink.get(), stats );
+
+        num_bits = parser.GetNumBits();
+        max_buffered_bits = parser.GetMaxBufferedBits();
+    }
+    else if( stream )
+    {
+        RVSWDStreamChannel dio;
+        RVSWDStreamChannel clk;
+        capture_stream.Setup( dio, clk );
+
+        RVSWDParser parser;
+        parser.Setup( &dio, &clk, sink.get() );
+        Decode( parser, sink.get(), stats );
+
+        num_bits = parser.GetNumBits();
+        max_buffered_bits = parser.GetMaxBufferedBits();
+
+        if( !capture_stream.GetError().empty() )
+        {
+            fprintf( stderr, "rvswd_decode: %s\n", capture_stream.GetError().c_str() );
+            return 1;
+        }
+    }
+    else
+    {
+        RVSWDCaptureChannel dio;
+        RVSWDCaptureChannel clk;
+        capture.SetupDIO( dio );
+        capture.SetupCLK( clk );
+
+        RVSWDParser parser;
+        parser.Setup( &dio, &clk, sink.get() );
+        Decode( parser, sink.get(), stats );
+
+        num_bits = parser.GetNumBits();
+        max_buffered_bits = parser.GetMaxBufferedBits();
+    }
+
+    if( !sink->Finish() )
+    {
+        fprintf( stderr, "rvswd_decode: can't write %s\n", out_file != NULL ? out_file : "stdout" );
+        return 1;
+    }
+
+    if( memory_file != NULL )
+    {
+        std::string name( memory_file );
+        bool hex = name.size() >= 4 && name.compare( name.size() - 4, 4, ".hex" ) == 0;
+
+        U32 first, last;
+        if( !hex && memory.GetRange( first, last ) && U64( last - first ) + 1 > RVSWDMemoryImage::MAX_BINARY_SPAN )
+        {
+            fprintf( stderr, "rvswd_decode: the memory image spans 0x%08X to 0x%08X, more than the %u MB a raw binary file takes, "
+                             "write it as .hex\n",
+                     first, last, unsigned( RVSWDMemoryImage::MAX_BINARY_SPAN >> 20 ) );
+            return 1;
+        }
+
+        FILE* mf = fopen( memory_file, hex ? "w" : "wb" );
+        bool saved = mf != NULL && ( hex ? memory.SaveHex( mf ) : memory.SaveBinary( mf ) );
+        if( mf != NULL )
+            saved = fclose( mf ) == 0 && saved;
+
+        if( !saved )
+        {
+            fprintf( stderr, "rvswd_decode: can't write %s\n", memory_file );
+            return 1;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    U64 num_allocations = gNumAllocations - start_allocations;
+
+    if( of != stdout )
+        fclose( of );
+    else
+        fflush( of );
+
+    double query_seconds = 0;
+    std::vector<U32> found;
+    if( query_spec != NULL )
+    {
+        if( query_from > -HUGE_VAL )
+            query.start_sample = S64( std::ceil( ( query_from - start_time ) * double( sample_rate ) ) );
+        if( query_to < HUGE_VAL )
+            query.end_sample = S64( std::floor( ( query_to - start_time ) * double( sample_rate ) ) );
+
+        std::chrono::steady_clock::time_point query_start( std::chrono::steady_clock::now() );
+        index.Query( query, found );
+        query_seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - query_start ).count();
+
+        WriteQueryResults( stdout, index, found, start_time, sample_rate );
+        fflush( stdout );
+    }
+
+    fprintf( stderr, "%llu bits, %llu operations, %llu line resets in %.3f s with %u thread(s), %.0f bits/s\n", num_bits,
+             sink->GetNumOperations(), sink->GetNumLineResets(), seconds, unsigned( num_threads ), seconds > 0 ? double( num_bits ) / seconds : 0.0 );
+
+    // the parallel decode buffers each segment's frames, its allocations grow with the capture
+    if( num_threads == 1 )
+        fprintf( stderr, "parser buffer high-water %u bits, %.1f allocations per million bits\n", unsigned( max_buffered_bits ),
+                 num_bits > 0 ? double( num_allocations ) * 1e6 / double( num_bits ) : 0.0 );
+
+    if( memory_file != NULL )
+    {
+        const RVSWDMemoryStats& stats( record_sink->GetStats() );
+        fprintf( stderr, "memory: %llu writes of %llu bytes, %llu reads of %llu bytes, %llu reads lost, %llu bytes in %llu pages\n",
+                 stats.num_writes, stats.num_bytes_written, stats.num_reads, stats.num_bytes_read, stats.num_lost_reads, memory.GetNumBytes(),
+                 memory.GetNumPages() );
+    }
+
+    if( query_spec != NULL )
+    {
+        fprintf( stderr, "index: %llu operations, %llu data values, %.1f MB%s%s, %llu matches in %.1f us\n", index.GetNumOperations(),
+                 index.GetNumValueKeys(), double( index.GetMemoryBytes() ) / ( 1 << 20 ), index.HasAllValues() ? "" : ", data values dropped",
+                 index.IsComplete() ? "" : ", INCOMPLETE", U64( found.size() ), query_seconds * 1e6 );
+    }
+
+    if( capture_stats )
+        stats.Write( stderr, sample_rate );
+
+    if( stream )
+        fprintf( stderr, "at most %u edges buffered\n", unsigned( capture_stream.GetMaxBufferedEdges() ) );
+
+    if( raw )
+        fprintf( stderr, "%s kernel scanned %llu samples in %.3f s, %.2f GB/s\n", GetRawKernelName( kernel ), raw_source.GetNumScanned(),
+                 raw_source.GetScanSeconds(), raw_source.GetScanSeconds() > 0 ? double( raw_source.GetNumScanned() ) / raw_source.GetScanSeconds() / 1e9 : 0.0 );
+
+    return 0;
+}
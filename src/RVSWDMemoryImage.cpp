@@ -0,0 +1,409 @@
+#include <cstring>
+#include <algorithm>
+#include <string>
+
+#include "RVSWDMemoryImage.h"
+
+RVSWDMemoryImage::RVSWDMemoryImage() : mLastPage( NULL ), mNumBytes( 0 )
+{
+    mDirectory.resize( DIRECTORY_SIZE );
+}
+
+void RVSWDMemoryImage::Clear()
+{
+    for( size_t ndx = 0; ndx < mDirectory.size(); ++ndx )
+        mDirectory[ ndx ].reset();
+
+    mPages.clear();
+    mLastPage = NULL;
+    mNumBytes = 0;
+}
+
+RVSWDMemoryImage::Page* RVSWDMemoryImage::FindPage( U32 address ) const
+{
+    const std::unique_ptr<U32[]>& table( mDirectory[ address >> ( PAGE_BITS + TABLE_BITS ) ] );
+    if( !table )
+        return NULL;
+
+    U32 page_ndx = table[ ( address >> PAGE_BITS ) & ( ( 1 << TABLE_BITS ) - 1 ) ];
+    return page_ndx != 0 ? mPages[ page_ndx - 1 ].get() : NULL;
+}
+
+RVSWDMemoryImage::Page* RVSWDMemoryImage::GetPage( U32 address )
+{
+    std::unique_ptr<U32[]>& table( mDirectory[ address >> ( PAGE_BITS + TABLE_BITS ) ] );
+    if( !table )
+        table.reset( new U32[ 1 << TABLE_BITS ]() );
+
+    U32& page_ndx( table[ ( address >> PAGE_BITS ) & ( ( 1 << TABLE_BITS ) - 1 ) ] );
+    if( page_ndx == 0 )
+    {
+        std::unique_ptr<Page> page( new Page );
+        page->base = address & ~U32( PAGE_SIZE - 1 );
+        memset( page->data, 0, sizeof( page->data ) );
+        memset( page->present, 0, sizeof( page->present ) );
+
+        mPages.push_back( std::move( page ) );
+        page_ndx = U32( mPages.size() );
+    }
+
+    return mPages[ page_ndx - 1 ].get();
+}
+
+void RVSWDMemoryImage::Store( U32 address, U32 value, U32 num_bytes )
+{
+    for( U32 ndx = 0; ndx < num_bytes; ++ndx, ++address, value >>= 8 )
+    {
+        if( mLastPage == NULL || ( address & ~U32( PAGE_SIZE - 1 ) ) != mLastPage->base )
+            mLastPage = GetPage( address );
+
+        U32 offset = address & ( PAGE_SIZE - 1 );
+        U64& present( mLastPage->present[ offset / 64 ] );
+        U64 bit = U64( 1 ) << ( offset % 64 );
+        if( ( present & bit ) == 0 )
+        {
+            present |= bit;
+            ++mNumBytes;
+        }
+
+        mLastPage->data[ offset ] = U8( value );
+    }
+}
+
+bool RVSWDMemoryImage::IsPresent( U32 address ) const
+{
+    const Page* page = FindPage( address );
+    U32 offset = address & ( PAGE_SIZE - 1 );
+
+    return page != NULL && ( page->present[ offset / 64 ] & ( U64( 1 ) << ( offset % 64 ) ) ) != 0;
+}
+
+U8 RVSWDMemoryImage::Get( U32 address ) const
+{
+    const Page* page = FindPage( address );
+    return page != NULL ? page->data[ address & ( PAGE_SIZE - 1 ) ] : 0;
+}
+
+std::vector<const RVSWDMemoryImage::Page*> RVSWDMemoryImage::GetSortedPages() const
+{
+    std::vector<const Page*> pages;
+    pages.reserve( mPages.size() );
+    for( size_t ndx = 0; ndx < mPages.size(); ++ndx )
+        pages.push_back( mPages[ ndx ].get() );
+
+    std::sort( pages.begin(), pages.end(), []( const Page* a, const Page* b ) { return a->base < b->base; } );
+
+    return pages;
+}
+
+// appends a record of len bytes of data, with its checksum
+static void AppendHexRecord( std::string& out, U8 type, U16 address, const U8* data, U32 len )
+{
+    static const char digits[] = "0123456789ABCDEF";
+
+    U8 bytes[ 4 ] = { U8( len ), U8( address >> 8 ), U8( address ), type };
+    U8 sum = 0;
+
+    out += ':';
+    for( U32 ndx = 0; ndx < 4 + len; ++ndx )
+    {
+        U8 b = ndx < 4 ? bytes[ ndx ] : data[ ndx - 4 ];
+        sum += b;
+        out += digits[ b >> 4 ];
+        out += digits[ b & 0xF ];
+    }
+
+    U8 checksum = U8( -sum );
+    out += digits[ checksum >> 4 ];
+    out += digits[ checksum & 0xF ];
+    out += '\n';
+}
+
+bool RVSWDMemoryImage::SaveHex( FILE* f ) const
+{
+    const U32 RECORD_BYTES = 16;
+
+    std::vector<const Page*> pages( GetSortedPages() );
+
+    // a page never crosses a 64 KB boundary, so the upper half of the address only changes between pages
+    std::string out;
+    bool has_upper = false;
+    U32 upper = 0;
+    for( std::vector<const Page*>::const_iterator pi( pages.begin() ); pi != pages.end(); ++pi )
+    {
+        const Page& page( **pi );
+
+        if( !has_upper || ( page.base >> 16 ) != upper )
+        {
+            upper = page.base >> 16;
+            has_upper = true;
+
+            U8 data[ 2 ] = { U8( upper >> 8 ), U8( upper ) };
+            AppendHexRecord( out, 4, 0, data, 2 );
+        }
+
+        // a record for every run of stored bytes in a 16 byte line
+        for( U32 line = 0; line < PAGE_SIZE; line += RECORD_BYTES )
+        {
+            U32 bits = U32( page.present[ line / 64 ] >> ( line % 64 ) ) & ( ( 1 << RECORD_BYTES ) - 1 );
+
+            U32 offset = 0;
+            while( bits != 0 )
+            {
+                while( ( bits & 1 ) == 0 )
+                {
+                    bits >>= 1;
+                    ++offset;
+                }
+
+                U32 len = 0;
+                while( ( bits & 1 ) != 0 )
+                {
+                    bits >>= 1;
+                    ++len;
+                }
+
+                AppendHexRecord( out, 0, U16( page.base + line + offset ), page.data + line + offset, len );
+                offset += len;
+            }
+        }
+
+        if( fwrite( out.data(), 1, out.size(), f ) != out.size() )
+            return false;
+
+        out.clear();
+    }
+
+    AppendHexRecord( out, 1, 0, NULL, 0 );
+
+    return fwrite( out.data(), 1, out.size(), f ) == out.size();
+}
+
+bool RVSWDMemoryImage::GetRange( U32& first, U32& last ) const
+{
+    if( mPages.empty() )
+        return false;
+
+    const Page* front = mPages.front().get();
+    const Page* back = front;
+    for( size_t ndx = 1; ndx < mPages.size(); ++ndx )
+    {
+        if( mPages[ ndx ]->base < front->base )
+            front = mPages[ ndx ].get();
+        if( mPages[ ndx ]->base > back->base )
+            back = mPages[ ndx ].get();
+    }
+
+    // the pages are only created to store bytes in, so the first and last have some
+    U32 offset = 0;
+    while( ( front->present[ offset / 64 ] & ( U64( 1 ) << ( offset % 64 ) ) ) == 0 )
+        ++offset;
+    first = front->base + offset;
+
+    offset = PAGE_SIZE - 1;
+    while( ( back->present[ offset / 64 ] & ( U64( 1 ) << ( offset % 64 ) ) ) == 0 )
+        --offset;
+    last = back->base + offset;
+
+    return true;
+}
+
+bool RVSWDMemoryImage::SaveBinary( FILE* f, U8 fill, U64 max_span ) const
+{
+    U32 first_address, last_address;
+    if( GetRange( first_address, last_address ) && U64( last_address - first_address ) + 1 > max_span )
+        return false;
+
+    std::vector<const Page*> pages( GetSortedPages() );
+
+    // the offsets of the first and last byte in their pages
+    U32 first = first_address & ( PAGE_SIZE - 1 );
+    U32 last = last_address & ( PAGE_SIZE - 1 );
+
+    std::vector<U8> fill_page( PAGE_SIZE, fill );
+    std::vector<U8> buffer( PAGE_SIZE );
+
+    U64 next_base = pages.empty() ? 0 : pages.front()->base;
+    for( size_t ndx = 0; ndx < pages.size(); ++ndx )
+    {
+        const Page& page( *pages[ ndx ] );
+
+        // whole pages of fill between the pages that were stored to
+        for( ; next_base < page.base; next_base += PAGE_SIZE )
+        {
+            if( fwrite( fill_page.data(), 1, PAGE_SIZE, f ) != PAGE_SIZE )
+                return false;
+        }
+
+        for( U32 offset = 0; offset < PAGE_SIZE; ++offset )
+            buffer[ offset ] = ( page.present[ offset / 64 ] & ( U64( 1 ) << ( offset % 64 ) ) ) != 0 ? page.data[ offset ] : fill;
+
+        U32 begin = ndx == 0 ? first : 0;
+        U32 end = ndx + 1 == pages.size() ? last + 1 : U32( PAGE_SIZE );
+        if( fwrite( buffer.data() + begin, 1, end - begin, f ) != end - begin )
+            return false;
+
+        next_base = U64( page.base ) + PAGE_SIZE;
+    }
+
+    return true;
+}
+
+// ********************************************************************************
+
+RVSWDMemoryTracker::RVSWDMemoryTracker() : mImage( NULL ), mStoreReads( true )
+{
+    Setup( NULL, true );
+}
+
+void RVSWDMemoryTracker::Setup( RVSWDMemoryImage* pImage, bool store_reads )
+{
+    mImage = pImage;
+    mStoreReads = store_reads;
+
+    // CSW comes out of reset as word accesses without auto-increment
+    for( size_t ndx = 0; ndx < NUM_APS; ++ndx )
+    {
+        mAPs[ ndx ].tar = 0;
+        mAPs[ ndx ].csw = 2;
+    }
+
+    memset( &mPending, 0, sizeof( mPending ) );
+    memset( &mStats, 0, sizeof( mStats ) );
+}
+
+void RVSWDMemoryTracker::Access( APState& ap, RVSWDRegisters reg, U32& address, U32& size )
+{
+    const U32 CSW_SIZE_MASK = 7;
+    const U32 CSW_ADDRINC_SHIFT = 4;
+    const U32 ADDRINC_SINGLE = 1;
+    const U32 ADDRINC_PACKED = 2;
+
+    U32 csw_size = ap.csw & CSW_SIZE_MASK;
+    size = csw_size == 0 ? 1 : csw_size == 1 ? 2 : 4;
+
+    if( reg != RVSWDR_AP_DRW )
+    {
+        // the banked registers are the four words of the 16 byte block TAR is in
+        address = ( ap.tar & ~U32( 0xF ) ) | ( U32( reg - RVSWDR_AP_BD0 ) << 2 );
+        return;
+    }
+
+    address = ap.tar;
+
+    U32 addr_inc = ( ap.csw >> CSW_ADDRINC_SHIFT ) & 3;
+    if( addr_inc == ADDRINC_PACKED )
+        size = 4 - ( address & 3 ); // packed transfers fill the rest of the word
+
+    if( addr_inc == ADDRINC_SINGLE || addr_inc == ADDRINC_PACKED )
+        ap.tar += size;
+
+    // the data is in the byte lanes of the address, an access never goes past its word
+    size = std::min( size, 4 - ( address & 3 ) );
+}
+
+void RVSWDMemoryTracker::Store( U32 address, U32 size, U32 data )
+{
+    if( mImage != NULL )
+        mImage->Store( address, data >> ( ( address & 3 ) * 8 ), size );
+}
+
+void RVSWDMemoryTracker::AddRecord( const RVSWDOperationRecord& rec )
+{
+    // a line reset doesn't touch the APs, and a WAIT wasn't performed
+    if( ( rec.flags & RVSWDOF_LINE_RESET ) != 0 || rec.ack == ACK_WAIT )
+        return;
+
+    // the read that was waiting for this one's data is lost too
+    if( rec.ack != ACK_OK )
+    {
+        if( mPending.valid && mPending.is_data )
+            ++mStats.num_lost_reads;
+
+        mPending.valid = false;
+        return;
+    }
+
+    RVSWDRegisters reg( RVSWDRegisters( rec.reg ) );
+    bool is_read = ( rec.flags & RVSWDOF_READ ) != 0;
+    bool data_ok = ( rec.flags & RVSWDOF_HAS_DATA ) != 0 && ( rec.flags & RVSWDOF_PARITY_OK ) != 0;
+
+    if( ( rec.flags & RVSWDOF_ACCESS_PORT ) == 0 )
+    {
+        // RDBUFF has the data of the last AP read, without starting another
+        if( reg == RVSWDR_DP_RDBUFF && is_read && mPending.valid )
+        {
+            if( mPending.is_data && data_ok )
+            {
+                ++mStats.num_reads;
+                mStats.num_bytes_read += mPending.size;
+
+                if( mStoreReads )
+                    Store( mPending.address, mPending.size, rec.data );
+            }
+
+            mPending.valid = false;
+        }
+
+        return;
+    }
+
+    APState& ap( mAPs[ rec.select >> 24 ] );
+    bool is_data = reg == RVSWDR_AP_DRW || ( reg >= RVSWDR_AP_BD0 && reg <= RVSWDR_AP_BD3 );
+
+    if( is_read )
+    {
+        // this read has the data of the one before it
+        if( mPending.valid && mPending.is_data && data_ok )
+        {
+            ++mStats.num_reads;
+            mStats.num_bytes_read += mPending.size;
+
+            if( mStoreReads )
+                Store( mPending.address, mPending.size, rec.data );
+        }
+
+        mPending.valid = true;
+        mPending.is_data = is_data;
+        if( is_data )
+            Access( ap, reg, mPending.address, mPending.size );
+    }
+    else
+    {
+        // a write in between loses the posted read's data
+        if( mPending.valid && mPending.is_data )
+            ++mStats.num_lost_reads;
+
+        mPending.valid = false;
+
+        // a write with a bad parity is dropped by the target
+        if( !data_ok )
+            return;
+
+        if( reg == RVSWDR_AP_TAR )
+        {
+            ap.tar = rec.data;
+        }
+        else if( reg == RVSWDR_AP_CSW )
+        {
+            ap.csw = rec.data;
+        }
+        else if( is_data )
+        {
+            U32 address, size;
+            Access( ap, reg, address, size );
+            Store( address, size, rec.data );
+
+            ++mStats.num_writes;
+            mStats.num_bytes_written += size;
+        }
+    }
+}
+
+void RVSWDMemoryTracker::Finish()
+{
+    if( mPending.valid && mPending.is_data )
+        ++mStats.num_lost_reads;
+
+    mPending.valid = false;
+}
@@ -0,0 +1,151 @@
+#ifndef RVSWD_MEMORY_IMAGE_H
+#define RVSWD_MEMORY_IMAGE_H
+
+#include <cstdio>
+#include <vector>
+#include <memory>
+
+#include "RVSWDOperationFile.h"
+
+// A sparse image of the target's 32-bit address space, in pages of PAGE_SIZE bytes that
+// are allocated as the bytes in them are first stored. The pages are found through a
+// two-level directory indexed by the address bits, so finding one takes the same time
+// however many there are. Every byte remembers whether it was stored at all.
+class RVSWDMemoryImage
+{
+  public:
+    enum
+    {
+        PAGE_BITS = 12,
+        PAGE_SIZE = 1 << PAGE_BITS,
+        TABLE_BITS = 10, // pages per second level table
+        DIRECTORY_SIZE = 1 << ( 32 - PAGE_BITS - TABLE_BITS ),
+        MAX_BINARY_SPAN = 64 << 20, // the most bytes SaveBinary writes, the gaps included
+    };
+
+    RVSWDMemoryImage();
+
+    void Clear();
+
+    // stores the num_bytes (1..4) low bytes of value from address on, the lowest first
+    void Store( U32 address, U32 value, U32 num_bytes );
+
+    bool IsPresent( U32 address ) const;
+    U8 Get( U32 address ) const;
+
+    U64 GetNumPages() const
+    {
+        return mPages.size();
+    }
+
+    // the bytes that have been stored, each counted once
+    U64 GetNumBytes() const
+    {
+        return mNumBytes;
+    }
+
+    // Writes the stored bytes as Intel HEX, with an extended linear address record
+    // wherever the upper half of the address changes. Returns false if writing failed.
+    bool SaveHex( FILE* f ) const;
+
+    // the lowest and the highest address a byte was stored at, false if there's none
+    bool GetRange( U32& first, U32& last ) const;
+
+    // Writes the bytes from the lowest stored address to the highest, with the bytes
+    // that weren't stored in between set to fill. Flash and RAM are far apart, so that
+    // can be gigabytes: if it's more than max_span it writes nothing and returns false.
+    // Returns false if writing failed too.
+    bool SaveBinary( FILE* f, U8 fill = 0xFF, U64 max_span = MAX_BINARY_SPAN ) const;
+
+  protected:
+    struct Page
+    {
+        U32 base;
+        U8 data[ PAGE_SIZE ];
+        U64 present[ PAGE_SIZE / 64 ];
+    };
+
+    Page* FindPage( U32 address ) const;
+    Page* GetPage( U32 address );
+
+    // the pages in address order
+    std::vector<const Page*> GetSortedPages() const;
+
+    // mDirectory[ address >> 22 ][ ( address >> 12 ) & 1023 ] is the index in mPages plus one, 0 if there's no page yet
+    std::vector<std::unique_ptr<U32[]>> mDirectory;
+    std::vector<std::unique_ptr<Page>> mPages;
+
+    // the page stored to last, consecutive accesses mostly stay in it
+    Page* mLastPage;
+
+    U64 mNumBytes;
+};
+
+// counters of the memory accesses the tracker followed
+struct RVSWDMemoryStats
+{
+    U64 num_writes; // DRW and BDx writes that were stored
+    U64 num_reads;  // the reads whose data arrived
+    U64 num_bytes_written;
+    U64 num_bytes_read;
+    U64 num_lost_reads; // reads whose data never arrived, because of a FAULT or the end of the capture
+};
+
+// Follows the MEM-AP accesses in the operation records and stores what's written to and
+// read from the target in a memory image. Every AP selected by SELECT.APSEL has its own
+// TAR and CSW. The TAR auto-increment follows CSW.AddrInc and CSW.Size. It carries past
+// 1 KB blocks, the spec only guarantees the increment within one so probes write TAR again
+// at each, and with that the carry is right either way. AP reads are posted, a read
+// returns the data of the AP read before it, and RDBUFF that of the last one.
+class RVSWDMemoryTracker
+{
+  public:
+    enum
+    {
+        NUM_APS = 256,
+    };
+
+    RVSWDMemoryTracker();
+
+    void Setup( RVSWDMemoryImage* pImage, bool store_reads );
+
+    void AddRecord( const RVSWDOperationRecord& rec );
+
+    // a read still waiting for its data is lost
+    void Finish();
+
+    const RVSWDMemoryStats& GetStats() const
+    {
+        return mStats;
+    }
+
+  protected:
+    struct APState
+    {
+        U32 tar;
+        U32 csw;
+    };
+
+    struct PendingRead
+    {
+        bool valid;
+        bool is_data; // DRW or BDx, the others aren't memory
+        U32 address;
+        U32 size;
+    };
+
+    // works out where the access goes, and moves TAR on for DRW
+    void Access( APState& ap, RVSWDRegisters reg, U32& address, U32& size );
+
+    void Store( U32 address, U32 size, U32 data );
+
+    RVSWDMemoryImage* mImage;
+    bool mStoreReads;
+
+    APState mAPs[ NUM_APS ];
+    PendingRead mPending;
+
+    RVSWDMemoryStats mStats;
+};
+
+#endif // RVSWD_MEMORY_IMAGE_H
@@ -0,0 +1,523 @@
+#include <cstring>
+#include <algorithm>
+
+#include "RVSWDMultiBus.h"
+#include "RVSWDAnalyzer.h"
+#include "RVSWDAnalyzerSettings.h"
+
+RVSWDEdgeQueue::RVSWDEdgeQueue()
+    : mMutex( 0 ), mMoreEdges( 0 ), mStallSink( 0 ), mIncomingHorizon( 0 ), mStopped( false ), mWaiting( false ), mNextEdge( 0 ), mHorizon( 0 ),
+      mState( BIT_LOW ), mSampleNumber( 0 )
+{
+}
+
+void RVSWDEdgeQueue::Setup( BitState state, U64 sample_number, std::mutex* pMutex, std::condition_variable* pMoreEdges,
+                            RVSWDFrameSink* pStallSink )
+{
+    mMutex = pMutex;
+    mMoreEdges = pMoreEdges;
+    mStallSink = pStallSink;
+
+    mIncoming.clear();
+    mIncomingHorizon = sample_number;
+    mStopped = false;
+    mWaiting = false;
+
+    mEdges.clear();
+    mNextEdge = 0;
+    mHorizon = sample_number;
+
+    mState = state;
+    mSampleNumber = sample_number;
+}
+
+void RVSWDEdgeQueue::Publish( const std::vector<U64>& edges, U64 horizon )
+{
+    mIncoming.insert( mIncoming.end(), edges.begin(), edges.end() );
+    mIncomingHorizon = horizon;
+}
+
+void RVSWDEdgeQueue::Stop()
+{
+    mStopped = true;
+}
+
+void RVSWDEdgeQueue::Refill( bool wait )
+{
+    if( wait && mStallSink != 0 )
+        mStallSink->OnStall( mHorizon );
+
+    std::unique_lock<std::mutex> lock( *mMutex );
+
+    while( wait && !mStopped && mIncoming.empty() && mIncomingHorizon == mHorizon )
+    {
+        mWaiting = true;
+        mMoreEdges->wait( lock );
+    }
+
+    mWaiting = false;
+
+    if( mStopped )
+        throw RVSWDEndOfData();
+
+    // take the whole batch, swapping keeps both buffers' capacity
+    if( mNextEdge == mEdges.size() )
+    {
+        mEdges.swap( mIncoming );
+        mNextEdge = 0;
+    }
+    else
+    {
+        mEdges.insert( mEdges.end(), mIncoming.begin(), mIncoming.end() );
+    }
+
+    mIncoming.clear();
+    mHorizon = mIncomingHorizon;
+}
+
+void RVSWDEdgeQueue::AdvanceToNextEdge()
+{
+    while( mNextEdge == mEdges.size() )
+        Refill( true );
+
+    mSampleNumber = mEdges[ mNextEdge++ ];
+    mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+}
+
+void RVSWDEdgeQueue::AdvanceToAbsPosition( U64 sample_number )
+{
+    for( ;; )
+    {
+        while( mNextEdge < mEdges.size() && mEdges[ mNextEdge ] <= sample_number )
+        {
+            ++mNextEdge;
+            mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+        }
+
+        // we know the state at sample_number once there's an edge after it, or the horizon is past it
+        if( mNextEdge < mEdges.size() || mHorizon >= sample_number )
+            break;
+
+        Refill( true );
+    }
+
+    mSampleNumber = sample_number;
+}
+
+U64 RVSWDEdgeQueue::GetSampleOfNextEdge()
+{
+    while( mNextEdge == mEdges.size() )
+        Refill( true );
+
+    return mEdges[ mNextEdge ];
+}
+
+bool RVSWDEdgeQueue::DoMoreTransitionsExistInCurrentData()
+{
+    if( mNextEdge < mEdges.size() )
+        return true;
+
+    Refill( false );
+
+    return mNextEdge < mEdges.size();
+}
+
+// ********************************************************************************
+
+RVSWDBusDecoder::RVSWDBusDecoder( U32 bus, AnalyzerChannelData* pDIO, AnalyzerChannelData* pCLK, bool show_idle, U64 max_stall,
+                                  std::mutex* pMergeMutex, std::condition_variable* pMerge, bool* pMergeReady )
+    : mBus( bus ), mShowIdle( show_idle ), mMaxStall( max_stall ), mDIO( pDIO ), mCLK( pCLK ), mHorizon( 0 ), mMergeMutex( pMergeMutex ), mMerge( pMerge ),
+      mMergeReady( pMergeReady ), mStarted( false ), mWatermark( 0 )
+{
+    memset( &mStats, 0, sizeof( mStats ) );
+    memset( &mOutStats, 0, sizeof( mOutStats ) );
+}
+
+RVSWDBusDecoder::~RVSWDBusDecoder()
+{
+    Stop();
+}
+
+void RVSWDBusDecoder::Start()
+{
+    mHorizon = mCLK->GetSampleNumber();
+    mWatermark = mHorizon;
+
+    mDIOQueue.Setup( mDIO->GetBitState(), mDIO->GetSampleNumber(), &mMutex, &mMoreEdges, 0 );
+    mCLKQueue.Setup( mCLK->GetBitState(), mCLK->GetSampleNumber(), &mMutex, &mMoreEdges, this );
+
+    mThread = std::thread( &RVSWDBusDecoder::WorkerThread, this );
+}
+
+void RVSWDBusDecoder::Stop()
+{
+    if( !mThread.joinable() )
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        mDIOQueue.Stop();
+        mCLKQueue.Stop();
+    }
+
+    mMoreEdges.notify_all();
+    mThread.join();
+}
+
+bool RVSWDBusDecoder::ReadEdges( U64& capture_end )
+{
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        if( mCLKQueue.GetNumQueued() >= MAX_QUEUED_EDGES )
+            return false;
+    }
+
+    mCLKEdges.clear();
+    while( mCLKEdges.size() < MAX_READ_EDGES && mCLK->DoMoreTransitionsExistInCurrentData() )
+    {
+        mCLK->AdvanceToNextEdge();
+        mCLKEdges.push_back( mCLK->GetSampleNumber() );
+    }
+
+    if( !mCLKEdges.empty() )
+        capture_end = std::max( capture_end, mCLKEdges.back() );
+
+    // If we've read all of CLK's edges, it has none up to the end of the data captured
+    // so far, which is at least as far as any edge we've seen on the other channels.
+    U64 horizon = mCLKEdges.size() < MAX_READ_EDGES ? capture_end : mCLKEdges.back();
+    if( horizon <= mHorizon && mCLKEdges.empty() )
+        return false;
+
+    horizon = std::max( horizon, mHorizon );
+
+    // DIO up to the same horizon, the parser samples it at CLK's edges
+    mDIOEdges.clear();
+    while( mDIO->DoMoreTransitionsExistInCurrentData() && mDIO->GetSampleOfNextEdge() <= horizon )
+    {
+        mDIO->AdvanceToNextEdge();
+        mDIOEdges.push_back( mDIO->GetSampleNumber() );
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        mDIOQueue.Publish( mDIOEdges, horizon );
+        mCLKQueue.Publish( mCLKEdges, horizon );
+    }
+
+    mMoreEdges.notify_all();
+    mHorizon = horizon;
+
+    return true;
+}
+
+void RVSWDBusDecoder::TakeResults( std::deque<Frame>& frames, std::vector<Marker>& markers, U64& watermark, RVSWDBusStats& stats )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    frames.insert( frames.end(), mOutFrames.begin(), mOutFrames.end() );
+    markers.insert( markers.end(), mOutMarkers.begin(), mOutMarkers.end() );
+    mOutFrames.clear();
+    mOutMarkers.clear();
+
+    watermark = mWatermark;
+
+    // the merge counts the late frames itself
+    U64 num_late_frames = stats.num_late_frames;
+    stats = mOutStats;
+    stats.num_late_frames = num_late_frames;
+}
+
+bool RVSWDBusDecoder::IsWaiting()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+    return mCLKQueue.IsWaiting();
+}
+
+void RVSWDBusDecoder::AddFrame( const Frame& f )
+{
+    if( f.mType == RVSWDFT_Idle && !mShowIdle )
+        return;
+
+    mFrames.push_back( f );
+    mFrames.back().mFlags |= U8( mBus << RVSWD_BUS_SHIFT );
+}
+
+void RVSWDBusDecoder::AddMarker( S64 sample_number, RVSWDMarkerTypes marker_type )
+{
+    Marker m = { sample_number, marker_type };
+    mMarkers.push_back( m );
+}
+
+void RVSWDBusDecoder::OnStall( U64 sample_number )
+{
+    // With nothing pending, the next frame starts after the edges we've had. Only a
+    // bit that's straddling the horizon can start a little before it. Buffered bits, and
+    // an idle period or line reset that's being counted, hold the other buses back, but
+    // not for ever, CLK may have stopped for good.
+    if( mStarted && mParser.HasPendingBits() && sample_number - mParser.GetPendingStart() < mMaxStall )
+        Publish( mParser.GetPendingStart() );
+    else
+        Publish( sample_number );
+}
+
+void RVSWDBusDecoder::Publish( U64 watermark )
+{
+    mStats.num_bits = mParser.GetNumBits();
+    mStats.num_frames += mFrames.size();
+
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+
+        mOutFrames.insert( mOutFrames.end(), mFrames.begin(), mFrames.end() );
+        mOutMarkers.insert( mOutMarkers.end(), mMarkers.begin(), mMarkers.end() );
+        mOutStats = mStats;
+
+        mWatermark = std::max( mWatermark, watermark );
+    }
+
+    mFrames.clear();
+    mMarkers.clear();
+
+    {
+        std::lock_guard<std::mutex> lock( *mMergeMutex );
+        *mMergeReady = true;
+    }
+
+    mMerge->notify_one();
+}
+
+void RVSWDBusDecoder::WorkerThread()
+{
+    RVSWDOperation tran;
+    RVSWDLineReset reset;
+    RVSWDIdle idle;
+
+    // the same loop as RVSWDAnalyzer::WorkerThread, until the analyzer stops us
+    try
+    {
+        mParser.Setup( &mDIOQueue, &mCLKQueue, 0 );
+        mParser.Clear();
+        mStarted = true;
+
+        for( ;; )
+        {
+            if( mParser.IsIdle( idle ) )
+            {
+                idle.AddFrames( this );
+
+                mStats.capture.AddIdle( idle );
+            }
+            else if( mParser.IsOperation( tran ) )
+            {
+                tran.AddFrames( this );
+                tran.AddMarkers( this );
+
+                ++mStats.num_operations;
+                mStats.capture.AddOperation( tran );
+            }
+            else if( mParser.IsLineReset( reset ) )
+            {
+                reset.AddFrames( this );
+
+                ++mStats.num_line_resets;
+                mStats.capture.AddLineReset( reset );
+            }
+            else
+            {
+                if( mParser.HadDataParityError() )
+                    mStats.capture.AddParityError();
+
+                size_t num_dropped = mParser.SkipToCandidate();
+                mStats.num_dropped_bits += num_dropped;
+                mStats.capture.AddDropped( num_dropped );
+                continue;
+            }
+
+            if( mFrames.size() >= BATCH_FRAMES )
+                Publish( mParser.GetPendingStart() );
+        }
+    }
+    catch( RVSWDEndOfData& )
+    {
+    }
+}
+
+// ********************************************************************************
+
+RVSWDMultiBusDecoder::RVSWDMultiBusDecoder()
+    : mAnalyzer( 0 ), mResults( 0 ), mMergeReady( false ), mCaptureEnd( 0 ), mLastStart( 0 ), mProgressSpan( 0 ), mNextProgress( 0 )
+{
+}
+
+RVSWDMultiBusDecoder::~RVSWDMultiBusDecoder()
+{
+    Stop();
+}
+
+void RVSWDMultiBusDecoder::Stop()
+{
+    for( size_t bus = 0; bus < mBuses.size(); ++bus )
+        mBuses[ bus ]->Stop();
+}
+
+void RVSWDMultiBusDecoder::Run( RVSWDAnalyzer* pAnalyzer, RVSWDAnalyzerResults* pResults )
+{
+    Stop();
+
+    mAnalyzer = pAnalyzer;
+    mResults = pResults;
+
+    RVSWDAnalyzerSettings* settings = mResults->GetSettings();
+
+    mBuses.clear();
+    mMarkerChannels.clear();
+    mPending.assign( settings->mNumBuses, std::deque<Frame>() );
+    mMarkers.clear();
+
+    RVSWDBusStats no_stats;
+    memset( &no_stats, 0, sizeof( no_stats ) );
+    mStats.assign( settings->mNumBuses, no_stats );
+
+    mMergeReady = false;
+    mCaptureEnd = 0;
+    mLastStart = 0;
+    U64 sample_rate = mAnalyzer->GetSampleRate();
+    U64 max_stall = std::max<U64>( sample_rate * MAX_STALL_MS / 1000, 1 );
+    mProgressSpan = std::max<U64>( sample_rate * RVSWDResultStage::PROGRESS_SPAN_MS / 1000, 1 );
+    mNextProgress = 0;
+    mStartTime = std::chrono::steady_clock::now();
+
+    for( U32 bus = 0; bus < settings->mNumBuses; ++bus )
+    {
+        AnalyzerChannelData* dio = mAnalyzer->GetAnalyzerChannelData( settings->mDIO[ bus ] );
+        AnalyzerChannelData* clk = mAnalyzer->GetAnalyzerChannelData( settings->mCLK[ bus ] );
+
+        mBuses.push_back( std::unique_ptr<RVSWDBusDecoder>(
+            new RVSWDBusDecoder( bus, dio, clk, settings->mShowIdle, max_stall, &mMergeMutex, &mMerge, &mMergeReady ) ) );
+        mMarkerChannels.push_back( settings->mCLK[ bus ] );
+
+        mCaptureEnd = std::max( mCaptureEnd, clk->GetSampleNumber() );
+    }
+
+    for( size_t bus = 0; bus < mBuses.size(); ++bus )
+        mBuses[ bus ]->Start();
+
+    std::chrono::steady_clock::time_point last_busy( mStartTime );
+
+    try
+    {
+        for( ;; )
+        {
+            bool read = false;
+            for( size_t bus = 0; bus < mBuses.size(); ++bus )
+                read |= mBuses[ bus ]->ReadEdges( mCaptureEnd );
+
+            bool waiting = !read;
+            for( size_t bus = 0; bus < mBuses.size() && waiting; ++bus )
+                waiting = mBuses[ bus ]->IsWaiting();
+
+            std::chrono::steady_clock::time_point now( std::chrono::steady_clock::now() );
+            if( !waiting )
+                last_busy = now;
+
+            Merge( now - last_busy >= std::chrono::milliseconds( FLUSH_MS ) );
+
+            if( !read )
+            {
+                {
+                    std::unique_lock<std::mutex> lock( mMergeMutex );
+                    if( !mMergeReady )
+                        mMerge.wait_for( lock, std::chrono::milliseconds( WAIT_MS ) );
+
+                    mMergeReady = false;
+                }
+
+                mAnalyzer->CheckIfThreadShouldExit();
+            }
+        }
+    }
+    catch( ... )
+    {
+        // the pass is being cancelled, the bus threads must be gone before we leave
+        Stop();
+        throw;
+    }
+}
+
+void RVSWDMultiBusDecoder::Merge( bool flush )
+{
+    U64 watermark = U64( -1 );
+    U64 num_markers = 0;
+    for( size_t bus = 0; bus < mBuses.size(); ++bus )
+    {
+        U64 bus_watermark;
+        mMarkers.clear();
+        mBuses[ bus ]->TakeResults( mPending[ bus ], mMarkers, bus_watermark, mStats[ bus ] );
+        watermark = std::min( watermark, bus_watermark );
+
+        // the markers are on the bus's own CLK, only the frames have to be interleaved
+        for( std::vector<RVSWDBusDecoder::Marker>::const_iterator mi( mMarkers.begin() ); mi != mMarkers.end(); ++mi )
+        {
+            static const AnalyzerResults::MarkerType marker_types[] = { AnalyzerResults::Zero, AnalyzerResults::One, AnalyzerResults::X };
+            mResults->AddMarker( mi->sample_number, marker_types[ mi->marker_type ], mMarkerChannels[ bus ] );
+        }
+
+        num_markers += mMarkers.size();
+    }
+
+    U64 progress = watermark;
+    if( flush )
+        watermark = U64( -1 );
+
+    // commit the frames that start before the watermark, in sample order
+    U64 num_frames = 0;
+    for( ;; )
+    {
+        size_t next = mPending.size();
+        for( size_t bus = 0; bus < mPending.size(); ++bus )
+        {
+            if( mPending[ bus ].empty() || U64( mPending[ bus ].front().mStartingSampleInclusive ) >= watermark )
+                continue;
+
+            if( next == mPending.size() ||
+                mPending[ bus ].front().mStartingSampleInclusive < mPending[ next ].front().mStartingSampleInclusive )
+                next = bus;
+        }
+
+        if( next == mPending.size() )
+            break;
+
+        Frame f( mPending[ next ].front() );
+        mPending[ next ].pop_front();
+
+        // a stalled bus's frame that was flushed past, it's shown where it was decoded
+        if( f.mStartingSampleInclusive < mLastStart )
+        {
+            f.mFlags |= DISPLAY_AS_WARNING_FLAG;
+            ++mStats[ next ].num_late_frames;
+        }
+        else
+        {
+            mLastStart = f.mStartingSampleInclusive;
+        }
+
+        mResults->AddFrame( f );
+        ++num_frames;
+    }
+
+    if( num_frames > 0 || num_markers > 0 )
+        mResults->CommitResults();
+
+    for( size_t bus = 0; bus < mStats.size(); ++bus )
+        mResults->SetCaptureStats( U32( bus ), mStats[ bus ].capture );
+
+    double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - mStartTime ).count();
+    for( size_t bus = 0; bus < mStats.size(); ++bus )
+        mStats[ bus ].seconds = seconds;
+
+    if( progress >= mNextProgress )
+    {
+        mAnalyzer->ReportProgress( progress );
+        mNextProgress = progress + mProgressSpan;
+    }
+}
@@ -0,0 +1,244 @@
+#ifndef RVSWD_MULTI_BUS_H
+#define RVSWD_MULTI_BUS_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <AnalyzerChannelData.h>
+
+#include "RVSWDParser.h"
+#include "RVSWDAnalyzerResults.h"
+
+class RVSWDAnalyzer;
+
+// counters kept for every bus of a multi-bus pass
+struct RVSWDBusStats
+{
+    U64 num_bits;
+    U64 num_operations;
+    U64 num_line_resets;
+    U64 num_dropped_bits; // bits that were neither part of an operation nor of a line reset
+    U64 num_frames;
+    U64 num_late_frames; // frames that start before frames of other buses that were already committed
+
+    double seconds; // since the pass started, for the throughput
+
+    RVSWDCaptureStats capture;
+};
+
+// The edges of one channel, read from the SDK by the analyzer's thread and parsed on
+// a bus thread. The edges come in batches, each with a horizon: the channel has no
+// other edges up to there. The DIO and CLK queues of a bus share a mutex and condition.
+class RVSWDEdgeQueue : public RVSWDChannel
+{
+  public:
+    RVSWDEdgeQueue();
+
+    // pStallSink is told before we wait for more edges
+    void Setup( BitState state, U64 sample_number, std::mutex* pMutex, std::condition_variable* pMoreEdges,
+                RVSWDFrameSink* pStallSink );
+
+    // the analyzer's side, call these with the mutex held
+    void Publish( const std::vector<U64>& edges, U64 horizon );
+    void Stop();
+
+    size_t GetNumQueued() const
+    {
+        return mIncoming.size();
+    }
+
+    // the bus thread is waiting for edges we haven't published
+    bool IsWaiting() const
+    {
+        return mWaiting && mIncoming.empty();
+    }
+
+    // the bus thread's side
+    virtual U64 GetSampleNumber()
+    {
+        return mSampleNumber;
+    }
+
+    virtual BitState GetBitState()
+    {
+        return mState;
+    }
+
+    virtual void AdvanceToNextEdge();
+    virtual void AdvanceToAbsPosition( U64 sample_number );
+    virtual U64 GetSampleOfNextEdge();
+    virtual bool DoMoreTransitionsExistInCurrentData();
+
+  protected:
+    void Refill( bool wait );
+
+    std::mutex* mMutex;
+    std::condition_variable* mMoreEdges;
+    RVSWDFrameSink* mStallSink;
+
+    // published but not taken by the bus thread yet, under the mutex
+    std::vector<U64> mIncoming;
+    U64 mIncomingHorizon;
+    bool mStopped;
+    bool mWaiting;
+
+    // the bus thread's edges
+    std::vector<U64> mEdges;
+    size_t mNextEdge;
+    U64 mHorizon;
+
+    BitState mState;
+    U64 mSampleNumber;
+};
+
+// Decodes one bus on its own thread. The frames are tagged with the bus index and
+// handed to the merge in batches, together with a watermark: none of the bus's frames
+// that are still to come starts before it.
+class RVSWDBusDecoder : public RVSWDFrameSink
+{
+  public:
+    enum
+    {
+        BATCH_FRAMES = 256,
+        MAX_READ_EDGES = 1 << 16,     // per channel and ReadEdges call
+        MAX_QUEUED_EDGES = 1 << 20,   // CLK edges waiting for the bus thread
+    };
+
+    struct Marker
+    {
+        S64 sample_number;
+        RVSWDMarkerTypes marker_type;
+    };
+
+    RVSWDBusDecoder( U32 bus, AnalyzerChannelData* pDIO, AnalyzerChannelData* pCLK, bool show_idle, U64 max_stall,
+                     std::mutex* pMergeMutex, std::condition_variable* pMerge, bool* pMergeReady );
+    virtual ~RVSWDBusDecoder();
+
+    void Start();
+    void Stop();
+
+    // Called on the analyzer's thread. Reads the edges the SDK has captured so far and
+    // hands them to the bus thread. capture_end is the latest edge seen on any channel,
+    // the capture has at least reached it. Returns false if there was nothing new.
+    bool ReadEdges( U64& capture_end );
+
+    // called by the merge, moves the published frames and markers over
+    void TakeResults( std::deque<Frame>& frames, std::vector<Marker>& markers, U64& watermark, RVSWDBusStats& stats );
+
+    // the bus thread has parsed all the edges it was given
+    bool IsWaiting();
+
+    virtual void AddFrame( const Frame& f );
+    virtual void AddMarker( S64 sample_number, RVSWDMarkerTypes marker_type );
+    virtual void OnStall( U64 sample_number );
+
+  protected:
+    void WorkerThread();
+    void Publish( U64 watermark );
+
+    U32 mBus;
+    bool mShowIdle;
+
+    // how long buffered bits may hold the other buses back while CLK stands still, in samples
+    U64 mMaxStall;
+
+    // read on the analyzer's thread only
+    AnalyzerChannelData* mDIO;
+    AnalyzerChannelData* mCLK;
+    std::vector<U64> mDIOEdges;
+    std::vector<U64> mCLKEdges;
+    U64 mHorizon;
+
+    std::mutex mMutex;
+    std::condition_variable mMoreEdges;
+    RVSWDEdgeQueue mDIOQueue;
+    RVSWDEdgeQueue mCLKQueue;
+
+    std::mutex* mMergeMutex;
+    std::condition_variable* mMerge;
+    bool* mMergeReady;
+
+    // the bus thread's state
+    std::thread mThread;
+    RVSWDParser mParser;
+    bool mStarted;
+    std::vector<Frame> mFrames;
+    std::vector<Marker> mMarkers;
+    RVSWDBusStats mStats;
+
+    // published for the merge, under mMutex
+    std::vector<Frame> mOutFrames;
+    std::vector<Marker> mOutMarkers;
+    U64 mWatermark;
+    RVSWDBusStats mOutStats;
+};
+
+// Decodes up to RVSWDAnalyzerSettings::MAX_BUSES buses in one analyzer pass, with a
+// thread per bus. The analyzer's thread does all the SDK calls: it reads the edges
+// for the bus threads, and merges their frames into the results in sample order,
+// up to the lowest watermark. A bus whose CLK stopped for more than MAX_STALL_MS halfway
+// through an operation, or whose idle period or line reset has been counted for that long,
+// stops holding the others back, and when all the buses have been waiting for data for
+// FLUSH_MS, the capture has most likely ended and everything is committed. The frames a
+// bus adds after that can start before frames that were already committed: they keep
+// their real time, and are flagged with DISPLAY_AS_WARNING_FLAG.
+// The frames aren't grouped into packets, the buses' operations overlap and a packet
+// has to be a run of consecutive frames.
+class RVSWDMultiBusDecoder
+{
+  public:
+    enum
+    {
+        WAIT_MS = 10,
+        MAX_STALL_MS = 50,
+        FLUSH_MS = 500,
+    };
+
+    RVSWDMultiBusDecoder();
+    ~RVSWDMultiBusDecoder();
+
+    // runs until the SDK ends the pass
+    void Run( RVSWDAnalyzer* pAnalyzer, RVSWDAnalyzerResults* pResults );
+
+    U32 GetNumBuses() const
+    {
+        return U32( mBuses.size() );
+    }
+
+    const RVSWDBusStats& GetBusStats( U32 bus ) const
+    {
+        return mStats[ bus ];
+    }
+
+  protected:
+    void Merge( bool flush );
+    void Stop();
+
+    RVSWDAnalyzer* mAnalyzer;
+    RVSWDAnalyzerResults* mResults;
+
+    std::vector<std::unique_ptr<RVSWDBusDecoder>> mBuses;
+    std::vector<Channel> mMarkerChannels;
+
+    // the bus threads flag new results here
+    std::mutex mMergeMutex;
+    std::condition_variable mMerge;
+    bool mMergeReady;
+
+    std::vector<std::deque<Frame>> mPending;
+    std::vector<RVSWDBusDecoder::Marker> mMarkers;
+    std::vector<RVSWDBusStats> mStats;
+
+    U64 mCaptureEnd;
+    S64 mLastStart;
+    U64 mProgressSpan;
+    U64 mNextProgress;
+    std::chrono::steady_clock::time_point mStartTime;
+};
+
+#endif // RVSWD_MULTI_BUS_H
@@ -0,0 +1,161 @@
+#ifndef RVSWD_NUMBER_FORMAT_H
+#define RVSWD_NUMBER_FORMAT_H
+
+#include <cstring>
+
+#include "RVSWDPlatform.h"
+
+// Formats numbers in binary, decimal and hex the way AnalyzerHelpers::GetNumberString
+// does, but inline and out of lookup tables: hex a byte at a time, binary a nibble at a
+// time and decimal two digits at a time. test/RVSWDNumberFormatTest.cpp compares it with
+// the SDK for every value of every width the analyzer uses.
+//
+// Hexadecimal is "0x" and a digit for every 4 bits, binary is "0b" and a digit for every
+// bit, decimal has no leading zeros.
+//
+// ASCII and AsciiHex aren't formatted here, FormatNumber in RVSWDUtils.cpp leaves them to
+// the SDK. How the SDK shows control characters, bytes above 0x7F and widths other than 8
+// bits isn't documented, so a copy could only be written by reading back the SDK's output,
+// and would break silently when a new SDK changes it. They're rarely picked for register
+// values, and the text export formats them on the calling thread rather than on its
+// workers, so the SDK is never called from the export's threads.
+
+enum
+{
+    NUMBER_STR_SIZE = 2 + 64 + 1, // the longest, binary with 64 bits
+};
+
+// the bases FormatNumberFast formats
+inline bool IsFastNumberBase( DisplayBase display_base )
+{
+    return display_base == Binary || display_base == Decimal || display_base == Hexadecimal;
+}
+
+struct RVSWDNumberTables
+{
+    char hex_pairs[ 256 ][ 2 ];
+    char binary_nibbles[ 16 ][ 4 ];
+    char decimal_pairs[ 100 ][ 2 ];
+
+    RVSWDNumberTables()
+    {
+        static const char digits[] = "0123456789ABCDEF";
+
+        for( int ndx = 0; ndx < 256; ++ndx )
+        {
+            hex_pairs[ ndx ][ 0 ] = digits[ ndx >> 4 ];
+            hex_pairs[ ndx ][ 1 ] = digits[ ndx & 0xF ];
+        }
+
+        for( int ndx = 0; ndx < 16; ++ndx )
+        {
+            for( int bit = 0; bit < 4; ++bit )
+                binary_nibbles[ ndx ][ bit ] = ( ndx >> ( 3 - bit ) ) & 1 ? '1' : '0';
+        }
+
+        for( int ndx = 0; ndx < 100; ++ndx )
+        {
+            decimal_pairs[ ndx ][ 0 ] = char( '0' + ndx / 10 );
+            decimal_pairs[ ndx ][ 1 ] = char( '0' + ndx % 10 );
+        }
+    }
+
+    static const RVSWDNumberTables& Get()
+    {
+        static const RVSWDNumberTables tables;
+        return tables;
+    }
+};
+
+// writes the "0x" form of val with num_digits digits, returns the length
+inline size_t FormatHexDigits( U64 val, U32 num_digits, char* out )
+{
+    const RVSWDNumberTables& tables( RVSWDNumberTables::Get() );
+
+    out[ 0 ] = '0';
+    out[ 1 ] = 'x';
+
+    // from the last digit back
+    size_t len = 2 + num_digits;
+    char* pos = out + len;
+    for( ; num_digits >= 2; num_digits -= 2, val >>= 8 )
+    {
+        pos -= 2;
+        memcpy( pos, tables.hex_pairs[ val & 0xFF ], 2 );
+    }
+
+    if( num_digits != 0 )
+        pos[ -1 ] = tables.hex_pairs[ val & 0xF ][ 1 ];
+
+    out[ len ] = '\0';
+    return len;
+}
+
+inline size_t FormatDecimalDigits( U64 val, char* out )
+{
+    const RVSWDNumberTables& tables( RVSWDNumberTables::Get() );
+
+    // backwards into a buffer, the longest U64 has 20 digits
+    char digits[ 20 ];
+    char* pos = digits + sizeof( digits );
+    for( ; val >= 100; val /= 100 )
+    {
+        pos -= 2;
+        memcpy( pos, tables.decimal_pairs[ val % 100 ], 2 );
+    }
+
+    if( val >= 10 )
+    {
+        pos -= 2;
+        memcpy( pos, tables.decimal_pairs[ val ], 2 );
+    }
+    else
+    {
+        *--pos = char( '0' + val );
+    }
+
+    size_t len = digits + sizeof( digits ) - pos;
+    memcpy( out, pos, len );
+    out[ len ] = '\0';
+
+    return len;
+}
+
+// Formats the low num_bits (1..64) bits of val into out, which has room for
+// NUMBER_STR_SIZE characters, and returns the length. display_base is one of the
+// IsFastNumberBase bases.
+inline size_t FormatNumberFast( U64 val, DisplayBase display_base, U32 num_bits, char* out )
+{
+    const RVSWDNumberTables& tables( RVSWDNumberTables::Get() );
+
+    if( num_bits < 64 )
+        val &= ( U64( 1 ) << num_bits ) - 1;
+
+    if( display_base == Hexadecimal )
+        return FormatHexDigits( val, ( num_bits + 3 ) / 4, out );
+
+    if( display_base == Binary )
+    {
+        out[ 0 ] = '0';
+        out[ 1 ] = 'b';
+
+        size_t len = 2 + num_bits;
+        char* pos = out + len;
+        U32 bits = num_bits;
+        for( ; bits >= 4; bits -= 4, val >>= 4 )
+        {
+            pos -= 4;
+            memcpy( pos, tables.binary_nibbles[ val & 0xF ], 4 );
+        }
+
+        for( ; bits != 0; --bits, val >>= 1 )
+            *--pos = ( val & 1 ) ? '1' : '0';
+
+        out[ len ] = '\0';
+        return len;
+    }
+
+    return FormatDecimalDigits( val, out );
+}
+
+#endif // RVSWD_NUMBER_FORMAT_H
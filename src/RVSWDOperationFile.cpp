@@ -0,0 +1,166 @@
+#include <cstring>
+
+#include "RVSWDOperationFile.h"
+
+RVSWDOperationRecordBuilder::RVSWDOperationRecordBuilder()
+{
+}
+
+void RVSWDOperationRecordBuilder::Setup( U32 num_buses )
+{
+    mBuses.resize( num_buses );
+    for( size_t bus = 0; bus < mBuses.size(); ++bus )
+    {
+        memset( &mBuses[ bus ].open, 0, sizeof( mBuses[ bus ].open ) );
+        mBuses[ bus ].open.bus = U8( bus );
+        mBuses[ bus ].is_open = false;
+    }
+}
+
+void RVSWDOperationRecordBuilder::CloseOpen( BusState& state, std::vector<RVSWDOperationRecord>& records )
+{
+    if( !state.is_open )
+        return;
+
+    records.push_back( state.open );
+    state.is_open = false;
+}
+
+void RVSWDOperationRecordBuilder::AddFrame( const Frame& f, U32 bus, std::vector<RVSWDOperationRecord>& records )
+{
+    if( bus >= mBuses.size() )
+        bus = 0;
+
+    BusState& state( mBuses[ bus ] );
+    RVSWDOperationRecord& rec( state.open );
+
+    if( f.mType == RVSWDFT_Request )
+    {
+        CloseOpen( state, records );
+
+        const RVSWDRequestFrame& req( ( const RVSWDRequestFrame& )f );
+        memset( &rec, 0, sizeof( rec ) );
+        rec.start_sample = f.mStartingSampleInclusive;
+        rec.end_sample = f.mEndingSampleInclusive;
+        rec.select = req.GetSelect();
+        rec.request_byte = req.GetRequestByte();
+        rec.reg = U8( req.GetRegister() );
+        rec.flags = ( req.IsRead() ? RVSWDOF_READ : 0 ) | ( req.IsAccessPort() ? RVSWDOF_ACCESS_PORT : 0 );
+        rec.bus = U8( bus );
+
+        state.is_open = true;
+    }
+    else if( f.mType == RVSWDFT_LineReset )
+    {
+        CloseOpen( state, records );
+
+        memset( &rec, 0, sizeof( rec ) );
+        rec.start_sample = f.mStartingSampleInclusive;
+        rec.end_sample = f.mEndingSampleInclusive;
+        rec.data = U32( f.mData1 );
+        rec.flags = RVSWDOF_LINE_RESET;
+        rec.bus = U8( bus );
+
+        state.is_open = true;
+        CloseOpen( state, records );
+    }
+    else if( !state.is_open )
+    {
+        // the rest only belong to an operation
+    }
+    else if( f.mType == RVSWDFT_ACK )
+    {
+        rec.ack = U8( f.mData1 );
+        rec.end_sample = f.mEndingSampleInclusive;
+    }
+    else if( f.mType == RVSWDFT_WData )
+    {
+        rec.data = U32( f.mData1 );
+        rec.flags |= RVSWDOF_HAS_DATA;
+        rec.end_sample = f.mEndingSampleInclusive;
+    }
+    else if( f.mType == RVSWDFT_DataParity )
+    {
+        if( f.mData2 != 0 )
+            rec.flags |= RVSWDOF_PARITY_OK;
+        rec.end_sample = f.mEndingSampleInclusive;
+
+        CloseOpen( state, records );
+    }
+    else if( f.mType == RVSWDFT_Idle )
+    {
+        CloseOpen( state, records );
+    }
+}
+
+void RVSWDOperationRecordBuilder::Close( U32 bus, std::vector<RVSWDOperationRecord>& records )
+{
+    if( bus < mBuses.size() )
+        CloseOpen( mBuses[ bus ], records );
+}
+
+bool RVSWDOperationRecordBuilder::HasOpenRecords() const
+{
+    for( size_t bus = 0; bus < mBuses.size(); ++bus )
+    {
+        if( mBuses[ bus ].is_open )
+            return true;
+    }
+
+    return false;
+}
+
+void RVSWDOperationRecordBuilder::Finish( std::vector<RVSWDOperationRecord>& records )
+{
+    for( size_t bus = 0; bus < mBuses.size(); ++bus )
+        CloseOpen( mBuses[ bus ], records );
+}
+
+// ********************************************************************************
+
+RVSWDOperationFileWriter::RVSWDOperationFileWriter() : mFile( NULL ), mFailed( false )
+{
+    memset( &mHeader, 0, sizeof( mHeader ) );
+}
+
+RVSWDOperationFileWriter::~RVSWDOperationFileWriter()
+{
+    if( mFile != NULL )
+        fclose( mFile );
+}
+
+bool RVSWDOperationFileWriter::Open( const char* file_name, U64 sample_rate, S64 trigger_sample )
+{
+    mFile = fopen( file_name, "wb" );
+    if( mFile == NULL )
+        return false;
+
+    mFileBuffer.resize( FILE_BUFFER_SIZE );
+    setvbuf( mFile, mFileBuffer.data(), _IOFBF, mFileBuffer.size() );
+
+    memset( &mHeader, 0, sizeof( mHeader ) );
+    memcpy( mHeader.magic, "RVSWDOPS", sizeof( mHeader.magic ) );
+    mHeader.version = 1;
+    mHeader.record_size = sizeof( RVSWDOperationRecord );
+    mHeader.sample_rate = sample_rate;
+    mHeader.trigger_sample = trigger_sample;
+
+    // the header is written again with the number of records when we're done
+    mFailed = fwrite( &mHeader, sizeof( mHeader ), 1, mFile ) != 1;
+
+    return true;
+}
+
+bool RVSWDOperationFileWriter::Close()
+{
+    if( mFile == NULL )
+        return false;
+
+    // a failed write may only show up when the buffer is flushed
+    bool ok = !mFailed && fflush( mFile ) == 0;
+    ok = fseek( mFile, 0, SEEK_SET ) == 0 && fwrite( &mHeader, sizeof( mHeader ), 1, mFile ) == 1 && ok;
+    ok = fclose( mFile ) == 0 && ok;
+    mFile = NULL;
+
+    return ok;
+}
@@ -0,0 +1,121 @@
+#ifndef RVSWD_OPERATION_FILE_H
+#define RVSWD_OPERATION_FILE_H
+
+#include <cstdio>
+#include <vector>
+#include <string>
+
+#include "RVSWDTypes.h"
+
+// The operations file is the binary export: a header, then a fixed-width record for each
+// operation and line reset, so that a reader can map the file and index the records
+// directly. Everything is little endian, like the hosts Logic 2 runs on.
+struct RVSWDOperationFileHeader
+{
+    char magic[ 8 ]; // "RVSWDOPS"
+    U32 version;
+    U32 record_size;
+    U64 sample_rate;
+    S64 trigger_sample;
+    U64 num_records;
+    U64 reserved;
+};
+
+// RVSWDOperationRecord::flags
+enum
+{
+    RVSWDOF_READ = 1 << 0,
+    RVSWDOF_ACCESS_PORT = 1 << 1,
+    RVSWDOF_HAS_DATA = 1 << 2,  // the operation got to its data phase, data is valid
+    RVSWDOF_PARITY_OK = 1 << 3, // and the data parity was right
+    RVSWDOF_LINE_RESET = 1 << 4,
+};
+
+struct RVSWDOperationRecord
+{
+    S64 start_sample;
+    S64 end_sample;
+    U32 data;   // the length in bits for a line reset
+    U32 select; // the SELECT register the operation's register was resolved with, 0 for a line reset
+    U8 request_byte;
+    U8 ack;
+    U8 reg; // RVSWDRegisters
+    U8 flags;
+    U8 bus;
+    U8 reserved[ 3 ];
+};
+
+static_assert( sizeof( RVSWDOperationFileHeader ) == 48, "operations file header layout" );
+static_assert( sizeof( RVSWDOperationRecord ) == 32, "operation record layout" );
+
+// Groups the frames of the operations and line resets into records. The frames of the
+// buses can be interleaved, every bus has its own open record.
+class RVSWDOperationRecordBuilder
+{
+  public:
+    RVSWDOperationRecordBuilder();
+
+    void Setup( U32 num_buses );
+
+    // Appends the records the frame ended to records. A data parity or line reset frame
+    // ends one, and the next frame of the bus ends an operation without a data phase.
+    void AddFrame( const Frame& f, U32 bus, std::vector<RVSWDOperationRecord>& records );
+
+    // appends the operation that's still open on the bus, if there is one
+    void Close( U32 bus, std::vector<RVSWDOperationRecord>& records );
+
+    // appends the operations that are still open
+    void Finish( std::vector<RVSWDOperationRecord>& records );
+
+    bool HasOpenRecords() const;
+
+  protected:
+    struct BusState
+    {
+        RVSWDOperationRecord open;
+        bool is_open;
+    };
+
+    static void CloseOpen( BusState& state, std::vector<RVSWDOperationRecord>& records );
+
+    std::vector<BusState> mBuses;
+};
+
+// Writes the operations file through a big stdio buffer. The number of records in the
+// header is filled in by Close.
+class RVSWDOperationFileWriter
+{
+  public:
+    enum
+    {
+        FILE_BUFFER_SIZE = 1 << 20,
+    };
+
+    RVSWDOperationFileWriter();
+    ~RVSWDOperationFileWriter();
+
+    bool Open( const char* file_name, U64 sample_rate, S64 trigger_sample );
+
+    void Write( const RVSWDOperationRecord& record )
+    {
+        if( fwrite( &record, sizeof( record ), 1, mFile ) != 1 )
+            mFailed = true;
+        ++mHeader.num_records;
+    }
+
+    // returns false if the file couldn't be written, any of it
+    bool Close();
+
+    U64 GetNumRecords() const
+    {
+        return mHeader.num_records;
+    }
+
+  protected:
+    FILE* mFile;
+    std::vector<char> mFileBuffer;
+    RVSWDOperationFileHeader mHeader;
+    bool mFailed; // a write failed, the header's count won't match the file
+};
+
+#endif // RVSWD_OPERATION_FILE_H
@@ -0,0 +1,241 @@
+#include <algorithm>
+
+#include "RVSWDOperationIndex.h"
+
+RVSWDOperationIndex::RVSWDOperationIndex()
+{
+    Setup( GetDefaultValueRegisters(), U64( DEFAULT_MAX_MB ) << 20 );
+}
+
+U32 RVSWDOperationIndex::GetDefaultValueRegisters()
+{
+    return 1 << RVSWDR_DP_SELECT | 1 << RVSWDR_DP_CTRL_STAT | 1 << RVSWDR_AP_CSW | 1 << RVSWDR_AP_TAR | 1 << RVSWDR_AP_DRW | 1 << RVSWDR_AP_BD0 |
+           1 << RVSWDR_AP_BD1 | 1 << RVSWDR_AP_BD2 | 1 << RVSWDR_AP_BD3;
+}
+
+void RVSWDOperationIndex::Setup( U32 value_registers, U64 max_bytes )
+{
+    mValueRegisters = value_registers;
+    mMaxBytes = max_bytes;
+
+    Clear();
+}
+
+void RVSWDOperationIndex::Clear()
+{
+    // swapped with empty ones so the memory goes too
+    std::vector<RVSWDIndexedOperation>().swap( mOperations );
+    for( size_t ndx = 0; ndx < sizeof( mRegisterLists ) / sizeof( mRegisterLists[ 0 ] ); ++ndx )
+        std::vector<U32>().swap( mRegisterLists[ ndx ] );
+    for( size_t ndx = 0; ndx < NUM_ACK_LISTS; ++ndx )
+        std::vector<U32>().swap( mACKLists[ ndx ] );
+    std::unordered_map<U64, std::vector<U32>>().swap( mValueLists );
+
+    // an empty table has its buckets already
+    mValueBytes = mValueLists.bucket_count() * sizeof( void* );
+    mBytes = mValueBytes;
+    mComplete = true;
+    mAllValues = true;
+}
+
+size_t RVSWDOperationIndex::GetACKList( U32 ack )
+{
+    if( ack == ACK_OK )
+        return 0;
+    else if( ack == ACK_WAIT )
+        return 1;
+    else if( ack == ACK_FAULT )
+        return 2;
+
+    return 3;
+}
+
+void RVSWDOperationIndex::DropValues()
+{
+    std::unordered_map<U64, std::vector<U32>>().swap( mValueLists );
+    mBytes -= mValueBytes;
+    mValueBytes = mValueLists.bucket_count() * sizeof( void* );
+    mBytes += mValueBytes;
+    mAllValues = false;
+}
+
+void RVSWDOperationIndex::AddOperation( const RVSWDIndexedOperation& op )
+{
+    if( !mComplete )
+        return;
+
+    if( mOperations.size() >= 0xFFFFFFFFull || op.reg > RVSWDR_AP_IDR )
+    {
+        mComplete = false;
+        return;
+    }
+
+    // an operation takes its entry and one in a register list and in an ACK list
+    std::vector<U32>& reg_list( mRegisterLists[ GetRegisterList( op.reg, ( op.flags & RVSWDOF_READ ) != 0 ) ] );
+    std::vector<U32>& ack_list( mACKLists[ GetACKList( op.ack ) ] );
+    U64 growth = GetGrowthBytes( mOperations ) + GetGrowthBytes( reg_list ) + GetGrowthBytes( ack_list );
+    if( mBytes + growth > mMaxBytes )
+    {
+        mComplete = false;
+        return;
+    }
+
+    Grow( mOperations );
+    Grow( reg_list );
+    Grow( ack_list );
+
+    U32 ndx = U32( mOperations.size() );
+    mOperations.push_back( op );
+    reg_list.push_back( ndx );
+    ack_list.push_back( ndx );
+    mBytes += growth;
+
+    if( ( op.flags & RVSWDOF_HAS_DATA ) == 0 || ( mValueRegisters & ( 1 << op.reg ) ) == 0 || !mAllValues )
+        return;
+
+    std::unordered_map<U64, std::vector<U32>>::iterator vi( mValueLists.find( GetValueKey( op.reg, op.data ) ) );
+    U64 value_bytes = vi == mValueLists.end() ? U64( VALUE_KEY_BYTES ) + sizeof( U32 ) : GetGrowthBytes( vi->second );
+    if( mValueBytes + value_bytes > mMaxBytes / 2 || mBytes + value_bytes > mMaxBytes )
+    {
+        DropValues();
+        return;
+    }
+
+    if( vi == mValueLists.end() )
+    {
+        // the table's buckets can only be counted once it's rehashed
+        size_t num_buckets = mValueLists.bucket_count();
+        vi = mValueLists.insert( std::make_pair( GetValueKey( op.reg, op.data ), std::vector<U32>() ) ).first;
+        value_bytes += U64( mValueLists.bucket_count() - num_buckets ) * sizeof( void* );
+
+        if( mValueBytes + value_bytes > mMaxBytes / 2 || mBytes + value_bytes > mMaxBytes )
+        {
+            DropValues();
+            return;
+        }
+    }
+
+    Grow( vi->second );
+    vi->second.push_back( ndx );
+    mValueBytes += value_bytes;
+    mBytes += value_bytes;
+}
+
+void RVSWDOperationIndex::AddRecord( const RVSWDOperationRecord& rec )
+{
+    if( rec.flags & RVSWDOF_LINE_RESET )
+        return;
+
+    RVSWDIndexedOperation op;
+    op.start_sample = rec.start_sample;
+    op.data = rec.data;
+    op.reg = rec.reg;
+    op.ack = rec.ack;
+    op.flags = rec.flags & ( RVSWDOF_READ | RVSWDOF_ACCESS_PORT | RVSWDOF_HAS_DATA );
+    op.reserved = 0;
+
+    AddOperation( op );
+}
+
+void RVSWDOperationIndex::GetIndexedOperation( RVSWDOperation& tran, RVSWDIndexedOperation& op )
+{
+    // the same as the request frame and the record built from the frames
+    op.start_sample = tran.bits[ 0 ].GetStartSample();
+    op.reg = U8( tran.reg );
+    op.ack = tran.ACK;
+    op.flags = ( tran.IsRead() ? RVSWDOF_READ : 0 ) | ( tran.APnDP ? RVSWDOF_ACCESS_PORT : 0 );
+    op.reserved = 0;
+
+    if( tran.bits.Size() >= TRAN_READ_LENGTH )
+    {
+        op.data = tran.data;
+        op.flags |= RVSWDOF_HAS_DATA;
+    }
+    else
+    {
+        op.data = 0;
+    }
+}
+
+void RVSWDOperationIndex::QueryList( const std::vector<U32>& list, U32 first, U32 end, const RVSWDIndexQuery& query,
+                                     std::vector<U32>& found ) const
+{
+    for( std::vector<U32>::const_iterator li( std::lower_bound( list.begin(), list.end(), first ) ); li != list.end() && *li < end; ++li )
+    {
+        if( query.Matches( mOperations[ *li ] ) )
+            found.push_back( *li );
+    }
+}
+
+void RVSWDOperationIndex::Query( const RVSWDIndexQuery& query, std::vector<U32>& found ) const
+{
+    found.clear();
+
+    // the operations that start in the range
+    struct StartsBefore
+    {
+        bool operator()( const RVSWDIndexedOperation& op, S64 sample ) const
+        {
+            return op.start_sample < sample;
+        }
+        bool operator()( S64 sample, const RVSWDIndexedOperation& op ) const
+        {
+            return sample < op.start_sample;
+        }
+    };
+
+    U32 first = U32( std::lower_bound( mOperations.begin(), mOperations.end(), query.start_sample, StartsBefore() ) - mOperations.begin() );
+    U32 end = U32( std::upper_bound( mOperations.begin(), mOperations.end(), query.end_sample, StartsBefore() ) - mOperations.begin() );
+    if( first >= end )
+        return;
+
+    bool by_value = query.match_data && query.reg != RVSWDR_undefined && query.reg <= RVSWDR_AP_IDR && ( mValueRegisters & ( 1 << query.reg ) ) != 0 &&
+                    mAllValues;
+
+    if( by_value )
+    {
+        std::unordered_map<U64, std::vector<U32>>::const_iterator vi( mValueLists.find( GetValueKey( query.reg, query.data ) ) );
+        if( vi != mValueLists.end() )
+            QueryList( vi->second, first, end, query, found );
+    }
+    else if( query.reg != RVSWDR_undefined && query.reg <= RVSWDR_AP_IDR )
+    {
+        // both directions are two lists, merged back into order
+        if( query.rnw != RVSWDExportFilter::WRITE )
+            QueryList( mRegisterLists[ GetRegisterList( query.reg, true ) ], first, end, query, found );
+
+        size_t num_reads = found.size();
+        if( query.rnw != RVSWDExportFilter::READ )
+            QueryList( mRegisterLists[ GetRegisterList( query.reg, false ) ], first, end, query, found );
+
+        std::inplace_merge( found.begin(), found.begin() + num_reads, found.end() );
+    }
+    else if( query.ack != RVSWDExportFilter::ANY )
+    {
+        QueryList( mACKLists[ GetACKList( query.ack ) ], first, end, query, found );
+    }
+    else
+    {
+        for( U32 ndx = first; ndx < end; ++ndx )
+        {
+            if( query.Matches( mOperations[ ndx ] ) )
+                found.push_back( ndx );
+        }
+    }
+}
+
+U64 RVSWDOperationIndex::GetMemoryBytes() const
+{
+    U64 bytes = mOperations.capacity() * sizeof( RVSWDIndexedOperation );
+
+    for( size_t ndx = 0; ndx < sizeof( mRegisterLists ) / sizeof( mRegisterLists[ 0 ] ); ++ndx )
+        bytes += mRegisterLists[ ndx ].capacity() * sizeof( U32 );
+    for( size_t ndx = 0; ndx < NUM_ACK_LISTS; ++ndx )
+        bytes += mACKLists[ ndx ].capacity() * sizeof( U32 );
+
+    bytes += mValueLists.bucket_count() * sizeof( void* );
+    for( std::unordered_map<U64, std::vector<U32>>::const_iterator vi( mValueLists.begin() ); vi != mValueLists.end(); ++vi )
+        bytes += VALUE_KEY_BYTES + vi->second.capacity() * sizeof( U32 );
+
+    return bytes;
+}
@@ -0,0 +1,164 @@
+#ifndef RVSWD_OPERATION_INDEX_H
+#define RVSWD_OPERATION_INDEX_H
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include "RVSWDTypes.h"
+#include "RVSWDExportFilter.h"
+#include "RVSWDOperationFile.h"
+
+// what the index keeps of an operation
+struct RVSWDIndexedOperation
+{
+    S64 start_sample; // of the request
+    U32 data;         // valid with RVSWDOF_HAS_DATA
+    U8 reg;           // RVSWDRegisters
+    U8 ack;
+    U8 flags; // RVSWDOF_READ, RVSWDOF_ACCESS_PORT and RVSWDOF_HAS_DATA
+    U8 reserved;
+};
+
+// the export filter's fields, and optionally the data value
+struct RVSWDIndexQuery : public RVSWDExportFilter
+{
+    bool match_data;
+    U32 data;
+
+    RVSWDIndexQuery() : match_data( false ), data( 0 )
+    {
+    }
+
+    explicit RVSWDIndexQuery( const RVSWDExportFilter& filter ) : RVSWDExportFilter( filter ), match_data( false ), data( 0 )
+    {
+    }
+
+    bool Matches( const RVSWDIndexedOperation& op ) const
+    {
+        return MatchesOperation( RVSWDRegisters( op.reg ), ( op.flags & RVSWDOF_READ ) != 0, ( op.flags & RVSWDOF_ACCESS_PORT ) != 0, op.ack ) &&
+               ( !match_data || ( ( op.flags & RVSWDOF_HAS_DATA ) != 0 && op.data == data ) );
+    }
+};
+
+// An inverted index of the operations, built as they're decoded. The operations are
+// numbered in the order they're added, which is the order of their start samples, and
+// there's a sorted posting list of those numbers for every register and direction, for
+// every ACK value, and for every data value of the registers picked in Setup. A query
+// takes the shortest list that applies, finds the start of its sample range with a
+// binary search, and checks the rest of the query on the operations in the range.
+// The memory is capped. Past half the cap the data values aren't indexed any more, a
+// query on them then goes through the register's list, and past the cap the index
+// stops taking operations and is no longer complete. The cap counts the lists' whole
+// capacity: they double when they're full, and each doubling is checked before it's made.
+class RVSWDOperationIndex
+{
+  public:
+    enum
+    {
+        NUM_ACK_LISTS = 4,        // OK, WAIT, FAULT and the rest
+        VALUE_KEY_BYTES = 64,     // what a data value's list costs before its entries, roughly
+        DEFAULT_MAX_MB = 256,
+    };
+
+    RVSWDOperationIndex();
+
+    // value_registers is a mask of 1 << RVSWDRegisters, the registers whose data values are indexed
+    void Setup( U32 value_registers, U64 max_bytes );
+    void Clear();
+
+    // SELECT, CTRL/STAT, CSW, TAR, DRW and the banked data registers
+    static U32 GetDefaultValueRegisters();
+
+    void AddOperation( const RVSWDIndexedOperation& op );
+
+    // the record's operation, line resets aren't indexed
+    void AddRecord( const RVSWDOperationRecord& rec );
+
+    // what's indexed of a decoded operation, before the parser moves on, the bits are a view into its buffer
+    static void GetIndexedOperation( RVSWDOperation& tran, RVSWDIndexedOperation& op );
+
+    // the numbers of the operations that match, in order
+    void Query( const RVSWDIndexQuery& query, std::vector<U32>& found ) const;
+
+    const RVSWDIndexedOperation& GetOperation( U32 ndx ) const
+    {
+        return mOperations[ ndx ];
+    }
+
+    U64 GetNumOperations() const
+    {
+        return mOperations.size();
+    }
+
+    U64 GetNumValueKeys() const
+    {
+        return mValueLists.size();
+    }
+
+    // every operation that was added is in the index
+    bool IsComplete() const
+    {
+        return mComplete;
+    }
+
+    // and so are all their data values
+    bool HasAllValues() const
+    {
+        return mAllValues;
+    }
+
+    // what the index takes, counting the vectors' spare capacity
+    U64 GetMemoryBytes() const;
+
+  protected:
+    static size_t GetRegisterList( U32 reg, bool is_read )
+    {
+        return reg * 2 + ( is_read ? 1 : 0 );
+    }
+
+    static size_t GetACKList( U32 ack );
+
+    static U64 GetValueKey( U32 reg, U32 data )
+    {
+        return U64( reg ) << 32 | data;
+    }
+
+    // the bytes growing the list for one more entry takes, 0 if there's room in it
+    template <class T>
+    static U64 GetGrowthBytes( const std::vector<T>& list )
+    {
+        return list.size() < list.capacity() ? 0 : std::max<U64>( list.capacity(), 1 ) * sizeof( T );
+    }
+
+    // grows the list by what GetGrowthBytes returned
+    template <class T>
+    static void Grow( std::vector<T>& list )
+    {
+        if( list.size() == list.capacity() )
+            list.reserve( list.capacity() + std::max<size_t>( list.capacity(), 1 ) );
+    }
+
+    // the values indexed so far are dropped, the queries can't use part of them
+    void DropValues();
+
+    // appends the operations from list that are numbered first to end and match
+    void QueryList( const std::vector<U32>& list, U32 first, U32 end, const RVSWDIndexQuery& query, std::vector<U32>& found ) const;
+
+    std::vector<RVSWDIndexedOperation> mOperations;
+    std::vector<U32> mRegisterLists[ 2 * ( RVSWDR_AP_IDR + 1 ) ];
+    std::vector<U32> mACKLists[ NUM_ACK_LISTS ];
+    std::unordered_map<U64, std::vector<U32>> mValueLists;
+
+    U32 mValueRegisters;
+    U64 mMaxBytes;
+
+    // what GetMemoryBytes returns, kept as the lists grow, and the part of it that's the data values
+    U64 mBytes;
+    U64 mValueBytes;
+
+    bool mComplete;
+    bool mAllValues;
+};
+
+#endif // RVSWD_OPERATION_INDEX_H
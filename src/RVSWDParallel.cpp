@@ -0,0 +1,259 @@
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <limits>
+
+#include "RVSWDParallel.h"
+
+// keeps the frames of a segment until it's merged
+class RVSWDFrameCollector : public RVSWDFrameSink
+{
+  public:
+    RVSWDFrameCollector( std::vector<Frame>& frames ) : mFrames( frames )
+    {
+    }
+
+    virtual void AddFrame( const Frame& f )
+    {
+        mFrames.push_back( f );
+    }
+
+    virtual void AddMarker( S64 /*sample_number*/, RVSWDMarkerTypes /*marker_type*/ )
+    {
+    }
+
+  protected:
+    std::vector<Frame>& mFrames;
+};
+
+RVSWDParallelDecoder::RVSWDParallelDecoder( const RVSWDCapture& capture ) : mCapture( capture ), mNumBits( 0 ), mNextSegment( 0 )
+{
+    mCaptureStats.Clear();
+}
+
+void RVSWDParallelDecoder::FindSegments( size_t min_segment_bits )
+{
+    const std::vector<U64>& clk( mCapture.GetCLKEdges() );
+    const std::vector<U64>& dio( mCapture.GetDIOEdges() );
+
+    mSegments.clear();
+    mNumBits = 0;
+
+    Segment seg;
+    seg.start_sample = 0;
+    seg.clk_state = mCapture.GetCLKInitialState();
+    seg.clk_first_edge = 0;
+    seg.done = false;
+
+    BitState clk_state = mCapture.GetCLKInitialState();
+    BitState dio_state = mCapture.GetDIOInitialState();
+    size_t dio_ndx = 0;
+    U64 run = 0;
+    U64 seg_bits = 0;
+
+    // every rising CLK edge starts a bit
+    for( size_t ndx = 0; ndx < clk.size(); ++ndx )
+    {
+        clk_state = clk_state == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+        if( clk_state != BIT_HIGH )
+            continue;
+
+        // DIO is sampled one sample before the rising edge, like RVSWDBitExtractor does
+        U64 sample = clk[ ndx ] - 1;
+        while( dio_ndx < dio.size() && dio[ dio_ndx ] <= sample )
+        {
+            dio_state = dio_state == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+            ++dio_ndx;
+        }
+
+        // the parser only has a bit once it's seen the falling edge and the rising edge after it
+        if( ndx + 2 < clk.size() )
+            ++mNumBits;
+
+        ++seg_bits;
+
+        if( dio_state == BIT_HIGH )
+        {
+            ++run;
+            continue;
+        }
+
+        if( run >= MIN_SPLIT_RUN && seg_bits >= min_segment_bits )
+        {
+            // the segment ends with this bit, and a couple of edges more so that the
+            // line reset before it can see the low bit that ends it
+            seg.clk_end_edge = std::min( ndx + 3, clk.size() );
+            seg.end_rising = S64( sample );
+            mSegments.push_back( seg );
+
+            // the next one starts at the falling edge before this bit
+            seg.start_sample = clk[ ndx - 1 ];
+            seg.clk_state = BIT_LOW;
+            seg.clk_first_edge = ndx;
+            seg_bits = 0;
+        }
+
+        run = 0;
+    }
+
+    seg.clk_end_edge = clk.size();
+    seg.end_rising = std::numeric_limits<S64>::max();
+    mSegments.push_back( seg );
+}
+
+void RVSWDParallelDecoder::DecodeSegment( Segment& seg )
+{
+    const std::vector<U64>& clk_edges( mCapture.GetCLKEdges() );
+    const std::vector<U64>& dio_edges( mCapture.GetDIOEdges() );
+
+    RVSWDCaptureChannel clk;
+    clk.Setup( clk_edges.data() + seg.clk_first_edge, seg.clk_end_edge - seg.clk_first_edge, seg.clk_state, seg.start_sample );
+
+    RVSWDCaptureChannel dio;
+    if( seg.clk_first_edge == 0 )
+    {
+        mCapture.SetupDIO( dio );
+    }
+    else
+    {
+        size_t dio_ndx = std::upper_bound( dio_edges.begin(), dio_edges.end(), seg.start_sample ) - dio_edges.begin();
+        BitState dio_state = mCapture.GetDIOInitialState();
+        if( dio_ndx & 1 )
+            dio_state = dio_state == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+
+        dio.Setup( dio_edges.data() + dio_ndx, dio_edges.size() - dio_ndx, dio_state, seg.start_sample );
+    }
+
+    RVSWDFrameCollector collector( seg.frames );
+
+    RVSWDParser parser;
+    parser.Setup( &dio, &clk, &collector );
+    parser.Clear();
+
+    RVSWDOperation tran;
+    RVSWDLineReset reset;
+    RVSWDIdle idle;
+
+    seg.stats.Clear();
+
+    try
+    {
+        for( ;; )
+        {
+            // the idle bits follow an operation of this segment, they end before the split
+            if( parser.IsIdle( idle ) )
+            {
+                idle.AddFrames( &collector );
+                seg.stats.AddIdle( idle );
+            }
+            else if( parser.IsOperation( tran ) )
+            {
+                if( tran.bits[ 0 ].rising >= seg.end_rising )
+                    break;
+
+                tran.AddFrames( &collector );
+                seg.stats.AddOperation( tran );
+            }
+            else if( parser.IsLineReset( reset ) )
+            {
+                if( reset.first_bit.rising >= seg.end_rising )
+                    break;
+
+                reset.AddFrames( &collector );
+                seg.stats.AddLineReset( reset );
+            }
+            else
+            {
+                if( parser.HadDataParityError() )
+                    seg.stats.AddParityError();
+                seg.stats.AddDropped( parser.SkipToCandidate() );
+            }
+        }
+    }
+    catch( RVSWDEndOfData& )
+    {
+    }
+}
+
+void RVSWDParallelDecoder::WorkerThread()
+{
+    for( ;; )
+    {
+        size_t ndx = mNextSegment++;
+        if( ndx >= mSegments.size() )
+            return;
+
+        DecodeSegment( mSegments[ ndx ] );
+
+        {
+            std::lock_guard<std::mutex> lock( mMutex );
+            mSegments[ ndx ].done = true;
+        }
+
+        mSegmentDone.notify_all();
+    }
+}
+
+void RVSWDParallelDecoder::Decode( size_t num_threads, RVSWDFrameSink* pSink )
+{
+    num_threads = std::max<size_t>( num_threads, 1 );
+
+    FindSegments( size_t( std::max<U64>( mCapture.GetCLKEdges().size() / 2 / ( num_threads * SEGMENTS_PER_THREAD ), 1 ) ) );
+
+    mNextSegment = 0;
+
+    std::vector<std::thread> threads;
+    for( size_t ndx = 0; ndx < std::min( num_threads, mSegments.size() ); ++ndx )
+        threads.push_back( std::thread( &RVSWDParallelDecoder::WorkerThread, this ) );
+
+    // merge the segments in order, the segments after the first were decoded without
+    // knowing SELECT, so resolve the registers again as the sequential decode would
+    mCaptureStats.Clear();
+    U32 select_reg = 0;
+    for( size_t ndx = 0; ndx < mSegments.size(); ++ndx )
+    {
+        Segment& seg( mSegments[ ndx ] );
+
+        {
+            std::unique_lock<std::mutex> lock( mMutex );
+            while( !seg.done )
+                mSegmentDone.wait( lock );
+        }
+
+        // and so are the operations per register
+        memset( seg.stats.num_reads, 0, sizeof( seg.stats.num_reads ) );
+        memset( seg.stats.num_writes, 0, sizeof( seg.stats.num_writes ) );
+
+        RVSWDRegisters reg = RVSWDR_undefined;
+        bool select_write = false;
+        for( std::vector<Frame>::iterator fi( seg.frames.begin() ); fi != seg.frames.end(); ++fi )
+        {
+            if( fi->mType == RVSWDFT_Request )
+            {
+                RVSWDRequestFrame& req( ( RVSWDRequestFrame& )*fi );
+                reg = GetRegister( req.GetRequestByte(), select_reg );
+                req.SetRegister( reg );
+                req.SetSelect( select_reg );
+                select_write = reg == RVSWDR_DP_SELECT && !req.IsRead();
+
+                ++( req.IsRead() ? seg.stats.num_reads : seg.stats.num_writes )[ reg ];
+            }
+            else if( fi->mType == RVSWDFT_WData )
+            {
+                fi->mData2 = reg;
+                if( select_write )
+                    select_reg = U32( fi->mData1 );
+            }
+
+            pSink->AddFrame( *fi );
+        }
+
+        mCaptureStats.Add( seg.stats );
+
+        // we're done with them
+        std::vector<Frame>().swap( seg.frames );
+    }
+
+    for( size_t ndx = 0; ndx < threads.size(); ++ndx )
+        threads[ ndx ].join();
+}
@@ -0,0 +1,84 @@
+#ifndef RVSWD_PARALLEL_H
+#define RVSWD_PARALLEL_H
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "RVSWDCapture.h"
+#include "RVSWDCaptureStats.h"
+
+// Decodes a capture on several threads, for the headless decoder.
+// The capture is split right after runs of at least MIN_SPLIT_RUN high DIO bits. The
+// sequential decode always ends such a run with a line reset and carries on with the
+// low bit after it, whatever came before, so a segment that starts at that bit decodes
+// exactly like the sequential decode does. The only state that crosses the split is
+// the SELECT register. The registers are resolved again from the request bytes while
+// the segments are merged, using the SELECT value the previous segments left behind.
+class RVSWDParallelDecoder
+{
+  public:
+    enum
+    {
+        MIN_SPLIT_RUN = 96,
+        SEGMENTS_PER_THREAD = 8,
+    };
+
+    RVSWDParallelDecoder( const RVSWDCapture& capture );
+
+    // Decodes the capture with num_threads threads and hands the frames to pSink in
+    // sample order. Markers are not passed on.
+    void Decode( size_t num_threads, RVSWDFrameSink* pSink );
+
+    // the number of bits in the capture, counted like the sequential decode counts them
+    U64 GetNumBits() const
+    {
+        return mNumBits;
+    }
+
+    size_t GetNumSegments() const
+    {
+        return mSegments.size();
+    }
+
+    // the segments' counters added up, once Decode is done
+    const RVSWDCaptureStats& GetCaptureStats() const
+    {
+        return mCaptureStats;
+    }
+
+  protected:
+    struct Segment
+    {
+        // CLK starts at start_sample in clk_state, and then reads the edges from clk_first_edge to clk_end_edge
+        U64 start_sample;
+        BitState clk_state;
+        size_t clk_first_edge;
+        size_t clk_end_edge;
+
+        // the segment ends at the item whose first bit is sampled here, the next segment starts with it
+        S64 end_rising;
+
+        std::vector<Frame> frames;
+        RVSWDCaptureStats stats;
+        bool done;
+    };
+
+    void FindSegments( size_t min_segment_bits );
+    void DecodeSegment( Segment& seg );
+    void WorkerThread();
+
+    const RVSWDCapture& mCapture;
+
+    std::vector<Segment> mSegments;
+    U64 mNumBits;
+    RVSWDCaptureStats mCaptureStats;
+
+    // the workers take the segments in order, and tell the merge when one is done
+    std::atomic<size_t> mNextSegment;
+    std::mutex mMutex;
+    std::condition_variable mSegmentDone;
+};
+
+#endif // RVSWD_PARALLEL_H
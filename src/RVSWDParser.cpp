@@ -0,0 +1,447 @@
+#include <cassert>
+
+#include <algorithm>
+
+#include "RVSWDParser.h"
+#include "RVSWDUtils.h"
+
+// ********************************************************************************
+
+RVSWDBitExtractor::RVSWDBitExtractor() : mDIO( 0 ), mCLK( 0 ), mBitSource( 0 ), mSink( 0 ), mNumBits( 0 ), mNextBit( 0 )
+{
+}
+
+void RVSWDBitExtractor::Setup( RVSWDChannel* pDIO, RVSWDChannel* pCLK, RVSWDFrameSink* pSink )
+{
+    mDIO = pDIO;
+    mCLK = pCLK;
+    mBitSource = 0;
+    mSink = pSink;
+    mNumBits = 0;
+
+    // skip the CLK high
+    if( mCLK->GetBitState() == BIT_HIGH )
+    {
+        mCLK->AdvanceToNextEdge();
+        mDIO->AdvanceToAbsPosition( mCLK->GetSampleNumber() );
+    }
+
+    mLowStart = mCLK->GetSampleNumber();
+
+    mDIOState = mDIO->GetBitState();
+    mDIONextEdgeKnown = false;
+    mFallingEdgeRead = false;
+
+    // go to the first rising edge
+    mCLK->AdvanceToNextEdge();
+    mRisingEdge = mCLK->GetSampleNumber();
+
+    mEdges.reserve( CHUNK_BITS * 2 );
+    mBits.resize( CHUNK_BITS );
+    mBits.clear();
+    mNextBit = 0;
+}
+
+void RVSWDBitExtractor::Setup( RVSWDBitSource* pBitSource )
+{
+    mDIO = 0;
+    mCLK = 0;
+    mBitSource = pBitSource;
+    mSink = 0;
+    mNumBits = 0;
+    mLowStart = 0;
+
+    mBits.resize( CHUNK_BITS );
+    mBits.clear();
+    mNextBit = 0;
+}
+
+BitState RVSWDBitExtractor::SampleDIO( U64 sample )
+{
+    if( !mDIONextEdgeKnown )
+    {
+        // If there are no DIO transitions in the data captured so far, DIO can't change
+        // before sample, because CLK has already been captured up to there.
+        if( !mDIO->DoMoreTransitionsExistInCurrentData() )
+            return mDIOState;
+
+        mDIONextEdge = mDIO->GetSampleOfNextEdge();
+        mDIONextEdgeKnown = true;
+    }
+
+    if( sample < mDIONextEdge )
+        return mDIOState;
+
+    mDIO->AdvanceToAbsPosition( sample );
+    mDIOState = mDIO->GetBitState();
+    mDIONextEdgeKnown = false;
+
+    return mDIOState;
+}
+
+void RVSWDBitExtractor::ReadChunk()
+{
+    if( mBitSource != 0 )
+    {
+        // there's nothing to hand out if the source throws
+        mBits.resize( CHUNK_BITS );
+        mNextBit = CHUNK_BITS;
+
+        mBits.resize( mBitSource->ReadBits( mBits.data(), CHUNK_BITS ) );
+        mNextBit = 0;
+
+        mLowStart = mBits.back().falling;
+        mNumBits += mBits.size();
+        return;
+    }
+
+    // CLK is high at mRisingEdge. For every bit we need its falling edge and the
+    // rising edge of the next bit (where this bit's low period ends).
+    // Always read one bit, which blocks until it's been captured, and then keep
+    // going as long as there are edges in the data that's already available.
+    // If there are none, let the sink commit what it has before we block.
+    if( mSink != 0 && !mCLK->DoMoreTransitionsExistInCurrentData() )
+        mSink->OnStall( mCLK->GetSampleNumber() );
+
+    mEdges.clear();
+    if( !mFallingEdgeRead )
+    {
+        mCLK->AdvanceToNextEdge();
+        mFallingEdge = mCLK->GetSampleNumber();
+    }
+
+    mCLK->AdvanceToNextEdge();
+    mEdges.push_back( mFallingEdge );
+    mEdges.push_back( mCLK->GetSampleNumber() );
+    mFallingEdgeRead = false;
+
+    while( mEdges.size() < CHUNK_BITS * 2 && mCLK->DoMoreTransitionsExistInCurrentData() )
+    {
+        mCLK->AdvanceToNextEdge();
+        mFallingEdge = mCLK->GetSampleNumber();
+
+        // don't wait for the rising edge, leave this bit for the next chunk
+        if( !mCLK->DoMoreTransitionsExistInCurrentData() )
+        {
+            mFallingEdgeRead = true;
+            break;
+        }
+
+        mCLK->AdvanceToNextEdge();
+        mEdges.push_back( mFallingEdge );
+        mEdges.push_back( mCLK->GetSampleNumber() );
+    }
+
+    // sample DIO at all the edges in one sweep
+    mBits.clear();
+    mNextBit = 0;
+    for( size_t ndx = 0; ndx < mEdges.size(); ndx += 2 )
+    {
+        RVSWDBit rbit;
+
+        // sample the rising edge 1 sample before the the actual
+        rbit.low_start = mLowStart;
+        rbit.rising = mRisingEdge - 1;
+        rbit.state_rising = SampleDIO( rbit.rising );
+
+        rbit.falling = mEdges[ ndx ];
+        rbit.state_falling = SampleDIO( rbit.falling );
+
+        rbit.low_end = mEdges[ ndx + 1 ];
+
+        mBits.push_back( rbit );
+
+        mLowStart = rbit.falling;
+        mRisingEdge = rbit.low_end;
+    }
+
+    mNumBits += mBits.size();
+}
+
+// ********************************************************************************
+
+RVSWDParser::RVSWDParser()
+    : mBitsBuffer( MAX_BUFFERED_BITS ), mSelectRegister( 0 ), mNumEmittedBits( 0 ), mIdleNext( false ), mDataParityError( false ), mCountingRun( false ), mRunStart( 0 )
+{
+}
+
+void RVSWDParser::Setup( RVSWDChannel* pDIO, RVSWDChannel* pCLK, RVSWDFrameSink* pSink )
+{
+    mBitExtractor.Setup( pDIO, pCLK, pSink );
+}
+
+void RVSWDParser::Setup( RVSWDBitSource* pBitSource )
+{
+    mBitExtractor.Setup( pBitSource );
+}
+
+void RVSWDParser::BufferBits( size_t num_bits )
+{
+    while( mBitsBuffer.Size() < num_bits )
+        mBitsBuffer.PushBack( ParseBit() );
+}
+
+RVSWDBit RVSWDParser::PopFrontBit()
+{
+    ConsumeEmittedBits();
+
+    assert( !mBitsBuffer.Empty() );
+
+    RVSWDBit ret_val( mBitsBuffer.Front() );
+    mBitsBuffer.PopFront();
+
+    return ret_val;
+}
+
+// returns the number of consecutive high bits starting at ndx, but not more than max_bits
+size_t RVSWDParser::CountHighBits( size_t ndx, size_t max_bits )
+{
+    for( ;; )
+    {
+        size_t low = mBitsBuffer.FindLow( ndx );
+        if( low - ndx >= max_bits )
+            return max_bits;
+
+        if( low < mBitsBuffer.Size() )
+            return low - ndx;
+
+        BufferBits( mBitsBuffer.Size() + 1 );
+    }
+}
+
+size_t RVSWDParser::SkipToCandidate()
+{
+    ConsumeEmittedBits();
+
+    // the first bit has already been rejected by IsOperation and IsLineReset
+    BufferBits( 1 );
+    mBitsBuffer.PopFront();
+    size_t skipped = 1;
+
+    for( ;; )
+    {
+        BufferBits( 8 );
+
+        // Find the request candidates among the buffered bits, up to 57 at a time so that
+        // all 8 bits of every candidate come from one 64 bit read: the start bit must be high,
+        // the stop bit (+6) low and the park bit (+7) high.
+        size_t num_bits = std::min<size_t>( mBitsBuffer.Size() - 7, 57 );
+        U64 bits = mBitsBuffer.GetBits( 0, num_bits + 7 );
+        U64 starts = bits & ~( bits >> 6 ) & ( bits >> 7 ) & ( ( U64( 1 ) << num_bits ) - 1 );
+
+        // the first one that also has a correct parity
+        size_t request = num_bits;
+        for( ; starts != 0; starts &= starts - 1 )
+        {
+            size_t ndx = CountTrailingZeros( starts );
+            if( RequestTable[ U8( bits >> ndx ) ].valid )
+            {
+                request = ndx;
+                break;
+            }
+        }
+
+        // Look for a line reset (50 high bits) starting before the request candidate.
+        // Only the first bit of each run of high bits needs to be checked,
+        // the bits after it in the same run are followed by even fewer high bits.
+        size_t found = request;
+        for( size_t ndx = mBitsBuffer.FindHigh( 0 ); ndx < request; )
+        {
+            size_t run = CountHighBits( ndx, 50 );
+            if( run == 50 )
+            {
+                found = ndx;
+                break;
+            }
+
+            ndx = mBitsBuffer.FindHigh( ndx + run );
+        }
+
+        mBitsBuffer.Consume( found );
+        skipped += found;
+
+        if( found < num_bits )
+            return skipped;
+    }
+}
+
+bool RVSWDParser::IsOperation( RVSWDOperation& tran )
+{
+    ConsumeEmittedBits();
+
+    tran.Clear();
+    mDataParityError = false;
+
+    // read enough bits so that we don't have to worry of subscripts out of range
+    BufferBits( TRAN_REQ_AND_ACK );
+
+    // the request is the first 8 bits, LSB first
+    tran.request_byte = U8( mBitsBuffer.GetBits( 0, 8 ) );
+
+    // are the request's constant bits (start, stop & park) or its parity wrong?
+    const RVSWDRequestInfo& info( RequestTable[ tran.request_byte ] );
+    if( !info.valid )
+        return false;
+
+    tran.APnDP = info.APnDP;
+    tran.RnW = info.RnW;
+    tran.addr = info.addr;
+    tran.parity_read = info.parity;
+
+    // Set the actual register in this operation based on the data from the request
+    // and the previous select register state.
+    tran.SetRegister( mSelectRegister );
+
+    // get the ACK value
+    tran.ACK = U8( mBitsBuffer.GetBits( 9, 3 ) );
+
+    // we're only handling OK, WAIT and FAULT responses
+    if( tran.ACK == ACK_WAIT || tran.ACK == ACK_FAULT )
+    {
+        // give this operation its bits
+        tran.bits = RVSWDBitView( mBitsBuffer, 0, TRAN_REQ_AND_ACK );
+        mNumEmittedBits = TRAN_REQ_AND_ACK;
+
+        return true;
+    }
+
+    if( tran.ACK != ACK_OK )
+        return false;
+
+    BufferBits( TRAN_READ_LENGTH );
+
+    // turnaround if write operation
+    bool read_rising = true;
+    size_t bi = 12;
+    if( !tran.IsRead() )
+    {
+        BufferBits( TRAN_WRITE_LENGTH );
+        ++bi;
+        // !!! read_rising = false;
+    }
+
+    // read the data
+    tran.data = U32( mBitsBuffer.GetBits( bi, 32, read_rising ) );
+
+    // data parity
+    tran.data_parity = mBitsBuffer.IsHigh( bi + 32, read_rising ) ? 1 : 0;
+
+    tran.data_parity_ok = ( tran.data_parity == ( PopCount( tran.data ) & 1 ) );
+
+    if( !tran.data_parity_ok )
+    {
+        mDataParityError = true;
+        return false;
+    }
+
+    // if this is a SELECT register write, remember the value
+    if( tran.reg == RVSWDR_DP_SELECT && !tran.RnW )
+        mSelectRegister = tran.data;
+
+    // give this operation its bits, the low bits after them are the host idling
+    tran.bits = RVSWDBitView( mBitsBuffer, 0, bi + 33 );
+    mNumEmittedBits = bi + 33;
+    mIdleNext = true;
+
+    return true;
+}
+
+bool RVSWDParser::IsIdle( RVSWDIdle& idle )
+{
+    ConsumeEmittedBits();
+
+    idle.Clear();
+
+    // only the low bits right after an operation's data phase are idle bits
+    if( !mIdleNext )
+        return false;
+
+    mIdleNext = false;
+
+    // buffered idle bits
+    size_t idle_end = mBitsBuffer.FindHigh( 0 );
+    if( idle_end > 0 )
+    {
+        idle.first_bit = mBitsBuffer.Front();
+        idle.last_bit = mBitsBuffer.Bit( idle_end - 1 );
+        idle.num_bits = idle_end;
+    }
+
+    if( idle_end < mBitsBuffer.Size() )
+    {
+        mNumEmittedBits = idle_end;
+        return idle_end > 0;
+    }
+
+    // we haven't seen a high bit yet, so count the remaining idle bits without keeping them
+    mRunStart = idle_end > 0 ? mBitsBuffer.Front().low_start : mBitExtractor.GetNextLowStart();
+    mCountingRun = true;
+    mBitsBuffer.Clear();
+
+    RVSWDBit bit;
+    while( true )
+    {
+        bit = ParseBit();
+        if( bit.IsHigh() )
+            break;
+
+        if( idle.num_bits == 0 )
+            idle.first_bit = bit;
+
+        idle.last_bit = bit;
+        ++idle.num_bits;
+    }
+
+    // keep the high bit because that one is probably next operation's start bit
+    mCountingRun = false;
+    mBitsBuffer.PushBack( bit );
+
+    return idle.num_bits > 0;
+}
+
+bool RVSWDParser::IsLineReset( RVSWDLineReset& reset )
+{
+    ConsumeEmittedBits();
+
+    reset.Clear();
+
+    // we need at least 50 bits with a value of 1
+    if( CountHighBits( 0, 50 ) < 50 )
+        return false;
+
+    // the high bits we already have in the buffer
+    size_t num_buffered = mBitsBuffer.FindLow( 0 );
+
+    reset.first_bit = mBitsBuffer.Front();
+    reset.last_bit = mBitsBuffer.Bit( num_buffered - 1 );
+    reset.num_bits = num_buffered;
+
+    if( num_buffered < mBitsBuffer.Size() )
+    {
+        // the low bit after the reset is buffered too, leave it there
+        mBitsBuffer.Consume( num_buffered );
+        return true;
+    }
+
+    // count the rest of the high bits without keeping them
+    mRunStart = mBitsBuffer.Front().low_start;
+    mCountingRun = true;
+    mBitsBuffer.Clear();
+
+    RVSWDBit bit;
+    while( true )
+    {
+        bit = ParseBit();
+        if( !bit.IsHigh() )
+            break;
+
+        reset.last_bit = bit;
+        ++reset.num_bits;
+    }
+
+    // keep the low bit because that one is probably next operation's start bit
+    mCountingRun = false;
+    mBitsBuffer.PushBack( bit );
+
+    return true;
+}
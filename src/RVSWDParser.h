@@ -0,0 +1,234 @@
+#ifndef RVSWD_PARSER_H
+#define RVSWD_PARSER_H
+
+#include "RVSWDTypes.h"
+
+// The parser reads the CLK and DIO edges through this interface. It's modelled on the
+// SDK's AnalyzerChannelData, which the plugin wraps, while the headless decoder
+// implements it over edges loaded from a capture file.
+class RVSWDChannel
+{
+  public:
+    virtual ~RVSWDChannel()
+    {
+    }
+
+    virtual U64 GetSampleNumber() = 0;
+    virtual BitState GetBitState() = 0;
+
+    virtual void AdvanceToNextEdge() = 0;
+    virtual void AdvanceToAbsPosition( U64 sample_number ) = 0;
+    virtual U64 GetSampleOfNextEdge() = 0;
+
+    virtual bool DoMoreTransitionsExistInCurrentData() = 0;
+};
+
+// Thrown by channels that know where their data ends, when the parser asks for more.
+// The SDK's channels never end, they block until more data is captured.
+struct RVSWDEndOfData
+{
+};
+
+// Hands the parser bits that were extracted from the samples some other way than
+// through a pair of channels, like the headless decoder's raw sample kernels.
+class RVSWDBitSource
+{
+  public:
+    virtual ~RVSWDBitSource()
+    {
+    }
+
+    // Fills in up to max_bits bits and returns how many, at least one.
+    // Throws RVSWDEndOfData when there are none left.
+    virtual size_t ReadBits( RVSWDBit* bits, size_t max_bits ) = 0;
+};
+
+// Turns the CLK and DIO channels into RVSWDBit records in batches.
+// CLK edges are pulled in chunks into a local edge array first, then DIO is sampled
+// at all the resulting positions in one forward sweep. DIO's next transition is
+// cached, so DIO is only touched when it actually changes state.
+class RVSWDBitExtractor
+{
+  private:
+    RVSWDChannel* mDIO;
+    RVSWDChannel* mCLK;
+
+    // reads the bits from here instead of the channels if set
+    RVSWDBitSource* mBitSource;
+
+    // gets told before we wait for more data
+    RVSWDFrameSink* mSink;
+
+    // the number of bits extracted so far
+    U64 mNumBits;
+
+    // CLK edges of the current chunk, alternating falling and rising,
+    // starting with the falling edge of the first bit
+    std::vector<U64> mEdges;
+
+    // the extracted bits and the index of the next one to hand out
+    std::vector<RVSWDBit> mBits;
+    size_t mNextBit;
+
+    U64 mLowStart;   // where CLK went low before the next bit's rising edge
+    U64 mRisingEdge; // the next bit's rising edge
+
+    // the falling edge of the next bit, if it has been read but the rising edge after it wasn't available yet
+    U64 mFallingEdge;
+    bool mFallingEdgeRead;
+
+    BitState mDIOState;
+    U64 mDIONextEdge;
+    bool mDIONextEdgeKnown;
+
+    void ReadChunk();
+    BitState SampleDIO( U64 sample );
+
+  public:
+    enum
+    {
+        CHUNK_BITS = 256,
+    };
+
+    RVSWDBitExtractor();
+
+    void Setup( RVSWDChannel* pDIO, RVSWDChannel* pCLK, RVSWDFrameSink* pSink );
+    void Setup( RVSWDBitSource* pBitSource );
+
+    U64 GetNumBits() const
+    {
+        return mNumBits;
+    }
+
+    // where the low period of the next bit NextBit returns starts
+    U64 GetNextLowStart() const
+    {
+        return mNextBit < mBits.size() ? mBits[ mNextBit ].low_start : mLowStart;
+    }
+
+    const RVSWDBit& NextBit()
+    {
+        if( mNextBit == mBits.size() )
+            ReadChunk();
+
+        return mBits[ mNextBit++ ];
+    }
+};
+
+// This object parses and buffers the bits of the SWD stream.
+// IsOperation and IsLineReset return true if the subsequent bits in
+// the stream are a valid operation or line reset. The bits of the returned
+// operation or line reset stay in the parser until the next call.
+class RVSWDParser
+{
+  public:
+    enum
+    {
+        // The most bits the parser ever buffers, so the bit buffer never grows.
+        // SkipToCandidate looks furthest ahead: it checks for line resets starting
+        // before a request candidate up to 57 bits in, which takes those 50 high bits
+        // and the bit after them.
+        MAX_BUFFERED_BITS = 57 + 50 + 1,
+    };
+
+  private:
+    RVSWDBitExtractor mBitExtractor;
+
+    RVSWDBitWindow mBitsBuffer;
+    U32 mSelectRegister;
+
+    // the bits at the front of mBitsBuffer that belong to the operation or line reset
+    // we returned last, they're consumed on the next call into the parser
+    size_t mNumEmittedBits;
+
+    // the last operation had a data phase, so the low bits after it are idle bits
+    bool mIdleNext;
+
+    // the last IsOperation call turned down a request with an OK ACK for its data parity
+    bool mDataParityError;
+
+    // IsIdle or IsLineReset is counting a run of bits that have left the buffer,
+    // the run's first bit started its low period at mRunStart
+    bool mCountingRun;
+    U64 mRunStart;
+
+    void ConsumeEmittedBits()
+    {
+        mBitsBuffer.Consume( mNumEmittedBits );
+        mNumEmittedBits = 0;
+    }
+
+    RVSWDBit ParseBit()
+    {
+        return mBitExtractor.NextBit();
+    }
+
+    void BufferBits( size_t num_bits );
+    size_t CountHighBits( size_t ndx, size_t max_bits );
+
+  public:
+    RVSWDParser();
+
+    void Setup( RVSWDChannel* pDIO, RVSWDChannel* pCLK, RVSWDFrameSink* pSink );
+    void Setup( RVSWDBitSource* pBitSource );
+
+    void Clear()
+    {
+        mBitsBuffer.Clear();
+        mSelectRegister = 0;
+        mNumEmittedBits = 0;
+        mIdleNext = false;
+        mDataParityError = false;
+        mCountingRun = false;
+    }
+
+    bool IsOperation( RVSWDOperation& tran );
+    bool IsLineReset( RVSWDLineReset& reset );
+
+    // True if the last IsOperation call returned false only because of the data parity.
+    // The operation's bits are dropped with the rest, this is how they're counted.
+    bool HadDataParityError() const
+    {
+        return mDataParityError;
+    }
+
+    // Returns the idle bits after the operation IsOperation returned last. Try this
+    // first, it returns false right away if the last item wasn't an operation with a data phase.
+    bool IsIdle( RVSWDIdle& idle );
+
+    RVSWDBit PopFrontBit();
+
+    // Drops the first bit and then every following bit that can't be the start of
+    // an operation or a line reset. Returns the number of dropped bits.
+    size_t SkipToCandidate();
+
+    // the number of bits read from the channels so far
+    U64 GetNumBits() const
+    {
+        return mBitExtractor.GetNumBits();
+    }
+
+    // the most bits that were buffered at once so far, never more than MAX_BUFFERED_BITS
+    size_t GetMaxBufferedBits() const
+    {
+        return mBitsBuffer.MaxSize();
+    }
+
+    // true if bits that aren't part of a returned item are buffered,
+    // or an idle period or line reset is being counted
+    bool HasPendingBits() const
+    {
+        return mCountingRun || mBitsBuffer.Size() > mNumEmittedBits;
+    }
+
+    // the earliest sample the frames of the items that haven't been returned yet can start at
+    U64 GetPendingStart() const
+    {
+        if( mCountingRun )
+            return mRunStart;
+
+        return mBitsBuffer.Size() > mNumEmittedBits ? mBitsBuffer.Bit( mNumEmittedBits ).low_start : mBitExtractor.GetNextLowStart();
+    }
+};
+
+#endif // RVSWD_PARSER_H
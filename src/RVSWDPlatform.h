@@ -0,0 +1,65 @@
+#ifndef RVSWD_PLATFORM_H
+#define RVSWD_PLATFORM_H
+
+// The decoder core (RVSWDTypes and RVSWDParser) only needs the SDK's basic types
+// and the Frame class. With RVSWD_HEADLESS defined they are declared here instead,
+// so the core can be built and run without the Analyzer SDK.
+
+#ifdef RVSWD_HEADLESS
+
+typedef signed char S8;
+typedef short S16;
+typedef int S32;
+typedef long long int S64;
+
+typedef unsigned char U8;
+typedef unsigned short U16;
+typedef unsigned int U32;
+typedef unsigned long long int U64;
+
+enum DisplayBase
+{
+    Binary,
+    Decimal,
+    Hexadecimal,
+    ASCII,
+    AsciiHex
+};
+
+enum BitState
+{
+    BIT_LOW,
+    BIT_HIGH
+};
+
+#define DISPLAY_AS_ERROR_FLAG ( 1 << 7 )
+#define DISPLAY_AS_WARNING_FLAG ( 1 << 6 )
+
+class Frame
+{
+  public:
+    Frame() : mStartingSampleInclusive( 0 ), mEndingSampleInclusive( 0 ), mData1( 0 ), mData2( 0 ), mType( 0 ), mFlags( 0 )
+    {
+    }
+
+    bool HasFlag( U8 flag ) const
+    {
+        return ( mFlags & flag ) != 0;
+    }
+
+    S64 mStartingSampleInclusive;
+    S64 mEndingSampleInclusive;
+    U64 mData1;
+    U64 mData2;
+    U8 mType;
+    U8 mFlags;
+};
+
+#else
+
+#include <LogicPublicTypes.h>
+#include <AnalyzerResults.h>
+
+#endif
+
+#endif // RVSWD_PLATFORM_H
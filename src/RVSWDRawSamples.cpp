@@ -0,0 +1,316 @@
+#include <cstdio>
+#include <chrono>
+#include <algorithm>
+
+#include "RVSWDRawSamples.h"
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define RVSWD_X86_KERNELS
+#define RVSWD_TARGET( isa ) __attribute__( ( target( isa ) ) )
+#include <immintrin.h>
+#elif defined( _MSC_VER ) && defined( _M_X64 )
+#define RVSWD_X86_KERNELS
+#define RVSWD_TARGET( isa )
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static inline U32 CountTrailingZeros( U32 bits )
+{
+#if defined( _MSC_VER )
+    unsigned long ndx;
+    _BitScanForward( &ndx, bits );
+    return U32( ndx );
+#else
+    return U32( __builtin_ctz( bits ) );
+#endif
+}
+
+static size_t ScanEdgesScalar( const U8* samples, size_t pos, size_t end, U8 dio_mask, U8 clk_mask, RVSWDRawEdge* edges, size_t max_edges,
+                               size_t& num_edges )
+{
+    for( ; pos < end && num_edges < max_edges; ++pos )
+    {
+        if( ( ( samples[ pos ] ^ samples[ pos - 1 ] ) & clk_mask ) == 0 )
+            continue;
+
+        RVSWDRawEdge& edge = edges[ num_edges++ ];
+        edge.sample_number = pos;
+        edge.dio_before = ( samples[ pos - 1 ] & dio_mask ) ? BIT_HIGH : BIT_LOW;
+        edge.dio_at = ( samples[ pos ] & dio_mask ) ? BIT_HIGH : BIT_LOW;
+    }
+
+    return pos;
+}
+
+// Stores the edges of a block of samples starting at pos, given bit masks of the samples
+// where CLK changed and of DIO's states. Returns false if the edges ran out, with pos
+// moved to the edge that didn't fit.
+static inline bool StoreEdges( U32 changed, U32 dio_before, U32 dio_at, size_t& pos, RVSWDRawEdge* edges, size_t max_edges, size_t& num_edges )
+{
+    while( changed != 0 )
+    {
+        U32 bit = CountTrailingZeros( changed );
+        if( num_edges == max_edges )
+        {
+            pos += bit;
+            return false;
+        }
+
+        RVSWDRawEdge& edge = edges[ num_edges++ ];
+        edge.sample_number = pos + bit;
+        edge.dio_before = ( ( dio_before >> bit ) & 1 ) ? BIT_HIGH : BIT_LOW;
+        edge.dio_at = ( ( dio_at >> bit ) & 1 ) ? BIT_HIGH : BIT_LOW;
+
+        changed &= changed - 1;
+    }
+
+    return true;
+}
+
+#ifdef RVSWD_X86_KERNELS
+
+RVSWD_TARGET( "sse2" )
+static size_t ScanEdgesSSE2( const U8* samples, size_t pos, size_t end, U8 dio_mask, U8 clk_mask, RVSWDRawEdge* edges, size_t max_edges,
+                             size_t& num_edges )
+{
+    const __m128i dio = _mm_set1_epi8( char( dio_mask ) );
+    const __m128i clk = _mm_set1_epi8( char( clk_mask ) );
+    const __m128i zero = _mm_setzero_si128();
+
+    for( ; pos + 16 <= end; pos += 16 )
+    {
+        __m128i cur = _mm_loadu_si128( ( const __m128i* )( samples + pos ) );
+        __m128i prev = _mm_loadu_si128( ( const __m128i* )( samples + pos - 1 ) );
+
+        U32 changed = ~U32( _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_and_si128( _mm_xor_si128( cur, prev ), clk ), zero ) ) ) & 0xffff;
+        if( changed == 0 )
+            continue;
+
+        U32 dio_before = U32( _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_and_si128( prev, dio ), dio ) ) );
+        U32 dio_at = U32( _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_and_si128( cur, dio ), dio ) ) );
+        if( !StoreEdges( changed, dio_before, dio_at, pos, edges, max_edges, num_edges ) )
+            return pos;
+    }
+
+    return ScanEdgesScalar( samples, pos, end, dio_mask, clk_mask, edges, max_edges, num_edges );
+}
+
+RVSWD_TARGET( "avx2" )
+static size_t ScanEdgesAVX2( const U8* samples, size_t pos, size_t end, U8 dio_mask, U8 clk_mask, RVSWDRawEdge* edges, size_t max_edges,
+                             size_t& num_edges )
+{
+    const __m256i dio = _mm256_set1_epi8( char( dio_mask ) );
+    const __m256i clk = _mm256_set1_epi8( char( clk_mask ) );
+    const __m256i zero = _mm256_setzero_si256();
+
+    for( ; pos + 32 <= end; pos += 32 )
+    {
+        __m256i cur = _mm256_loadu_si256( ( const __m256i* )( samples + pos ) );
+        __m256i prev = _mm256_loadu_si256( ( const __m256i* )( samples + pos - 1 ) );
+
+        U32 changed = ~U32( _mm256_movemask_epi8( _mm256_cmpeq_epi8( _mm256_and_si256( _mm256_xor_si256( cur, prev ), clk ), zero ) ) );
+        if( changed == 0 )
+            continue;
+
+        U32 dio_before = U32( _mm256_movemask_epi8( _mm256_cmpeq_epi8( _mm256_and_si256( prev, dio ), dio ) ) );
+        U32 dio_at = U32( _mm256_movemask_epi8( _mm256_cmpeq_epi8( _mm256_and_si256( cur, dio ), dio ) ) );
+        if( !StoreEdges( changed, dio_before, dio_at, pos, edges, max_edges, num_edges ) )
+            return pos;
+    }
+
+    return ScanEdgesScalar( samples, pos, end, dio_mask, clk_mask, edges, max_edges, num_edges );
+}
+
+static bool CPUHasAVX2()
+{
+#if defined( _MSC_VER )
+    int info[ 4 ];
+    __cpuid( info, 1 );
+
+    // the OS has to save the AVX registers too
+    bool os_saves_avx = ( info[ 2 ] & ( 1 << 27 ) ) != 0 && ( info[ 2 ] & ( 1 << 28 ) ) != 0 && ( _xgetbv( 0 ) & 6 ) == 6;
+    if( !os_saves_avx )
+        return false;
+
+    __cpuidex( info, 7, 0 );
+    return ( info[ 1 ] & ( 1 << 5 ) ) != 0;
+#else
+    return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+}
+
+static bool CPUHasSSE2()
+{
+#if defined( _MSC_VER )
+    return true;
+#else
+    return __builtin_cpu_supports( "sse2" ) != 0;
+#endif
+}
+
+#endif // RVSWD_X86_KERNELS
+
+RVSWDRawKernel GetBestRawKernel()
+{
+    for( int kernel = NUM_RAW_KERNELS - 1; kernel > RAW_KERNEL_SCALAR; --kernel )
+    {
+        if( GetEdgeScanner( RVSWDRawKernel( kernel ) ) != 0 )
+            return RVSWDRawKernel( kernel );
+    }
+
+    return RAW_KERNEL_SCALAR;
+}
+
+RVSWDEdgeScanner GetEdgeScanner( RVSWDRawKernel kernel )
+{
+    switch( kernel )
+    {
+    case RAW_KERNEL_SCALAR:
+        return ScanEdgesScalar;
+#ifdef RVSWD_X86_KERNELS
+    case RAW_KERNEL_SSE2:
+        return CPUHasSSE2() ? ScanEdgesSSE2 : 0;
+    case RAW_KERNEL_AVX2:
+        return CPUHasAVX2() ? ScanEdgesAVX2 : 0;
+#endif
+    default:
+        return 0;
+    }
+}
+
+const char* GetRawKernelName( RVSWDRawKernel kernel )
+{
+    static const char* names[] = { "scalar", "sse2", "avx2" };
+    return kernel < NUM_RAW_KERNELS ? names[ kernel ] : "?";
+}
+
+// ********************************************************************************
+
+RVSWDRawBitSource::RVSWDRawBitSource()
+    : mSamples( 0 ), mNumSamples( 0 ), mDIOMask( 0 ), mCLKMask( 0 ), mScanner( 0 ), mPos( 0 ), mScanSeconds( 0 ), mNumEdges( 0 ), mNextEdge( 0 ),
+      mStarted( false ), mLowStart( 0 )
+{
+}
+
+void RVSWDRawBitSource::Setup( const U8* samples, size_t num_samples, U32 dio_channel, U32 clk_channel, RVSWDEdgeScanner scanner )
+{
+    mSamples = samples;
+    mNumSamples = num_samples;
+    mDIOMask = U8( 1 << dio_channel );
+    mCLKMask = U8( 1 << clk_channel );
+    mScanner = scanner;
+
+    // the scan compares every sample with the one before
+    mPos = num_samples > 0 ? 1 : 0;
+    mScanSeconds = 0;
+
+    mEdges.resize( EDGE_BUFFER_SIZE );
+    mNumEdges = 0;
+    mNextEdge = 0;
+
+    mStarted = false;
+    mLowStart = 0;
+}
+
+bool RVSWDRawBitSource::HasEdges( size_t num_edges )
+{
+    while( mNumEdges - mNextEdge < num_edges )
+    {
+        if( mPos >= mNumSamples )
+            return false;
+
+        // keep the edges we haven't used and fill the rest of the buffer
+        std::copy( mEdges.begin() + mNextEdge, mEdges.begin() + mNumEdges, mEdges.begin() );
+        mNumEdges -= mNextEdge;
+        mNextEdge = 0;
+
+        std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+        mPos = mScanner( mSamples, mPos, mNumSamples, mDIOMask, mCLKMask, mEdges.data(), mEdges.size(), mNumEdges );
+        mScanSeconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    }
+
+    return true;
+}
+
+size_t RVSWDRawBitSource::ReadBits( RVSWDBit* bits, size_t max_bits )
+{
+    // the same as RVSWDBitExtractor: skip the CLK high, and start at the first rising edge
+    if( !mStarted )
+    {
+        if( mSamples[ 0 ] & mCLKMask )
+        {
+            if( !HasEdges( 1 ) )
+                throw RVSWDEndOfData();
+
+            mLowStart = mEdges[ mNextEdge++ ].sample_number;
+        }
+
+        if( !HasEdges( 1 ) )
+            throw RVSWDEndOfData();
+
+        mRisingEdge = mEdges[ mNextEdge++ ];
+        mStarted = true;
+    }
+
+    // every bit takes its falling edge and the next bit's rising edge
+    size_t num_bits = 0;
+    while( num_bits < max_bits && HasEdges( 2 ) )
+    {
+        const RVSWDRawEdge& falling = mEdges[ mNextEdge ];
+        const RVSWDRawEdge& low_end = mEdges[ mNextEdge + 1 ];
+
+        RVSWDBit& rbit = bits[ num_bits++ ];
+        rbit.low_start = mLowStart;
+        rbit.rising = S64( mRisingEdge.sample_number ) - 1;
+        rbit.state_rising = mRisingEdge.dio_before;
+        rbit.falling = S64( falling.sample_number );
+        rbit.state_falling = falling.dio_at;
+        rbit.low_end = S64( low_end.sample_number );
+
+        mLowStart = rbit.falling;
+        mRisingEdge = low_end;
+        mNextEdge += 2;
+    }
+
+    if( num_bits == 0 )
+        throw RVSWDEndOfData();
+
+    return num_bits;
+}
+
+// ********************************************************************************
+
+bool LoadRawSamples( const char* file_name, std::vector<U8>& samples, std::string& error )
+{
+    FILE* f = fopen( file_name, "rb" );
+    if( f == NULL )
+    {
+        error = std::string( "can't open " ) + file_name;
+        return false;
+    }
+
+    samples.clear();
+
+    U8 buffer[ 1 << 16 ];
+    size_t num_read;
+    while( ( num_read = fread( buffer, 1, sizeof( buffer ), f ) ) > 0 )
+        samples.insert( samples.end(), buffer, buffer + num_read );
+
+    bool read_error = ferror( f ) != 0;
+    fclose( f );
+
+    if( read_error )
+    {
+        error = std::string( "can't read " ) + file_name;
+        return false;
+    }
+
+    if( samples.empty() )
+    {
+        error = std::string( file_name ) + " is empty";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef RVSWD_RAW_SAMPLES_H
+#define RVSWD_RAW_SAMPLES_H
+
+#include <vector>
+#include <string>
+
+#include "RVSWDParser.h"
+
+// A CLK edge found in raw samples, with DIO in the sample before it and in its own
+struct RVSWDRawEdge
+{
+    U64 sample_number;
+    BitState dio_before;
+    BitState dio_at;
+};
+
+// The kernels that scan raw samples for CLK edges. They all find the same edges,
+// the vector ones look at 16 or 32 samples at a time.
+enum RVSWDRawKernel
+{
+    RAW_KERNEL_SCALAR,
+    RAW_KERNEL_SSE2,
+    RAW_KERNEL_AVX2,
+
+    NUM_RAW_KERNELS
+};
+
+// Scans samples[ pos ] up to samples[ end ] for the samples where CLK differs from the one
+// before, pos must be at least 1. Stores at most max_edges edges and returns the position
+// the scan got to, which is end unless the edges ran out.
+typedef size_t ( *RVSWDEdgeScanner )( const U8* samples, size_t pos, size_t end, U8 dio_mask, U8 clk_mask, RVSWDRawEdge* edges,
+                                      size_t max_edges, size_t& num_edges );
+
+// the fastest kernel this CPU runs
+RVSWDRawKernel GetBestRawKernel();
+
+// returns 0 if the CPU doesn't run the kernel
+RVSWDEdgeScanner GetEdgeScanner( RVSWDRawKernel kernel );
+
+const char* GetRawKernelName( RVSWDRawKernel kernel );
+
+// A capture of raw samples, one byte per sample, with a channel in every bit.
+// Turns the samples straight into the parser's bits, without going through the edges
+// of the channels.
+class RVSWDRawBitSource : public RVSWDBitSource
+{
+  public:
+    enum
+    {
+        EDGE_BUFFER_SIZE = 4096,
+    };
+
+    RVSWDRawBitSource();
+
+    // samples stay owned by the caller, dio_channel and clk_channel are bit numbers
+    void Setup( const U8* samples, size_t num_samples, U32 dio_channel, U32 clk_channel, RVSWDEdgeScanner scanner );
+
+    virtual size_t ReadBits( RVSWDBit* bits, size_t max_bits );
+
+    // the samples scanned, and the time spent in the kernel
+    U64 GetNumScanned() const
+    {
+        return mPos;
+    }
+
+    double GetScanSeconds() const
+    {
+        return mScanSeconds;
+    }
+
+  protected:
+    bool HasEdges( size_t num_edges );
+
+    const U8* mSamples;
+    size_t mNumSamples;
+    U8 mDIOMask;
+    U8 mCLKMask;
+    RVSWDEdgeScanner mScanner;
+
+    // the samples are scanned up to here
+    size_t mPos;
+    double mScanSeconds;
+
+    // the edges from mNextEdge to mNumEdges haven't been made into bits yet
+    std::vector<RVSWDRawEdge> mEdges;
+    size_t mNumEdges;
+    size_t mNextEdge;
+
+    bool mStarted;
+    S64 mLowStart;
+    RVSWDRawEdge mRisingEdge;
+};
+
+// Loads a file of raw samples, one byte per sample.
+bool LoadRawSamples( const char* file_name, std::vector<U8>& samples, std::string& error );
+
+#endif // RVSWD_RAW_SAMPLES_H
@@ -773,8 +773,8 @@ void RVSWDSimulationDataGenerator::Initialize( U32 simulation_sample_rate, RVSWD
 
     mClockGenerator.Init( simulation_sample_rate / 10, simulation_sample_rate );
 
-    mDIO = mRVSWDSimulationChannels.Add( settings->mDIO, mSimulationSampleRateHz, BIT_LOW );
-    mCLK = mRVSWDSimulationChannels.Add( settings->mCLK, mSimulationSampleRateHz, BIT_LOW );
+    mDIO = mRVSWDSimulationChannels.Add( settings->mDIO[ 0 ], mSimulationSampleRateHz, BIT_LOW );
+    mCLK = mRVSWDSimulationChannels.Add( settings->mCLK[ 0 ], mSimulationSampleRateHz, BIT_LOW );
 
     // start from the end to force a line reset in GenerateSimulationData
     mSimulCnt = sizeof( simul_data ) / sizeof( SimulationData ) - 1;
@@ -0,0 +1,46 @@
+#include "RVSWDTextCache.h"
+
+RVSWDTextCache::RVSWDTextCache() : mNumHits( 0 ), mNumMisses( 0 )
+{
+    mEntries.resize( NUM_ENTRIES );
+    Clear();
+}
+
+void RVSWDTextCache::Clear()
+{
+    for( std::vector<Entry>::iterator ei( mEntries.begin() ); ei != mEntries.end(); ++ei )
+    {
+        ei->valid = false;
+        ei->has_bubbles = false;
+        ei->has_tabular = false;
+    }
+}
+
+RVSWDTextCache::Entry& RVSWDTextCache::Find( const Frame& f, DisplayBase display_base )
+{
+    // mixes the key's bits into the low bits
+    U64 hash = f.mData1 * 0x9E3779B97F4A7C15ull;
+    hash ^= ( f.mData2 + ( U64( f.mType ) << 8 | f.mFlags ) + ( U64( display_base ) << 16 ) ) * 0xC2B2AE3D27D4EB4Full;
+    hash ^= hash >> 29;
+
+    Entry& entry( mEntries[ hash & ( NUM_ENTRIES - 1 ) ] );
+    if( entry.valid && entry.type == f.mType && entry.flags == f.mFlags && entry.display_base == display_base && entry.data1 == f.mData1 &&
+        entry.data2 == f.mData2 )
+    {
+        ++mNumHits;
+        return entry;
+    }
+
+    ++mNumMisses;
+
+    entry.valid = true;
+    entry.type = f.mType;
+    entry.flags = f.mFlags;
+    entry.display_base = display_base;
+    entry.data1 = f.mData1;
+    entry.data2 = f.mData2;
+    entry.has_bubbles = false;
+    entry.has_tabular = false;
+
+    return entry;
+}
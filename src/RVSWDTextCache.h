@@ -0,0 +1,65 @@
+#ifndef RVSWD_TEXT_CACHE_H
+#define RVSWD_TEXT_CACHE_H
+
+#include <string>
+#include <vector>
+
+#include <AnalyzerTypes.h>
+#include <AnalyzerResults.h>
+
+// A bounded cache of the bubble and tabular texts of the frames. The texts only depend on
+// the frame's type, data and flags and on the display base, so the frames that repeat the
+// same values, like polled status words, are formatted once. It's direct mapped, a key
+// has one entry it can go in and replaces whatever was there, so finding it is a hash
+// and a compare. The entries keep their strings, and reuse them for the next key.
+class RVSWDTextCache
+{
+  public:
+    enum
+    {
+        NUM_ENTRIES = 4096, // a power of 2
+    };
+
+    struct Entry
+    {
+        // the key
+        bool valid;
+        U8 type;
+        U8 flags;
+        DisplayBase display_base;
+        U64 data1;
+        U64 data2;
+
+        bool has_bubbles;
+        std::vector<std::string> bubbles;
+
+        bool has_tabular;
+        std::string tabular;
+    };
+
+    RVSWDTextCache();
+
+    // The frame's entry. If it held another frame's texts it's emptied, and the texts are
+    // for the caller to make.
+    Entry& Find( const Frame& f, DisplayBase display_base );
+
+    void Clear();
+
+    U64 GetNumHits() const
+    {
+        return mNumHits;
+    }
+
+    U64 GetNumMisses() const
+    {
+        return mNumMisses;
+    }
+
+  protected:
+    std::vector<Entry> mEntries;
+
+    U64 mNumHits;
+    U64 mNumMisses;
+};
+
+#endif // RVSWD_TEXT_CACHE_H
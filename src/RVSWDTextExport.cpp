@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <cstring>
+
+#include "RVSWDTextExport.h"
+#include "RVSWDUtils.h"
+
+const char* RVSWDTextFormat::GetHeader() const
+{
+    return multi_bus ? "Time\tBus\tType\tR/W\tAP/DP\tRegister\tRequest byte\tACK\tWData\tWData details\n"
+                     : "Time\tType\tR/W\tAP/DP\tRegister\tRequest byte\tACK\tWData\tWData details\n";
+}
+
+const char* GetACKName( U64 ack )
+{
+    if( ack == ACK_OK )
+        return "OK";
+    else if( ack == ACK_WAIT )
+        return "WAIT";
+    else if( ack == ACK_FAULT )
+        return "FAULT";
+
+    return "<disc>";
+}
+
+size_t FormatSampleTime( S64 sample, U64 trigger_sample, U32 sample_rate, char* time_str )
+{
+    // AnalyzerHelpers::GetTimeString writes the seconds with 15 decimals, like %.15f, and the
+    // last 7 are cut off, which leaves the time to 10 ns
+    int len = snprintf( time_str, TIME_STR_SIZE, "%.15f", ( sample - S64( trigger_sample ) ) / double( sample_rate ) );
+    if( len < 0 || len >= TIME_STR_SIZE )
+        len = int( strlen( time_str ) );
+
+    if( len > 7 )
+        len -= 7;
+    time_str[ len ] = '\0';
+
+    return size_t( len );
+}
+
+// appends a field to the record's line, after a tab if it isn't the first
+static void AddField( std::string& text, size_t& num_fields, const char* field, size_t len )
+{
+    if( num_fields++ != 0 )
+        text += '\t';
+
+    text.append( field, len );
+}
+
+static void AddField( std::string& text, size_t& num_fields, const char* field )
+{
+    AddField( text, num_fields, field, strlen( field ) );
+}
+
+static void AddNumberField( std::string& text, size_t& num_fields, U64 val, DisplayBase display_base, int num_bits )
+{
+    char number_str[ 256 ];
+    AddField( text, num_fields, number_str, FormatNumber( val, display_base, num_bits, number_str, sizeof( number_str ) ) );
+}
+
+// the start of a line reset or an operation, its time and bus
+static void AddStartFields( const Frame& f, U32 bus, const RVSWDTextFormat& fmt, std::string& text, size_t& num_fields )
+{
+    char time_str[ TIME_STR_SIZE ];
+    AddField( text, num_fields, time_str, FormatSampleTime( f.mStartingSampleInclusive, fmt.trigger_sample, fmt.sample_rate, time_str ) );
+
+    if( fmt.multi_bus )
+        AddNumberField( text, num_fields, bus + 1, Decimal, 64 );
+}
+
+void FormatTextRecord( const Frame* frames, size_t num_frames, U32 bus, const RVSWDTextFormat& fmt, std::string& text )
+{
+    size_t num_fields = 0;
+    for( const Frame* fi( frames ); fi != frames + num_frames; ++fi )
+    {
+        const Frame& f( *fi );
+
+        if( f.mType == RVSWDFT_LineReset )
+        {
+            AddStartFields( f, bus, fmt, text, num_fields );
+            AddField( text, num_fields, "Line reset" );
+        }
+        else if( f.mType == RVSWDFT_Request )
+        {
+            const RVSWDRequestFrame& req( ( const RVSWDRequestFrame& )f );
+            AddStartFields( f, bus, fmt, text, num_fields );
+            AddField( text, num_fields, "Operation" );
+            AddField( text, num_fields, req.IsRead() ? "read" : "write" );
+            AddField( text, num_fields, req.IsAccessPort() ? "AccessPort" : "DebugPort" );
+            AddField( text, num_fields, req.GetRegisterName() );
+            AddNumberField( text, num_fields, req.GetRequestByte(), fmt.display_base, 8 );
+        }
+        else if( f.mType == RVSWDFT_ACK )
+        {
+            AddField( text, num_fields, GetACKName( f.mData1 ) );
+        }
+        else if( f.mType == RVSWDFT_WData )
+        {
+            AddNumberField( text, num_fields, f.mData1, fmt.display_base, 32 );
+
+            char reg_value[ REGISTER_DESC_SIZE ];
+            size_t len =
+                FormatRegisterValue( RVSWDRegisters( f.mData2 ), U32( f.mData1 ), fmt.display_base, reg_value, sizeof( reg_value ) );
+            AddField( text, num_fields, reg_value, len );
+        }
+    }
+
+    if( num_fields == 0 )
+        return;
+
+    if( num_fields < fmt.GetNumFields() )
+        text.append( fmt.GetNumFields() - num_fields, '\t' );
+
+    text += '\n';
+}
+
+void FormatTextChunk( RVSWDExportPipeline::Chunk& chunk, const RVSWDTextFormat& fmt )
+{
+    for( std::vector<RVSWDExportPipeline::Record>::const_iterator ri( chunk.records.begin() ); ri != chunk.records.end(); ++ri )
+        FormatTextRecord( &chunk.frames[ ri->first_frame ], ri->num_frames, ri->bus, fmt, chunk.text );
+}
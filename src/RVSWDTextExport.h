@@ -0,0 +1,48 @@
+#ifndef RVSWD_TEXT_EXPORT_H
+#define RVSWD_TEXT_EXPORT_H
+
+#include <string>
+
+#include "RVSWDTypes.h"
+#include "RVSWDExportPipeline.h"
+
+// The text export is a header, then a tab separated line for each line reset and operation,
+// written from the frames of its record. The plugin's export and rvswd_decode both format
+// their lines with these, so the two files are the same for the same capture.
+enum
+{
+    TEXT_EXPORT_FIELDS = 9, // without the bus column
+    TIME_STR_SIZE = 64,     // a time in seconds, as FormatSampleTime writes it
+};
+
+// the layout of the records, the same for all the frames of an export
+struct RVSWDTextFormat
+{
+    DisplayBase display_base;
+    U64 trigger_sample;
+    U32 sample_rate;
+    bool multi_bus; // a bus column follows the time
+
+    size_t GetNumFields() const
+    {
+        return multi_bus ? TEXT_EXPORT_FIELDS + 1 : TEXT_EXPORT_FIELDS;
+    }
+
+    const char* GetHeader() const;
+};
+
+// the ACK as the export and the packets show it
+const char* GetACKName( U64 ack );
+
+// Writes the time of the sample relative to the trigger, the way the export shows it, and
+// returns its length. It doesn't call into the SDK, for the export's threads.
+size_t FormatSampleTime( S64 sample, U64 trigger_sample, U32 sample_rate, char* time_str );
+
+// The frames of a record are a line reset, or an operation's request, ACK and data. Its line
+// is appended to text, padded with empty fields.
+void FormatTextRecord( const Frame* frames, size_t num_frames, U32 bus, const RVSWDTextFormat& fmt, std::string& text );
+
+// formats the records of a chunk into its text
+void FormatTextChunk( RVSWDExportPipeline::Chunk& chunk, const RVSWDTextFormat& fmt );
+
+#endif // RVSWD_TEXT_EXPORT_H
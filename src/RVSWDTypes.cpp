@@ -1,18 +1,90 @@
 #include <cassert>
 
 #include <algorithm>
-#include <iterator>
 
-#include <AnalyzerChannelData.h>
-#include <AnalyzerHelpers.h>
-
-#include "RVSWDAnalyzer.h"
 #include "RVSWDTypes.h"
 #include "RVSWDUtils.h"
 
-const int TRAN_REQ_AND_ACK = 8 + 1 + 3;             // request/turnaround/ACK
-const int TRAN_READ_LENGTH = TRAN_REQ_AND_ACK + 33; // previous + 32bit data + parity
-const int TRAN_WRITE_LENGTH = TRAN_READ_LENGTH + 1; // previous + one bit for turnaround
+// ********************************************************************************
+
+// The request and register decode tables are generated at compile time by expanding
+// a constexpr function over every index of the table.
+#define TABLE4( f, n ) f( n ), f( n + 1 ), f( n + 2 ), f( n + 3 )
+#define TABLE16( f, n ) TABLE4( f, n ), TABLE4( f, n + 4 ), TABLE4( f, n + 8 ), TABLE4( f, n + 12 )
+#define TABLE64( f, n ) TABLE16( f, n ), TABLE16( f, n + 16 ), TABLE16( f, n + 32 ), TABLE16( f, n + 48 )
+#define TABLE256( f, n ) TABLE64( f, n ), TABLE64( f, n + 64 ), TABLE64( f, n + 128 ), TABLE64( f, n + 192 )
+
+// Request byte, LSB first: start(1) APnDP RnW A2 A3 parity stop(0) park(1)
+constexpr bool RequestParityOk( int req )
+{
+    return ( ( ( req >> 1 ) ^ ( req >> 2 ) ^ ( req >> 3 ) ^ ( req >> 4 ) ^ ( req >> 5 ) ) & 1 ) == 0;
+}
+
+constexpr RVSWDRequestInfo MakeRequestInfo( int req )
+{
+    return RVSWDRequestInfo{ ( req & 0xC1 ) == 0x81 && RequestParityOk( req ), ( req & 0x02 ) != 0, ( req & 0x04 ) != 0,
+                             U8( ( req & 0x18 ) >> 1 ), U8( ( req >> 5 ) & 1 ) };
+}
+
+extern constexpr RVSWDRequestInfo RequestTable[ 256 ] = { TABLE256( MakeRequestInfo, 0 ) };
+
+static_assert( RequestTable[ 0xA5 ].valid && !RequestTable[ 0xA5 ].APnDP && RequestTable[ 0xA5 ].RnW, "DP IDCODE read" );
+static_assert( RequestTable[ 0xBB ].valid && RequestTable[ 0xBB ].APnDP && RequestTable[ 0xBB ].addr == 0xC, "AP DRW write" );
+static_assert( !RequestTable[ 0xA1 ].valid && !RequestTable[ 0xFF ].valid, "bad parity and stop bit" );
+
+// The register table index is made of the APnDP, RnW, A[2..3] bits of the request byte
+// (bits 1..4) and of the SELECT register bits that pick the register bank:
+// APBANKSEL (SELECT[7..4]) for the AccessPort and CTRLSEL (SELECT[0]) for the DebugPort.
+//
+//  index[8..7] A[2..3]
+//  index[6]    RnW
+//  index[5]    APnDP
+//  index[4..1] APBANKSEL
+//  index[0]    CTRLSEL
+inline size_t RegisterIndex( U8 request_byte, U32 select_reg )
+{
+    return ( ( request_byte & 0x1E ) << 4 ) | ( select_reg & 0xF0 ) >> 3 | ( select_reg & 1 );
+}
+
+constexpr RVSWDRegisters ResolveAPRegister( int apreg )
+{
+    return apreg == 0x00   ? RVSWDR_AP_CSW
+           : apreg == 0x04 ? RVSWDR_AP_TAR
+           : apreg == 0x0C ? RVSWDR_AP_DRW
+           : apreg == 0x10 ? RVSWDR_AP_BD0
+           : apreg == 0x14 ? RVSWDR_AP_BD1
+           : apreg == 0x18 ? RVSWDR_AP_BD2
+           : apreg == 0x1C ? RVSWDR_AP_BD3
+           : apreg == 0xF4 ? RVSWDR_AP_CFG
+           : apreg == 0xF8 ? RVSWDR_AP_BASE
+           : apreg == 0xFC ? RVSWDR_AP_IDR
+                           : RVSWDR_AP_RAZ_WI;
+}
+
+constexpr RVSWDRegisters ResolveDPRegister( bool RnW, int addr, bool ctrlsel )
+{
+    return addr == 0x0   ? ( RnW ? RVSWDR_DP_IDCODE : RVSWDR_DP_ABORT )
+           : addr == 0x4 ? ( ctrlsel ? RVSWDR_DP_WCR : RVSWDR_DP_CTRL_STAT )
+           : addr == 0x8 ? ( RnW ? RVSWDR_DP_RESEND : RVSWDR_DP_SELECT )
+                         : ( RnW ? RVSWDR_DP_RDBUFF : RVSWDR_DP_ROUTESEL );
+}
+
+constexpr U8 MakeRegister( int ndx )
+{
+    return U8( ( ndx & 0x20 ) != 0 ? ResolveAPRegister( ( ( ndx & 0x1E ) << 3 ) | ( ( ndx & 0x180 ) >> 5 ) )
+                                   : ResolveDPRegister( ( ndx & 0x40 ) != 0, ( ndx & 0x180 ) >> 5, ( ndx & 1 ) != 0 ) );
+}
+
+static constexpr U8 RegisterTable[ 512 ] = { TABLE256( MakeRegister, 0 ), TABLE256( MakeRegister, 256 ) };
+
+static_assert( RegisterTable[ ( 0xBB & 0x1E ) << 4 ] == RVSWDR_AP_DRW, "DRW in bank 0" );
+static_assert( RegisterTable[ ( ( 0x9F & 0x1E ) << 4 ) | ( 0xF0 >> 3 ) ] == RVSWDR_AP_IDR, "IDR in bank 0xF" );
+static_assert( RegisterTable[ ( ( 0x8D & 0x1E ) << 4 ) | 1 ] == RVSWDR_DP_WCR, "WCR with CTRLSEL set" );
+
+RVSWDRegisters GetRegister( U8 request_byte, U32 select_reg )
+{
+    return RVSWDRegisters( RegisterTable[ RegisterIndex( request_byte, select_reg ) ] );
+}
 
 S64 RVSWDBit::GetMinStartEnd() const
 {
@@ -31,7 +103,7 @@ S64 RVSWDBit::GetEndSample() const
     return falling + GetMinStartEnd() - 1;
 }
 
-Frame RVSWDBit::MakeFrame()
+Frame RVSWDBit::MakeFrame() const
 {
     Frame f;
 
@@ -46,9 +118,57 @@ Frame RVSWDBit::MakeFrame()
     return f;
 }
 
+const char* GetRegisterName( RVSWDRegisters reg )
+{
+    switch( reg )
+    {
+    case RVSWDR_DP_IDCODE:
+        return "IDCODE";
+    case RVSWDR_DP_ABORT:
+        return "ABORT";
+    case RVSWDR_DP_CTRL_STAT:
+        return "CTRL/STAT";
+    case RVSWDR_DP_WCR:
+        return "WCR";
+    case RVSWDR_DP_RESEND:
+        return "RESEND";
+    case RVSWDR_DP_SELECT:
+        return "SELECT";
+    case RVSWDR_DP_RDBUFF:
+        return "RDBUFF";
+    case RVSWDR_DP_ROUTESEL:
+        return "ROUTESEL";
+
+    case RVSWDR_AP_CSW:
+        return "CSW";
+    case RVSWDR_AP_TAR:
+        return "TAR";
+    case RVSWDR_AP_DRW:
+        return "DRW";
+    case RVSWDR_AP_BD0:
+        return "BD0";
+    case RVSWDR_AP_BD1:
+        return "BD1";
+    case RVSWDR_AP_BD2:
+        return "BD2";
+    case RVSWDR_AP_BD3:
+        return "BD3";
+    case RVSWDR_AP_CFG:
+        return "CFG";
+    case RVSWDR_AP_BASE:
+        return "BASE";
+    case RVSWDR_AP_RAZ_WI:
+        return "RAZ_WI";
+    case RVSWDR_AP_IDR:
+        return "IDR";
+    }
+
+    return "??";
+}
+
 // ********************************************************************************
 
-std::string RVSWDRequestFrame::GetRegisterName() const
+const char* RVSWDRequestFrame::GetRegisterName() const
 {
     return ::GetRegisterName( GetRegister() );
 }
@@ -60,15 +180,16 @@ void RVSWDOperation::Clear()
     RnW = APnDP = parity_read = data_parity_ok = false;
     addr = parity_read = request_byte = ACK = data_parity = data = 0;
     reg = RVSWDR_undefined;
+    select_reg = 0;
 
-    bits.clear();
+    bits.Clear();
 }
 
-void RVSWDOperation::AddFrames( RVSWDAnalyzerResults* pResults )
+void RVSWDOperation::AddFrames( RVSWDFrameSink* pSink )
 {
     Frame f;
 
-    assert( bits.size() >= TRAN_REQ_AND_ACK );
+    assert( bits.Size() >= TRAN_REQ_AND_ACK );
 
     // request
     RVSWDRequestFrame req;
@@ -76,418 +197,254 @@ void RVSWDOperation::AddFrames( RVSWDAnalyzerResults* pResults )
     req.mEndingSampleInclusive = bits[ 7 ].GetEndSample();
     req.mFlags = ( IsRead() ? RVSWDRequestFrame::IS_READ : 0 ) | ( APnDP ? RVSWDRequestFrame::IS_ACCESS_PORT : 0 );
     req.SetRequestByte( request_byte );
+    req.SetSelect( select_reg );
     req.SetRegister( reg );
     req.mType = RVSWDFT_Request;
-    pResults->AddFrame( req );
+    pSink->AddFrame( req );
 
     // turnaround
     f = bits[ 8 ].MakeFrame();
     f.mType = RVSWDFT_Turnaround;
-    pResults->AddFrame( f );
+    pSink->AddFrame( f );
 
     // ack
     f.mStartingSampleInclusive = bits[ 9 ].GetStartSample();
     f.mEndingSampleInclusive = bits[ 11 ].GetEndSample();
     f.mType = RVSWDFT_ACK;
     f.mData1 = ACK;
-    pResults->AddFrame( f );
+    pSink->AddFrame( f );
 
-    if( bits.size() < TRAN_READ_LENGTH )
+    if( bits.Size() < TRAN_READ_LENGTH )
         return;
 
     // turnaround
-    std::vector<RVSWDBit>::iterator bi( bits.begin() + 12 );
+    size_t bi = 12;
     if( !IsRead() )
     {
         f = bits[ 12 ].MakeFrame();
         f.mType = RVSWDFT_Turnaround;
-        pResults->AddFrame( f );
+        pSink->AddFrame( f );
         bi++;
     }
 
     // data
-    f = bi->MakeFrame();
-    f.mEndingSampleInclusive = bi[ 31 ].GetEndSample();
+    f = bits[ bi ].MakeFrame();
+    f.mEndingSampleInclusive = bits[ bi + 31 ].GetEndSample();
     f.mType = RVSWDFT_WData;
     f.mData1 = data;
     f.mData2 = reg;
-    pResults->AddFrame( f );
+    pSink->AddFrame( f );
 
     // data parity
-    f = bi[ 32 ].MakeFrame();
+    f = bits[ bi + 32 ].MakeFrame();
     f.mType = RVSWDFT_DataParity;
     f.mData1 = data_parity;
     f.mData2 = data_parity_ok ? 1 : 0;
-    pResults->AddFrame( f );
-
-    bi += 33;
-
-    // do we have trailing bits?
-    if( bi < bits.end() )
-    {
-        f.mStartingSampleInclusive = bi->GetStartSample();
-        f.mEndingSampleInclusive = bits.back().GetEndSample();
-        f.mType = RVSWDFT_TrailingBits;
-
-        f.mFlags = 0;
-        f.mData1 = 0;
-        f.mData2 = 0;
-
-        pResults->AddFrame( f );
-    }
+    pSink->AddFrame( f );
 }
 
-void RVSWDOperation::AddMarkers( RVSWDAnalyzerResults* pResults )
+void RVSWDOperation::AddMarkers( RVSWDFrameSink* pSink )
 {
-    for( std::vector<RVSWDBit>::iterator bi( bits.begin() ); bi != bits.end(); bi++ )
+    for( size_t ndx = 0; ndx < bits.Size(); ndx++ )
     {
-        int ndx = bi - bits.begin();
+        RVSWDBit bit( bits[ ndx ] );
 
         // turnaround
         if( ndx == 8 || ndx == 12 && !IsRead() )
-            pResults->AddMarker( ( bi->falling + bi->rising ) / 2, AnalyzerResults::X, pResults->GetSettings()->mCLK );
+            pSink->AddMarker( ( bit.falling + bit.rising ) / 2, RVSWDM_X );
 
         // write
         else if( ndx < 8 || ndx > 12 && !IsRead() )
-            pResults->AddMarker( bi->falling, bi->state_falling == BIT_HIGH ? AnalyzerResults::One : AnalyzerResults::Zero,
-                                 pResults->GetSettings()->mCLK );
+            pSink->AddMarker( bit.falling, bit.state_falling == BIT_HIGH ? RVSWDM_One : RVSWDM_Zero );
         // read
         else
-            pResults->AddMarker( bi->rising, bi->state_rising == BIT_HIGH ? AnalyzerResults::One : AnalyzerResults::Zero,
-                                 pResults->GetSettings()->mCLK );
+            pSink->AddMarker( bit.rising, bit.state_rising == BIT_HIGH ? RVSWDM_One : RVSWDM_Zero );
     }
 }
 
-void RVSWDOperation::SetRegister( U32 select_reg )
+void RVSWDOperation::SetRegister( U32 select )
 {
-    if( APnDP ) // AccessPort or DebugPort?
-    {
-        U8 apbanksel = U8( select_reg & 0xf0 );
-        U8 apreg = apbanksel | addr;
-
-        switch( apreg )
-        {
-        case 0x00:
-            reg = RVSWDR_AP_CSW;
-            break;
-        case 0x04:
-            reg = RVSWDR_AP_TAR;
-            break;
-        case 0x0C:
-            reg = RVSWDR_AP_DRW;
-            break;
-        case 0x10:
-            reg = RVSWDR_AP_BD0;
-            break;
-        case 0x14:
-            reg = RVSWDR_AP_BD1;
-            break;
-        case 0x18:
-            reg = RVSWDR_AP_BD2;
-            break;
-        case 0x1C:
-            reg = RVSWDR_AP_BD3;
-            break;
-        case 0xF4:
-            reg = RVSWDR_AP_CFG;
-            break;
-        case 0xF8:
-            reg = RVSWDR_AP_BASE;
-            break;
-        case 0xFC:
-            reg = RVSWDR_AP_IDR;
-            break;
-        default:
-            reg = RVSWDR_AP_RAZ_WI;
-            break;
-        }
-    }
-    else
-    {
-        switch( addr )
-        {
-        case 0x0:
-            reg = RnW ? RVSWDR_DP_IDCODE : RVSWDR_DP_ABORT;
-            break;
-        case 0x4:
-            reg = ( select_reg & 1 ) != 0 ? RVSWDR_DP_WCR : RVSWDR_DP_CTRL_STAT;
-            break;
-        case 0x8:
-            reg = RnW ? RVSWDR_DP_RESEND : RVSWDR_DP_SELECT;
-            break;
-        case 0xC:
-            reg = RnW ? RVSWDR_DP_RDBUFF : RVSWDR_DP_ROUTESEL;
-            break;
-        }
-    }
+    reg = GetRegister( request_byte, select );
+    select_reg = select;
 }
 
 // ********************************************************************************
 
-void RVSWDLineReset::AddFrames( AnalyzerResults* pResults )
+void RVSWDLineReset::AddFrames( RVSWDFrameSink* pSink )
 {
     Frame f;
 
     // line reset
-    f.mStartingSampleInclusive = bits.front().GetStartSample();
-    f.mEndingSampleInclusive = bits.back().GetEndSample();
+    f.mStartingSampleInclusive = first_bit.GetStartSample();
+    f.mEndingSampleInclusive = last_bit.GetEndSample();
     f.mType = RVSWDFT_LineReset;
-    f.mData1 = bits.size();
-    pResults->AddFrame( f );
+    f.mData1 = num_bits;
+    pSink->AddFrame( f );
 }
 
 // ********************************************************************************
 
-RVSWDParser::RVSWDParser() : mDIO( 0 ), mCLK( 0 )
-{
-}
-
-void RVSWDParser::Setup( AnalyzerChannelData* pDIO, AnalyzerChannelData* pCLK, RVSWDAnalyzer* pAnalyzer )
+void RVSWDIdle::AddFrames( RVSWDFrameSink* pSink )
 {
-    mDIO = pDIO;
-    mCLK = pCLK;
-
-    mAnalyzer = pAnalyzer;
+    Frame f;
 
-    // skip the CLK high
-    if( mCLK->GetBitState() == BIT_HIGH )
-    {
-        mCLK->AdvanceToNextEdge();
-        mDIO->AdvanceToAbsPosition( mCLK->GetSampleNumber() );
-    }
+    f.mStartingSampleInclusive = first_bit.GetStartSample();
+    f.mEndingSampleInclusive = last_bit.GetEndSample();
+    f.mType = RVSWDFT_Idle;
+    f.mData1 = num_bits;
+    pSink->AddFrame( f );
 }
 
-RVSWDBit RVSWDParser::ParseBit()
-{
-    RVSWDBit rbit;
-
-    assert( mCLK->GetBitState() == BIT_LOW );
-
-    rbit.low_start = mCLK->GetSampleNumber();
-
-    // sample the rising edge 1 sample before the the actual
-    mCLK->AdvanceToAbsPosition( mCLK->GetSampleOfNextEdge() - 1 );
-    mDIO->AdvanceToAbsPosition( mCLK->GetSampleNumber() );
-    rbit.rising = mCLK->GetSampleNumber();
-    rbit.state_rising = mDIO->GetBitState();
-    mCLK->AdvanceToNextEdge();
-    mDIO->AdvanceToAbsPosition( mCLK->GetSampleNumber() );
-
-    /*
-    // go to the rising egde
-    mCLK->AdvanceToNextEdge();
-    mDIO->AdvanceToAbsPosition(mCLK->GetSampleNumber());
-
-    rbit.rising = mCLK->GetSampleNumber();
-    rbit.state_rising = mDIO->GetBitState();
-    */
-
-    // go to the falling edge
-    mCLK->AdvanceToNextEdge();
-    mDIO->AdvanceToAbsPosition( mCLK->GetSampleNumber() );
-
-    rbit.falling = mCLK->GetSampleNumber();
-    rbit.state_falling = mDIO->GetBitState();
-
-    rbit.low_end = mCLK->GetSampleOfNextEdge();
+// ********************************************************************************
 
-    return rbit;
-}
+const U64 RVSWDTransactionTracker::NO_TRANSACTION;
 
-void RVSWDParser::BufferBits( size_t num_bits )
+RVSWDTransactionTracker::RVSWDTransactionTracker()
 {
-    while( mBitsBuffer.size() < num_bits )
-        mBitsBuffer.push_back( ParseBit() );
+    Clear();
 }
 
-RVSWDBit RVSWDParser::PopFrontBit()
+void RVSWDTransactionTracker::Clear()
 {
-    assert( !mBitsBuffer.empty() );
-
-    RVSWDBit ret_val( mBitsBuffer.front() );
-
-    // shift the elements by 1
-    std::copy( mBitsBuffer.begin() + 1, mBitsBuffer.end(), mBitsBuffer.begin() );
-    mBitsBuffer.pop_back();
-
-    return ret_val;
+    mCurrent = NO_TRANSACTION;
+    mNextTransaction = 0;
+    mHadAccess = false;
 }
 
-bool RVSWDParser::IsOperation( RVSWDOperation& tran )
+U64 RVSWDTransactionTracker::AddOperation( const RVSWDOperation& tran )
 {
-    tran.Clear();
-
-    // read enough bits so that we don't have to worry of subscripts out of range
-    BufferBits( TRAN_REQ_AND_ACK );
-
-    // turn the bits into a byte
-    tran.request_byte = 0;
-    for( size_t cnt = 0; cnt < 8; ++cnt )
+    switch( tran.reg )
     {
-        tran.request_byte >>= 1;
-        tran.request_byte |= ( mBitsBuffer[ cnt ].IsHigh() ? 0x80 : 0 );
-    }
-
-    // are the request's constant bits (start, stop & park) wrong?
-    if( ( tran.request_byte & 0xC1 ) != 0x81 )
-        return false;
-
-    // get the indivitual bits
-    tran.APnDP = ( tran.request_byte & 0x02 ) != 0;                   //(mBitsBuffer[1].state_falling == BIT_HIGH);
-    tran.RnW = ( tran.request_byte & 0x04 ) != 0;                     //(mBitsBuffer[2].state_falling == BIT_HIGH);
-    tran.addr = ( tran.request_byte & 0x18 ) >> 1;                    //(mBitsBuffer[3].state_falling == BIT_HIGH ? (1<<2) : 0)
-                                                                      //| (mBitsBuffer[4].state_falling == BIT_HIGH ? (1<<3) : 0);
-    tran.parity_read = ( ( tran.request_byte & 0x20 ) != 0 ? 1 : 0 ); //(mBitsBuffer[5].state_falling == BIT_HIGH ? 1 : 0);
-
-    // check parity
-    int check = ( mBitsBuffer[ 1 ].state_rising == BIT_HIGH ? 1 : 0 ) + ( mBitsBuffer[ 2 ].state_rising == BIT_HIGH ? 1 : 0 ) +
-                ( mBitsBuffer[ 3 ].state_rising == BIT_HIGH ? 1 : 0 ) + ( mBitsBuffer[ 4 ].state_rising == BIT_HIGH ? 1 : 0 );
-
-    if( tran.parity_read != ( check & 1 ) )
-        return false;
-
-    // Set the actual register in this operation based on the data from the request
-    // and the previous select register state.
-    tran.SetRegister( mSelectRegister );
-
-    // get the ACK value
-    tran.ACK = ( mBitsBuffer[ 9 ].state_rising == BIT_HIGH ? 1 : 0 ) + ( mBitsBuffer[ 10 ].state_rising == BIT_HIGH ? 2 : 0 ) +
-               ( mBitsBuffer[ 11 ].state_rising == BIT_HIGH ? 4 : 0 );
-
-    // we're only handling OK, WAIT and FAULT responses
-    if( tran.ACK == ACK_WAIT || tran.ACK == ACK_FAULT )
-    {
-        // copy this operation's bits
-        tran.bits.clear();
-        std::copy( mBitsBuffer.begin(), mBitsBuffer.begin() + TRAN_REQ_AND_ACK, std::back_inserter( tran.bits ) );
-
-        // consume this operation's bits
-        mBitsBuffer.erase( mBitsBuffer.begin(), mBitsBuffer.begin() + TRAN_REQ_AND_ACK );
-
-        return true;
-    }
-
-    if( tran.ACK != ACK_OK )
-        return false;
-
-    BufferBits( TRAN_READ_LENGTH );
-
-    // turnaround if write operation
-    bool read_rising = true;
-    std::vector<RVSWDBit>::iterator bi( mBitsBuffer.begin() + 12 );
-    if( !tran.IsRead() )
-    {
-        BufferBits( TRAN_WRITE_LENGTH );
-        ++bi;
-        // !!! read_rising = false;
-    }
-
-    // read the data
-    tran.data = 0;
-    check = 0;
-    size_t ndx;
-    for( ndx = 0; ndx < 32; ndx++ )
-    {
-        tran.data >>= 1;
-
-        if( bi[ ndx ].IsHigh( read_rising ) )
+    case RVSWDR_DP_SELECT:
+    case RVSWDR_AP_CSW:
+    case RVSWDR_AP_TAR:
+        // reading CSW or TAR back is part of the transaction, writing starts one after an access
+        if( mCurrent == NO_TRANSACTION || ( mHadAccess && !tran.RnW ) )
         {
-            tran.data |= 0x80000000;
-            ++check;
+            mCurrent = mNextTransaction++;
+            mHadAccess = false;
         }
+        break;
+
+    case RVSWDR_AP_DRW:
+    case RVSWDR_AP_BD0:
+    case RVSWDR_AP_BD1:
+    case RVSWDR_AP_BD2:
+    case RVSWDR_AP_BD3:
+    case RVSWDR_DP_RDBUFF:
+        // an access without a setup we've seen, like after a line reset, gets a transaction of its own
+        if( mCurrent == NO_TRANSACTION )
+            mCurrent = mNextTransaction++;
+
+        mHadAccess = true;
+        break;
+
+    default:
+        mCurrent = NO_TRANSACTION;
+        break;
     }
 
-    // data parity
-    tran.data_parity = bi[ ndx ].IsHigh( read_rising ) ? 1 : 0;
+    return mCurrent;
+}
 
-    tran.data_parity_ok = ( tran.data_parity == ( check & 1 ) );
+// ********************************************************************************
 
-    if( !tran.data_parity_ok )
-        return false;
+RVSWDBitWindow::RVSWDBitWindow( size_t capacity ) : mHead( 0 ), mSize( 0 ), mMaxSize( 0 )
+{
+    // round up to a power of two, and to at least one word of states,
+    // so that indexing is a simple mask
+    size_t cap = 64;
+    while( cap < capacity )
+        cap <<= 1;
 
-    // if this is a SELECT register write, remember the value
-    if( tran.reg == RVSWDR_DP_SELECT && !tran.RnW )
-        mSelectRegister = tran.data;
+    mRisingStates.resize( cap / 64 );
+    mFallingStates.resize( cap / 64 );
 
-    // buffered trailing zeros
-    ++ndx;
-    bool all_zeros = true;
-    while( bi + ndx < mBitsBuffer.end() )
-    {
-        if( bi[ ndx ].IsHigh( read_rising ) )
-        {
-            all_zeros = false;
-            break;
-        }
+    mLowStart.resize( cap );
+    mRising.resize( cap );
+    mFalling.resize( cap );
+    mLowEnd.resize( cap );
 
-        ++ndx;
-    }
+    mMask = cap - 1;
+}
 
-    // if we haven't seen a high bit carry on until we do
-    if( all_zeros )
-    {
-        // read the remaining zero bits
-        RVSWDBit bit;
-        while( 1 )
-        {
-            bit = ParseBit();
-            if( bit.IsHigh( read_rising ) )
-                break;
+void RVSWDBitWindow::Grow()
+{
+    // unwrap the buffered bits into a buffer twice the size
+    RVSWDBitWindow bigger( Capacity() * 2 );
+    for( size_t ndx = 0; ndx < mSize; ++ndx )
+        bigger.PushBack( Bit( ndx ) );
+
+    mRisingStates.swap( bigger.mRisingStates );
+    mFallingStates.swap( bigger.mFallingStates );
+    mLowStart.swap( bigger.mLowStart );
+    mRising.swap( bigger.mRising );
+    mFalling.swap( bigger.mFalling );
+    mLowEnd.swap( bigger.mLowEnd );
+
+    mMask = bigger.mMask;
+    mHead = 0;
+}
 
-            mBitsBuffer.push_back( bit );
-        }
+void RVSWDBitWindow::PushBack( const RVSWDBit& bit )
+{
+    if( mSize == Capacity() )
+        Grow();
 
-        // give the bits to the tran object
-        tran.bits = mBitsBuffer;
-        mBitsBuffer.clear();
+    size_t pos = Pos( mSize );
+    U64 mask = U64( 1 ) << ( pos & 63 );
 
-        // keep the high bit because that one is probably next operation's start bit
-        mBitsBuffer.push_back( bit );
-    }
+    if( bit.state_rising == BIT_HIGH )
+        mRisingStates[ pos >> 6 ] |= mask;
     else
-    {
-        // copy this operation's bits
-        tran.bits.clear();
-        std::copy( mBitsBuffer.begin(), mBitsBuffer.begin() + ndx, std::back_inserter( tran.bits ) );
+        mRisingStates[ pos >> 6 ] &= ~mask;
 
-        // remove this operation's bits from the buffer
-        mBitsBuffer.erase( mBitsBuffer.begin(), mBitsBuffer.begin() + ndx );
-    }
+    if( bit.state_falling == BIT_HIGH )
+        mFallingStates[ pos >> 6 ] |= mask;
+    else
+        mFallingStates[ pos >> 6 ] &= ~mask;
 
-    return true;
+    mLowStart[ pos ] = bit.low_start;
+    mRising[ pos ] = bit.rising;
+    mFalling[ pos ] = bit.falling;
+    mLowEnd[ pos ] = bit.low_end;
+
+    if( ++mSize > mMaxSize )
+        mMaxSize = mSize;
 }
 
-bool RVSWDParser::IsLineReset( RVSWDLineReset& reset )
+RVSWDBit RVSWDBitWindow::Bit( size_t ndx ) const
 {
-    reset.Clear();
+    assert( ndx < mSize );
 
-    // we need at least 50 bits with a value of 1
-    for( size_t cnt = 0; cnt < 50; cnt++ )
-    {
-        if( cnt >= mBitsBuffer.size() )
-            mBitsBuffer.push_back( ParseBit() );
+    size_t pos = Pos( ndx );
 
-        // we can't have a low bit
-        if( !mBitsBuffer[ cnt ].IsHigh() )
-            return false;
-    }
+    RVSWDBit rbit;
+    rbit.state_rising = IsHigh( ndx, true ) ? BIT_HIGH : BIT_LOW;
+    rbit.state_falling = IsHigh( ndx, false ) ? BIT_HIGH : BIT_LOW;
+    rbit.low_start = mLowStart[ pos ];
+    rbit.rising = mRising[ pos ];
+    rbit.falling = mFalling[ pos ];
+    rbit.low_end = mLowEnd[ pos ];
 
-    RVSWDBit bit;
-    while( true )
-    {
-        bit = ParseBit();
-        if( !bit.IsHigh() )
-            break;
+    return rbit;
+}
 
-        mBitsBuffer.push_back( bit );
-    }
+size_t RVSWDBitWindow::Find( size_t ndx, bool is_rising, U64 invert ) const
+{
+    // look at up to 64 bits at a time
+    while( ndx < mSize )
+    {
+        size_t num_bits = std::min<size_t>( mSize - ndx, 64 );
+        U64 bits = GetBits( ndx, num_bits, is_rising ) ^ invert;
+        if( num_bits < 64 )
+            bits &= ( U64( 1 ) << num_bits ) - 1;
 
-    // give the bits to the reset object
-    reset.bits = mBitsBuffer;
-    mBitsBuffer.clear();
+        if( bits != 0 )
+            return ndx + CountTrailingZeros( bits );
 
-    // keep the high bit because that one is probably next operation's start bit
-    mBitsBuffer.push_back( bit );
+        ndx += num_bits;
+    }
 
-    return true;
+    return mSize;
 }
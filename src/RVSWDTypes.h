@@ -1,9 +1,15 @@
 #ifndef RVSWD_TYPES_H
 #define RVSWD_TYPES_H
 
-#include <LogicPublicTypes.h>
+#include <vector>
+#include <string>
 
-#include "RVSWDAnalyzerResults.h"
+#include "RVSWDPlatform.h"
+
+// operation lengths in bits
+const int TRAN_REQ_AND_ACK = 8 + 1 + 3;             // request/turnaround/ACK
+const int TRAN_READ_LENGTH = TRAN_REQ_AND_ACK + 33; // previous + 32bit data + parity
+const int TRAN_WRITE_LENGTH = TRAN_READ_LENGTH + 1; // previous + one bit for turnaround
 
 // the possible frame types
 enum RVSWDFrameTypes
@@ -19,6 +25,28 @@ enum RVSWDFrameTypes
     RVSWDFT_WData,
     RVSWDFT_DataParity,
     RVSWDFT_TrailingBits,
+    RVSWDFT_Idle,
+};
+
+// An analyzer that decodes several buses puts the bus index into these bits of each
+// frame's mFlags. Bits 0 and 1 are the request frame's flags, the SDK has 6 and 7.
+enum
+{
+    RVSWD_BUS_SHIFT = 2,
+    RVSWD_BUS_MASK = 7 << RVSWD_BUS_SHIFT,
+};
+
+inline U32 GetFrameBus( const Frame& f )
+{
+    return ( f.mFlags & RVSWD_BUS_MASK ) >> RVSWD_BUS_SHIFT;
+}
+
+// the markers an operation puts on its bits
+enum RVSWDMarkerTypes
+{
+    RVSWDM_Zero,
+    RVSWDM_One,
+    RVSWDM_X,
 };
 
 // the DebugPort and AccessPort registers as defined by SWD
@@ -58,8 +86,27 @@ enum RVSWDACK
     ACK_FAULT = 4,
 };
 
+// the fields of a request byte, as looked up in the request decode table
+struct RVSWDRequestInfo
+{
+    bool valid; // start, stop, park and parity bits are all correct
+    bool APnDP;
+    bool RnW;
+    U8 addr; // A[2..3]
+    U8 parity;
+};
+
+// the decoded fields of all 256 request bytes
+extern const RVSWDRequestInfo RequestTable[ 256 ];
+
+// returns the register a request byte accesses, given the value of the SELECT register
+RVSWDRegisters GetRegister( U8 request_byte, U32 select_reg );
+
+// returns the name of the register as shown in the bubbles and the export, a literal that's never freed
+const char* GetRegisterName( RVSWDRegisters reg );
+
 // this is the basic token of the analyzer
-// objects of this type are buffered in SWDOperation
+// objects of this type are buffered in RVSWDBitWindow
 struct RVSWDBit
 {
     BitState state_rising;
@@ -79,7 +126,193 @@ struct RVSWDBit
     S64 GetStartSample() const;
     S64 GetEndSample() const;
 
-    Frame MakeFrame();
+    Frame MakeFrame() const;
+};
+
+// Ring buffer of the bits the parser is currently looking at.
+// Bits are addressed by index relative to the oldest buffered bit, like a vector,
+// but dropping bits from the front is O(1) instead of shifting the whole buffer.
+// The buffer is stored as a structure of arrays: the DIO states sampled at the
+// rising and falling CLK edges are packed 64 to a word, so that a whole field
+// of an operation can be extracted with a couple of shifts, and the sample
+// numbers are kept in separate arrays that are only touched when frames are made.
+// The capacity is a power of two (at least 64) and is only ever increased if a
+// caller keeps pushing bits without consuming them.
+class RVSWDBitWindow
+{
+  private:
+    std::vector<U64> mRisingStates;
+    std::vector<U64> mFallingStates;
+
+    std::vector<S64> mLowStart;
+    std::vector<S64> mRising;
+    std::vector<S64> mFalling;
+    std::vector<S64> mLowEnd;
+
+    size_t mHead;
+    size_t mSize;
+    size_t mMask;
+
+    // the most bits that were ever buffered at once
+    size_t mMaxSize;
+
+    void Grow();
+    size_t Find( size_t ndx, bool is_rising, U64 invert ) const;
+
+    size_t Pos( size_t ndx ) const
+    {
+        return ( mHead + ndx ) & mMask;
+    }
+
+  public:
+    RVSWDBitWindow( size_t capacity = 128 );
+
+    size_t Size() const
+    {
+        return mSize;
+    }
+
+    bool Empty() const
+    {
+        return mSize == 0;
+    }
+
+    size_t Capacity() const
+    {
+        return mMask + 1;
+    }
+
+    size_t MaxSize() const
+    {
+        return mMaxSize;
+    }
+
+    bool IsHigh( size_t ndx, bool is_rising = true ) const
+    {
+        size_t pos = Pos( ndx );
+        return ( ( ( is_rising ? mRisingStates : mFallingStates )[ pos >> 6 ] >> ( pos & 63 ) ) & 1 ) != 0;
+    }
+
+    // returns num_bits (1..64) consecutive DIO states starting at ndx,
+    // with the state of bit ndx in the least significant bit
+    U64 GetBits( size_t ndx, size_t num_bits, bool is_rising = true ) const
+    {
+        const std::vector<U64>& states( is_rising ? mRisingStates : mFallingStates );
+        size_t pos = Pos( ndx );
+        size_t word = pos >> 6;
+        size_t shift = pos & 63;
+
+        U64 ret_val = states[ word ] >> shift;
+        if( shift + num_bits > 64 )
+            ret_val |= states[ ( word + 1 ) & ( mMask >> 6 ) ] << ( 64 - shift );
+
+        return num_bits < 64 ? ret_val & ( ( U64( 1 ) << num_bits ) - 1 ) : ret_val;
+    }
+
+    // return the index of the first bit at or after ndx that is high (or low),
+    // or Size() if there is no such bit in the window
+    size_t FindHigh( size_t ndx, bool is_rising = true ) const
+    {
+        return Find( ndx, is_rising, 0 );
+    }
+
+    size_t FindLow( size_t ndx, bool is_rising = true ) const
+    {
+        return Find( ndx, is_rising, ~U64( 0 ) );
+    }
+
+    RVSWDBit Bit( size_t ndx ) const;
+
+    RVSWDBit Front() const
+    {
+        return Bit( 0 );
+    }
+
+    RVSWDBit Back() const
+    {
+        return Bit( mSize - 1 );
+    }
+
+    void PushBack( const RVSWDBit& bit );
+
+    void PopFront()
+    {
+        mHead = ( mHead + 1 ) & mMask;
+        --mSize;
+    }
+
+    // drops the oldest num_bits bits
+    void Consume( size_t num_bits )
+    {
+        mHead = ( mHead + num_bits ) & mMask;
+        mSize -= num_bits;
+    }
+
+    void Clear()
+    {
+        mHead = mSize = 0;
+    }
+
+};
+
+// A view of consecutive bits in the parser's bit window, used by the operations
+// and line resets to make their frames without copying the bits out of the parser.
+// It is only valid until the next call into the parser.
+class RVSWDBitView
+{
+  private:
+    const RVSWDBitWindow* mWindow;
+    size_t mOffset;
+    size_t mSize;
+
+  public:
+    RVSWDBitView() : mWindow( 0 ), mOffset( 0 ), mSize( 0 )
+    {
+    }
+
+    RVSWDBitView( const RVSWDBitWindow& window, size_t offset, size_t size ) : mWindow( &window ), mOffset( offset ), mSize( size )
+    {
+    }
+
+    size_t Size() const
+    {
+        return mSize;
+    }
+
+    RVSWDBit operator[]( size_t ndx ) const
+    {
+        return mWindow->Bit( mOffset + ndx );
+    }
+
+    RVSWDBit Back() const
+    {
+        return mWindow->Bit( mOffset + mSize - 1 );
+    }
+
+    void Clear()
+    {
+        mWindow = 0;
+        mOffset = mSize = 0;
+    }
+};
+
+// Receives the frames and markers of the decoded operations and line resets.
+// In the plugin this is the result stage that commits them to the SDK, the
+// headless decoder writes them out directly.
+class RVSWDFrameSink
+{
+  public:
+    virtual ~RVSWDFrameSink()
+    {
+    }
+
+    virtual void AddFrame( const Frame& f ) = 0;
+    virtual void AddMarker( S64 sample_number, RVSWDMarkerTypes marker_type ) = 0;
+
+    // the parser has used up the data that's available so far and is about to wait for more
+    virtual void OnStall( U64 /*sample_number*/ )
+    {
+    }
 };
 
 // this object contains data about one SWD operation as described in section 5.3
@@ -103,14 +336,16 @@ struct RVSWDOperation
     U8 data_parity;
     bool data_parity_ok;
 
-    std::vector<RVSWDBit> bits;
+    RVSWDBitView bits;
 
-    // DebugPort or AccessPort register that this operation is reading/writing
+    // DebugPort or AccessPort register that this operation is reading/writing,
+    // and the SELECT register value it was resolved with
     RVSWDRegisters reg;
+    U32 select_reg;
 
     void Clear();
-    void AddFrames( RVSWDAnalyzerResults* pResults );
-    void AddMarkers( RVSWDAnalyzerResults* pResults );
+    void AddFrames( RVSWDFrameSink* pSink );
+    void AddMarkers( RVSWDFrameSink* pSink );
     void SetRegister( U32 select_reg );
 
     bool IsRead()
@@ -119,21 +354,78 @@ struct RVSWDOperation
     }
 };
 
+// A line reset, or the line idling high, is kept as a run length. Only its first
+// and last bits are stored, so it takes the same memory however long DIO stays high.
 struct RVSWDLineReset
 {
-    std::vector<RVSWDBit> bits;
+    RVSWDBit first_bit;
+    RVSWDBit last_bit;
+    U64 num_bits;
+
+    void Clear()
+    {
+        num_bits = 0;
+    }
+
+    void AddFrames( RVSWDFrameSink* pSink );
+};
+
+// The host clocking zeros after an operation's data phase, kept as a run length like
+// the line reset. It's returned separately from the operation, so the operation's
+// frames don't have to wait for the end of a long idle period.
+struct RVSWDIdle
+{
+    RVSWDBit first_bit;
+    RVSWDBit last_bit;
+    U64 num_bits;
 
     void Clear()
     {
-        bits.clear();
+        num_bits = 0;
     }
 
-    void AddFrames( AnalyzerResults* pResults );
+    void AddFrames( RVSWDFrameSink* pSink );
+};
+
+// Groups the operations into transactions, the memory accesses made of a setup, writes
+// to SELECT, CSW and TAR, followed by DRW, BD0..BD3 and RDBUFF accesses. A setup write
+// after an access starts the next transaction. The other operations and line resets
+// aren't part of a transaction and end the current one.
+class RVSWDTransactionTracker
+{
+  public:
+    static const U64 NO_TRANSACTION = ~U64( 0 );
+
+    RVSWDTransactionTracker();
+
+    void Clear();
+
+    // returns the transaction the operation belongs to, or NO_TRANSACTION
+    U64 AddOperation( const RVSWDOperation& tran );
+
+    void AddLineReset()
+    {
+        mCurrent = NO_TRANSACTION;
+    }
+
+    // the number of transactions so far
+    U64 GetNumTransactions() const
+    {
+        return mNextTransaction;
+    }
+
+  protected:
+    U64 mCurrent;
+    U64 mNextTransaction;
+
+    // the current transaction has had a data access
+    bool mHadAccess;
 };
 
 struct RVSWDRequestFrame : public Frame
 {
-    // mData1 contains addr, mData2 contains the register enum
+    // mData1 contains the request byte in the low byte and the SELECT value the register
+    // was resolved with in the high word, mData2 contains the register enum
 
     // mFlag
     enum
@@ -146,6 +438,10 @@ struct RVSWDRequestFrame : public Frame
     {
         mData1 = request_byte;
     }
+    U8 GetRequestByte() const
+    {
+        return U8( mData1 );
+    }
 
     U8 GetAddr() const
     {
@@ -164,6 +460,16 @@ struct RVSWDRequestFrame : public Frame
         return !IsAccessPort();
     }
 
+    // set the request byte first, it clears this
+    void SetSelect( U32 select_reg )
+    {
+        mData1 = ( mData1 & 0xff ) | U64( select_reg ) << 32;
+    }
+    U32 GetSelect() const
+    {
+        return U32( mData1 >> 32 );
+    }
+
     void SetRegister( RVSWDRegisters reg )
     {
         mData2 = reg;
@@ -172,43 +478,7 @@ struct RVSWDRequestFrame : public Frame
     {
         return RVSWDRegisters( mData2 );
     }
-    std::string GetRegisterName() const;
-};
-
-class RVSWDAnalyzer;
-
-// This object parses and buffers the bits of the SWD stream.
-// IsOperation and IsLineReset return true if the subsequent bits in
-// the stream are a valid operation or line reset.
-class RVSWDParser
-{
-  private:
-    AnalyzerChannelData* mDIO;
-    AnalyzerChannelData* mCLK;
-
-    RVSWDAnalyzer* mAnalyzer;
-
-    std::vector<RVSWDBit> mBitsBuffer;
-    U32 mSelectRegister;
-
-    RVSWDBit ParseBit();
-    void BufferBits( size_t num_bits );
-
-  public:
-    RVSWDParser();
-
-    void Setup( AnalyzerChannelData* pDIO, AnalyzerChannelData* pCLK, RVSWDAnalyzer* pAnalyzer );
-
-    void Clear()
-    {
-        mBitsBuffer.clear();
-        mSelectRegister = 0;
-    }
-
-    bool IsOperation( RVSWDOperation& tran );
-    bool IsLineReset( RVSWDLineReset& reset );
-
-    RVSWDBit PopFrontBit();
+    const char* GetRegisterName() const;
 };
 
 #endif // RVSWD_TYPES_H
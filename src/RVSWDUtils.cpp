@@ -1,220 +1,264 @@
+#ifdef RVSWD_HEADLESS
+#include <cstdio>
+#else
 #include <AnalyzerHelpers.h>
+#endif
+
+#include <cstring>
 
 #include "RVSWDUtils.h"
+#include "RVSWDNumberFormat.h"
 #include "RVSWDTypes.h"
 
-std::string GetRegisterName( RVSWDRegisters reg )
+// the values of a field's enum, indexed by the field's value
+static const char* const CTRL_STAT_TRNMODE[] = { "Normal", "Pushed verify", "Pushed compare", "Reserved" };
+static const char* const WCR_PRESCALER[] = { "Asynchronous", "Synchronous", "Reserved", "Reserved" };
+static const char* const IDR_CLASS[] = { "This AP is not a Memory Acces Port", "This AP is a Memory Acces Port" };
+static const char* const CSW_ADDRINC[] = { "Auto-increment off", "Increment single", "Increment packed", "Reserved" };
+static const char* const CSW_SIZE[] = { "Byte (8 bits)", "Halfword (16 bits)", "Word (32 bits)", "Reserved", "Reserved", "Reserved", "Reserved", "Reserved" };
+static const char* const CFG_BE[] = { "Little-endian", "Big-endian" };
+static const char* const BASE_ENTRY_PRESENT[] = { "No debug entry present", "Debug entry present" };
+
+// the fields of the registers, in the order they're shown
+static constexpr RVSWDRegisterField IDCODE_FIELDS[] = {
+    { "DESIGNER", 0, 12, RVSWDFF_Number, NULL, NULL },
+    { "PARTNO", 12, 16, RVSWDFF_Number, NULL, NULL },
+    { "Version", 28, 4, RVSWDFF_Number, NULL, NULL },
+};
+
+static constexpr RVSWDRegisterField ABORT_FIELDS[] = {
+    { "ORUNERRCLR", 4, 1, RVSWDFF_Bit, NULL, NULL }, { "WDERRCLR", 3, 1, RVSWDFF_Bit, NULL, NULL },
+    { "STKERRCLR", 2, 1, RVSWDFF_Bit, NULL, NULL },  { "STKCMPCLR", 1, 1, RVSWDFF_Bit, NULL, NULL },
+    { "DAPABORT", 0, 1, RVSWDFF_Bit, NULL, NULL },
+};
+
+static constexpr RVSWDRegisterField CTRL_STAT_FIELDS[] = {
+    { "CSYSPWRUPACK", 31, 1, RVSWDFF_Bit, NULL, NULL },
+    { "CSYSPWRUPREQ", 30, 1, RVSWDFF_Bit, NULL, NULL },
+    { "CDBGPWRUPACK", 29, 1, RVSWDFF_Bit, NULL, NULL },
+    { "CDBGPWRUPREQ", 28, 1, RVSWDFF_Bit, NULL, NULL },
+    { "CDBGRSTACK", 27, 1, RVSWDFF_Bit, NULL, NULL },
+    { "CDBGRSTREQ", 26, 1, RVSWDFF_Bit, NULL, NULL },
+    { "TRNCNT", 12, 12, RVSWDFF_Number, NULL, NULL },
+    { "MASKLANE", 8, 4, RVSWDFF_Number, NULL, NULL },
+    { "WDATAERR", 7, 1, RVSWDFF_Bit, NULL, NULL },
+    { "READOK", 6, 1, RVSWDFF_Bit, NULL, NULL },
+    { "STICKYERR", 5, 1, RVSWDFF_Bit, NULL, NULL },
+    { "STICKYCMP", 4, 1, RVSWDFF_Bit, NULL, NULL },
+    { "TRNMODE", 2, 2, RVSWDFF_Enum, CTRL_STAT_TRNMODE, NULL },
+    { "STICKYORUN", 1, 1, RVSWDFF_Bit, NULL, NULL },
+    { "ORUNDETECT", 0, 1, RVSWDFF_Bit, NULL, NULL },
+};
+
+// the prescaler has always been shown right after WIREMODE, without a name
+static constexpr RVSWDRegisterField WCR_FIELDS[] = {
+    { "TURNAROUND", 8, 2, RVSWDFF_Number, NULL, " data period(s)" },
+    { "WIREMODE", 4, 4, RVSWDFF_Number, NULL, NULL },
+    { NULL, 6, 2, RVSWDFF_Enum, WCR_PRESCALER, NULL },
+};
+
+static constexpr RVSWDRegisterField SELECT_FIELDS[] = {
+    { "APSEL", 24, 8, RVSWDFF_Number, NULL, NULL },
+    { "APBANKSEL", 4, 4, RVSWDFF_Number, NULL, NULL },
+    { "PRESCALER", 0, 2, RVSWDFF_Number, NULL, NULL },
+};
+
+static constexpr RVSWDRegisterField IDR_FIELDS[] = {
+    { "Revision", 28, 4, RVSWDFF_Number, NULL, NULL },
+    { "JEP-106 continuation", 24, 4, RVSWDFF_Number, NULL, NULL },
+    { "JEP-106 identity", 17, 7, RVSWDFF_Number, NULL, NULL },
+    { "Class", 16, 1, RVSWDFF_Enum, IDR_CLASS, NULL },
+    { "AP Identfication", 0, 8, RVSWDFF_Number, NULL, NULL },
+};
+
+static constexpr RVSWDRegisterField CSW_FIELDS[] = {
+    { "DbgSwEnable", 31, 1, RVSWDFF_Bit, NULL, NULL },
+    { "Prot", 24, 7, RVSWDFF_Number, NULL, NULL },
+    { "SPIDEN", 23, 1, RVSWDFF_Bit, NULL, NULL },
+    { "Mode", 8, 4, RVSWDFF_Number, NULL, NULL },
+    { "TrInProg", 7, 1, RVSWDFF_Bit, NULL, NULL },
+    { "DeviceEn", 6, 1, RVSWDFF_Bit, NULL, NULL },
+    { "AddrInc", 4, 2, RVSWDFF_Enum, CSW_ADDRINC, NULL },
+    { "Size", 0, 3, RVSWDFF_Enum, CSW_SIZE, NULL },
+};
+
+static constexpr RVSWDRegisterField CFG_FIELDS[] = {
+    { NULL, 0, 1, RVSWDFF_Enum, CFG_BE, NULL },
+};
+
+static constexpr RVSWDRegisterField BASE_FIELDS[] = {
+    { "BASEADDR", 12, 20, RVSWDFF_Number, NULL, NULL },
+    { "Format", 1, 1, RVSWDFF_Bit, NULL, NULL },
+    { "Entry present", 0, 1, RVSWDFF_Enum, BASE_ENTRY_PRESENT, NULL },
+};
+
+#define FIELDS( fields ) fields, sizeof( fields ) / sizeof( fields[ 0 ] )
+
+const RVSWDRegisterField* GetRegisterFields( RVSWDRegisters reg, size_t& num_fields )
 {
-    switch( reg )
+    struct RegisterFields
     {
-    case RVSWDR_DP_IDCODE:
-        return "IDCODE";
-    case RVSWDR_DP_ABORT:
-        return "ABORT";
-    case RVSWDR_DP_CTRL_STAT:
-        return "CTRL/STAT";
-    case RVSWDR_DP_WCR:
-        return "WCR";
-    case RVSWDR_DP_RESEND:
-        return "RESEND";
-    case RVSWDR_DP_SELECT:
-        return "SELECT";
-    case RVSWDR_DP_RDBUFF:
-        return "RDBUFF";
-    case RVSWDR_DP_ROUTESEL:
-        return "ROUTESEL";
-
-    case RVSWDR_AP_CSW:
-        return "CSW";
-    case RVSWDR_AP_TAR:
-        return "TAR";
-    case RVSWDR_AP_DRW:
-        return "DRW";
-    case RVSWDR_AP_BD0:
-        return "BD0";
-    case RVSWDR_AP_BD1:
-        return "BD1";
-    case RVSWDR_AP_BD2:
-        return "BD2";
-    case RVSWDR_AP_BD3:
-        return "BD3";
-    case RVSWDR_AP_CFG:
-        return "CFG";
-    case RVSWDR_AP_BASE:
-        return "BASE";
-    case RVSWDR_AP_RAZ_WI:
-        return "RAZ_WI";
-    case RVSWDR_AP_IDR:
-        return "IDR";
+        const RVSWDRegisterField* fields;
+        size_t num_fields;
+    };
+
+    // RESEND, RDBUFF, ROUTESEL, TAR, DRW and the banked registers are just data
+    static const RegisterFields registers[] = {
+        { NULL, 0 },                    // RVSWDR_undefined
+        { FIELDS( IDCODE_FIELDS ) },    // RVSWDR_DP_IDCODE
+        { FIELDS( ABORT_FIELDS ) },     // RVSWDR_DP_ABORT
+        { FIELDS( CTRL_STAT_FIELDS ) }, // RVSWDR_DP_CTRL_STAT
+        { FIELDS( WCR_FIELDS ) },       // RVSWDR_DP_WCR
+        { NULL, 0 },                    // RVSWDR_DP_RESEND
+        { FIELDS( SELECT_FIELDS ) },    // RVSWDR_DP_SELECT
+        { NULL, 0 },                    // RVSWDR_DP_RDBUFF
+        { NULL, 0 },                    // RVSWDR_DP_ROUTESEL
+        { FIELDS( CSW_FIELDS ) },       // RVSWDR_AP_CSW
+        { NULL, 0 },                    // RVSWDR_AP_TAR
+        { NULL, 0 },                    // RVSWDR_AP_DRW
+        { NULL, 0 },                    // RVSWDR_AP_BD0
+        { NULL, 0 },                    // RVSWDR_AP_BD1
+        { NULL, 0 },                    // RVSWDR_AP_BD2
+        { NULL, 0 },                    // RVSWDR_AP_BD3
+        { FIELDS( CFG_FIELDS ) },       // RVSWDR_AP_CFG
+        { FIELDS( BASE_FIELDS ) },      // RVSWDR_AP_BASE
+        { NULL, 0 },                    // RVSWDR_AP_RAZ_WI
+        { FIELDS( IDR_FIELDS ) },       // RVSWDR_AP_IDR
+    };
+
+    static_assert( sizeof( registers ) / sizeof( registers[ 0 ] ) == RVSWDR_AP_IDR + 1, "a field table for every register" );
+
+    if( size_t( reg ) >= sizeof( registers ) / sizeof( registers[ 0 ] ) )
+    {
+        num_fields = 0;
+        return NULL;
     }
 
-    return "??";
+    num_fields = registers[ reg ].num_fields;
+    return registers[ reg ].fields;
 }
 
-std::string GetRegisterValueDesc( RVSWDRegisters reg, U32 val, DisplayBase display_base )
+#undef FIELDS
+
+// appends to a fixed buffer, and drops what doesn't fit
+struct RVSWDTextWriter
 {
-    std::string ret_val;
+    char* buf;
+    size_t size;
+    size_t len;
 
-    switch( reg )
+    void Append( const char* str )
     {
-    case RVSWDR_DP_IDCODE:
-        ret_val = "DESIGNER=" + int2str_sal( val & 0xfff, display_base, 12 );
-        ret_val += ", PARTNO=" + int2str_sal( ( val >> 12 ) & 0xffff, display_base, 16 );
-        ret_val += ", Version=" + int2str_sal( ( val >> 28 ) & 0xf, display_base, 4 );
-        break;
-    case RVSWDR_DP_ABORT:
-        ret_val = std::string( "ORUNERRCLR=" ) + ( ( val & 16 ) ? "1" : "0" );
-        ret_val += std::string( ", WDERRCLR=" ) + ( ( val & 8 ) ? "1" : "0" );
-        ret_val += std::string( ", STKERRCLR=" ) + ( ( val & 4 ) ? "1" : "0" );
-        ret_val += std::string( ", STKCMPCLR=" ) + ( ( val & 2 ) ? "1" : "0" );
-        ret_val += std::string( ", DAPABORT=" ) + ( ( val & 1 ) ? "1" : "0" );
-        break;
-
-    case RVSWDR_DP_CTRL_STAT:
-        ret_val = std::string( "CSYSPWRUPACK=" ) + ( ( val & ( 1 << 31 ) ) ? "1" : "0" );
-        ret_val += std::string( ", CSYSPWRUPREQ=" ) + ( ( val & ( 1 << 30 ) ) ? "1" : "0" );
-        ret_val += std::string( ", CDBGPWRUPACK=" ) + ( ( val & ( 1 << 29 ) ) ? "1" : "0" );
-        ret_val += std::string( ", CDBGPWRUPREQ=" ) + ( ( val & ( 1 << 28 ) ) ? "1" : "0" );
-        ret_val += std::string( ", CDBGRSTACK=" ) + ( ( val & ( 1 << 27 ) ) ? "1" : "0" );
-        ret_val += std::string( ", CDBGRSTREQ=" ) + ( ( val & ( 1 << 26 ) ) ? "1" : "0" );
-        ret_val += ", TRNCNT=" + int2str_sal( ( val >> 12 ) & 0xfff, display_base, 12 );
-        ret_val += ", MASKLANE=" + int2str_sal( ( val >> 8 ) & 0xf, display_base, 4 );
-        ret_val += std::string( ", WDATAERR=" ) + ( ( val & ( 1 << 7 ) ) ? "1" : "0" );
-        ret_val += std::string( ", READOK=" ) + ( ( val & ( 1 << 6 ) ) ? "1" : "0" );
-        ret_val += std::string( ", STICKYERR=" ) + ( ( val & ( 1 << 5 ) ) ? "1" : "0" );
-        ret_val += std::string( ", STICKYCMP=" ) + ( ( val & ( 1 << 4 ) ) ? "1" : "0" );
-        ret_val += ", TRNMODE=";
-        switch( ( val >> 2 ) & 3 )
-        {
-        case 0:
-            ret_val += "Normal";
-            break;
-        case 1:
-            ret_val += "Pushed verify";
-            break;
-        case 2:
-            ret_val += "Pushed compare";
-            break;
-        case 3:
-            ret_val += "Reserved";
-            break;
-        }
-        ret_val += std::string( ", STICKYORUN=" ) + ( ( val & ( 1 << 1 ) ) ? "1" : "0" );
-        ret_val += std::string( ", ORUNDETECT=" ) + ( ( val & ( 1 << 0 ) ) ? "1" : "0" );
-        break;
-    case RVSWDR_DP_WCR:
-        ret_val = "TURNAROUND=" + int2str_sal( ( val >> 8 ) & 3, display_base, 2 ) + " data period(s)";
-        ret_val += ", WIREMODE=" + int2str_sal( ( val >> 4 ) & 0xf, display_base, 4 );
-        switch( ( val >> 6 ) & 3 )
-        {
-        case 0:
-            ret_val += "Asynchronous";
-            break;
-        case 1:
-            ret_val += "Synchronous";
-            break;
-        default:
-            ret_val += "Reserved";
-            break;
-        }
-        break;
-    // case SWDR_DP_RESEND:		break;		// just raw data
-    case RVSWDR_DP_SELECT:
-        ret_val = "APSEL=" + int2str_sal( ( val >> 24 ) & 0xff, display_base );
-        ret_val += ", APBANKSEL=" + int2str_sal( ( val >> 4 ) & 0xf, display_base, 4 );
-        ret_val += ", PRESCALER=" + int2str_sal( val & 0x3, display_base, 2 );
-        break;
-    // case SWDR_DP_RDBUFF:		break;		// just raw data
-    // case SWDR_DP_ROUTESEL:		break;		// just raw data
-
-    // AP
-    case RVSWDR_AP_IDR:
-        ret_val = "Revision=" + int2str_sal( val >> 28, display_base, 4 );
-        ret_val += ", JEP-106 continuation=" + int2str_sal( ( val >> 24 ) & 0xf, display_base, 4 );
-        ret_val += ", JEP-106 identity=" + int2str_sal( ( val >> 17 ) & 0x7f, display_base, 7 );
-        ret_val +=
-            std::string( ", Class=" ) + ( ( val & ( 1 << 16 ) ) ? "This AP is a Memory Acces Port" : "This AP is not a Memory Acces Port" );
-        ret_val += ", AP Identfication=" + int2str_sal( val & 0xff, display_base );
-        break;
-    case RVSWDR_AP_CSW:
-        ret_val = std::string( "DbgSwEnable=" ) + ( ( val & ( 1 << 31 ) ) ? "1" : "0" );
-        ret_val += ", Prot=" + int2str_sal( ( val >> 24 ) & 0x7f, display_base, 7 );
-        ret_val += std::string( ", SPIDEN=" ) + ( ( val & ( 1 << 23 ) ) ? "1" : "0" );
-        ret_val += ", Mode=" + int2str_sal( ( val >> 8 ) & 0xf, display_base, 4 );
-        ret_val += std::string( ", TrInProg=" ) + ( ( val & ( 1 << 7 ) ) ? "1" : "0" );
-        ret_val += std::string( ", DeviceEn=" ) + ( ( val & ( 1 << 6 ) ) ? "1" : "0" );
-        ret_val += ", AddrInc=";
-        switch( ( val >> 4 ) & 0x3 )
-        {
-        case 0:
-            ret_val += "Auto-increment off";
-            break;
-        case 1:
-            ret_val += "Increment single";
-            break;
-        case 2:
-            ret_val += "Increment packed";
-            break;
-        case 3:
-            ret_val += "Reserved";
-            break;
-        }
-        ret_val += ", Size=";
-        switch( val & 0x7 )
+        while( *str != '\0' && len + 1 < size )
+            buf[ len++ ] = *str++;
+        buf[ len ] = '\0';
+    }
+
+    void AppendNumber( U64 val, DisplayBase display_base, int max_bits )
+    {
+        len += FormatNumber( val, display_base, max_bits, buf + len, size - len );
+    }
+};
+
+size_t FormatRegisterValue( RVSWDRegisters reg, U32 val, DisplayBase display_base, char* buf, size_t size )
+{
+    if( size == 0 )
+        return 0;
+
+    RVSWDTextWriter out = { buf, size, 0 };
+    buf[ 0 ] = '\0';
+
+    size_t num_fields;
+    const RVSWDRegisterField* fields = GetRegisterFields( reg, num_fields );
+    for( size_t ndx = 0; ndx < num_fields; ++ndx )
+    {
+        const RVSWDRegisterField& field( fields[ ndx ] );
+        U32 field_val = ( val >> field.offset ) & ( field.width < 32 ? ( 1u << field.width ) - 1 : ~0u );
+
+        // a field without a name only shows its value's label, right after the field before it
+        if( field.name != NULL )
         {
-        case 0:
-            ret_val += "Byte (8 bits)";
-            break;
-        case 1:
-            ret_val += "Halfword (16 bits)";
-            break;
-        case 2:
-            ret_val += "Word (32 bits)";
-            break;
-        default:
-            ret_val += "Reserved";
-            break;
+            if( ndx != 0 )
+                out.Append( ", " );
+            out.Append( field.name );
+            out.Append( "=" );
         }
 
-        break;
-    // case SWDR_AP_TAR:			break;		// these are just raw data
-    // case SWDR_AP_DRW:			break;
-    // case SWDR_AP_BD0:			break;
-    // case SWDR_AP_BD1:			break;
-    // case SWDR_AP_BD2:			break;
-    // case SWDR_AP_BD3:			break;
-    case RVSWDR_AP_CFG:
-        if( val & 1 )
-            ret_val = "Big-endian";
-        else
-            ret_val = "Little-endian";
-
-        break;
-    case RVSWDR_AP_BASE:
-        ret_val += "BASEADDR=" + int2str_sal( val >> 12, display_base, 20 );
-        ret_val += std::string( ", Format=" ) + ( ( val & ( 1 << 1 ) ) ? "1" : "0" );
-        ret_val += ", Entry present=";
-        if( val & 1 )
-            ret_val += "Debug entry present";
+        if( field.format == RVSWDFF_Bit )
+            out.Append( field_val ? "1" : "0" );
+        else if( field.format == RVSWDFF_Enum )
+            out.Append( field.labels[ field_val ] );
         else
-            ret_val += "No debug entry present";
+            out.AppendNumber( field_val, display_base, field.width );
 
-        break;
+        if( field.suffix != NULL )
+            out.Append( field.suffix );
     }
 
-    return ret_val;
+    return out.len;
+}
+
+std::string GetRegisterValueDesc( RVSWDRegisters reg, U32 val, DisplayBase display_base )
+{
+    char desc[ REGISTER_DESC_SIZE ];
+    FormatRegisterValue( reg, val, display_base, desc, sizeof( desc ) );
+
+    return desc;
 }
 
 std::string int2str( const U8 i )
 {
-    char number_str[ 8 ];
-    AnalyzerHelpers::GetNumberString( i, Decimal, 8, number_str, sizeof( number_str ) );
-    return number_str;
+    return int2str_sal( i, Decimal, 8 );
+}
+
+void FormatNumberReference( U64 i, DisplayBase base, int max_bits, char* number_str, size_t size )
+{
+    if( size == 0 )
+        return;
+
+#ifdef RVSWD_HEADLESS
+    // without the SDK we format hex, binary and decimal ourselves
+    U64 val = max_bits < 64 ? i & ( ( U64( 1 ) << max_bits ) - 1 ) : i;
+    if( base == Hexadecimal )
+    {
+        snprintf( number_str, size, "0x%0*llX", ( max_bits + 3 ) / 4, val );
+    }
+    else if( base == Binary )
+    {
+        size_t ndx = 0;
+        if( ndx + 1 < size )
+            number_str[ ndx++ ] = '0';
+        if( ndx + 1 < size )
+            number_str[ ndx++ ] = 'b';
+        for( int bit = max_bits - 1; bit >= 0 && ndx + 1 < size; --bit )
+            number_str[ ndx++ ] = ( ( val >> bit ) & 1 ) ? '1' : '0';
+        number_str[ ndx ] = '\0';
+    }
+    else
+    {
+        snprintf( number_str, size, "%llu", val );
+    }
+#else
+    AnalyzerHelpers::GetNumberString( i, base, max_bits, number_str, U32( size ) );
+#endif
+}
+
+size_t FormatNumber( U64 i, DisplayBase base, int max_bits, char* number_str, size_t size )
+{
+    if( size == 0 )
+        return 0;
+
+    if( size >= NUMBER_STR_SIZE && max_bits >= 1 && max_bits <= 64 && IsFastNumberBase( base ) )
+        return FormatNumberFast( i, base, U32( max_bits ), number_str );
+
+    FormatNumberReference( i, base, max_bits, number_str, size );
+    return strlen( number_str );
 }
 
 std::string int2str_sal( const U64 i, DisplayBase base, const int max_bits )
 {
     char number_str[ 256 ];
-    AnalyzerHelpers::GetNumberString( i, base, max_bits, number_str, sizeof( number_str ) );
+    FormatNumber( i, base, max_bits, number_str, sizeof( number_str ) );
+
     return number_str;
 }
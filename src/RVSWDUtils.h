@@ -4,21 +4,94 @@
 #include <windows.h>
 #endif
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include <string>
-#include <LogicPublicTypes.h>
 
 #include "RVSWDTypes.h"
 
-// returns string descriptions of the register name and the bits with values
-std::string GetRegisterName( RVSWDRegisters reg );
+// how a register field's value is shown
+enum RVSWDFieldFormat
+{
+    RVSWDFF_Bit,    // 1 or 0
+    RVSWDFF_Number, // in the display base, with the field's width
+    RVSWDFF_Enum,   // the label of the value
+};
+
+// a field of a register, as shown in the register's description
+struct RVSWDRegisterField
+{
+    const char* name; // NULL to only show the label, right after the field before
+    U8 offset;
+    U8 width;
+    RVSWDFieldFormat format;
+    const char* const* labels; // RVSWDFF_Enum, one for each of the 1 << width values
+    const char* suffix;        // shown after the value, or NULL
+};
+
+enum
+{
+    REGISTER_DESC_SIZE = 512, // fits the longest description, with the numbers in binary
+};
+
+// returns the register's fields in the order they're shown, NULL for a register that's just data
+const RVSWDRegisterField* GetRegisterFields( RVSWDRegisters reg, size_t& num_fields );
+
+// Writes the description of the register's fields with their values to buf, and returns
+// its length. It's cut short if it doesn't fit, and empty for a register that's just data.
+size_t FormatRegisterValue( RVSWDRegisters reg, U32 val, DisplayBase display_base, char* buf, size_t size );
+
+// returns string descriptions of the register bits with values
 std::string GetRegisterValueDesc( RVSWDRegisters reg, U32 val, DisplayBase display_base );
 
+// Formats the number in the display base into number_str, like AnalyzerHelpers::GetNumberString,
+// and returns its length. It's FormatNumberFast for binary, decimal and hex when there's room for
+// it, and the SDK for ASCII and AsciiHex.
+size_t FormatNumber( U64 i, DisplayBase base, int max_bits, char* number_str, size_t size );
+
+// AnalyzerHelpers::GetNumberString, or what the headless build has instead of it
+void FormatNumberReference( U64 i, DisplayBase base, int max_bits, char* number_str, size_t size );
+
 std::string int2str_sal( const U64 i, DisplayBase base, const int max_bits = 8 );
 inline std::string int2str( const U64 i )
 {
     return int2str_sal( i, Decimal, 64 );
 }
 
+// bit twiddling helpers for the packed bit window
+inline int PopCount( U64 val )
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+    return __builtin_popcountll( val );
+#elif defined( _MSC_VER ) && defined( _M_X64 )
+    return int( __popcnt64( val ) );
+#else
+    int cnt = 0;
+    for( ; val != 0; val &= val - 1 )
+        ++cnt;
+    return cnt;
+#endif
+}
+
+// val must not be 0
+inline int CountTrailingZeros( U64 val )
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+    return __builtin_ctzll( val );
+#elif defined( _MSC_VER ) && defined( _M_X64 )
+    unsigned long ndx;
+    _BitScanForward64( &ndx, val );
+    return int( ndx );
+#else
+    int cnt = 0;
+    for( ; ( val & 1 ) == 0; val >>= 1 )
+        ++cnt;
+    return cnt;
+#endif
+}
+
 /*
 // debugging helper functions -- Windows only!!!
 inline void debug(const std::string& str)
@@ -0,0 +1,229 @@
+// Compares FormatNumberFast with AnalyzerHelpers::GetNumberString, which it has to match
+// byte for byte, for every value of every width the analyzer formats numbers with, and
+// then times both. It links the Analyzer SDK, and checks one base a run:
+//
+//   rvswd_number_format_test binary|decimal|hex|time
+//
+// time compares FormatSampleTime with AnalyzerHelpers::GetTimeString instead, cut the way
+// the export cuts it, before, at and long after the trigger, at a few sample rates.
+//
+// The 32 bit width alone is 4G values, so a base takes a while. ctest has a test for each
+// base, run them with ctest -j3. The 64 bit width, which the analyzer only uses for counts,
+// can't be checked value by value: it gets the values around every power of two and of ten,
+// and a few million random ones.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+#include <AnalyzerHelpers.h>
+
+#include "RVSWDNumberFormat.h"
+#include "RVSWDTextExport.h"
+
+// the widths of the register fields, the request byte and the data
+static const U32 WIDTHS[] = { 2, 4, 7, 8, 12, 16, 20, 32 };
+
+static U64 gNumChecked = 0;
+
+static bool Check( U64 val, DisplayBase display_base, U32 num_bits )
+{
+    char fast[ NUMBER_STR_SIZE ];
+    char sdk[ 256 ];
+    FormatNumberFast( val, display_base, num_bits, fast );
+    AnalyzerHelpers::GetNumberString( val, display_base, num_bits, sdk, sizeof( sdk ) );
+
+    ++gNumChecked;
+    if( strcmp( fast, sdk ) == 0 )
+        return true;
+
+    fprintf( stderr, "0x%llX with %u bits: \"%s\", the SDK has \"%s\"\n", val, num_bits, fast, sdk );
+    return false;
+}
+
+static bool CheckWidth( DisplayBase display_base, U32 num_bits )
+{
+    U64 mask = ( U64( 1 ) << num_bits ) - 1;
+    for( U64 val = 0; val <= mask; ++val )
+    {
+        if( !Check( val, display_base, num_bits ) )
+            return false;
+    }
+
+    // and the bits above the width are left out
+    for( U32 bit = num_bits; bit < 64; ++bit )
+    {
+        if( !Check( U64( 1 ) << bit | 1, display_base, num_bits ) || !Check( ~mask, display_base, num_bits ) )
+            return false;
+    }
+
+    return true;
+}
+
+static bool Check64( DisplayBase display_base )
+{
+    for( U32 bit = 0; bit < 64; ++bit )
+    {
+        U64 val = U64( 1 ) << bit;
+        if( !Check( val - 1, display_base, 64 ) || !Check( val, display_base, 64 ) || !Check( val + 1, display_base, 64 ) )
+            return false;
+    }
+
+    U64 power = 1;
+    for( U32 digits = 0; digits < 20; ++digits, power *= 10 )
+    {
+        if( !Check( power - 1, display_base, 64 ) || !Check( power, display_base, 64 ) || !Check( power + 1, display_base, 64 ) )
+            return false;
+    }
+
+    if( !Check( ~U64( 0 ), display_base, 64 ) )
+        return false;
+
+    U64 val = 1;
+    for( U32 ndx = 0; ndx < ( 1 << 24 ); ++ndx )
+    {
+        val = val * 6364136223846793005ull + 1442695040888963407ull;
+        if( !Check( val >> ( ndx & 63 ), display_base, 64 ) )
+            return false;
+    }
+
+    return true;
+}
+
+static bool CheckTime( U64 sample, U64 trigger_sample, U32 sample_rate )
+{
+    char fast[ TIME_STR_SIZE ];
+    char sdk[ 128 ];
+    FormatSampleTime( S64( sample ), trigger_sample, sample_rate, fast );
+    AnalyzerHelpers::GetTimeString( sample, trigger_sample, sample_rate, sdk, sizeof( sdk ) );
+
+    // the export leaves out the last 7 digits
+    size_t len = strlen( sdk );
+    if( len > 7 )
+        sdk[ len - 7 ] = '\0';
+
+    ++gNumChecked;
+    if( strcmp( fast, sdk ) == 0 )
+        return true;
+
+    fprintf( stderr, "sample %llu, trigger %llu at %u Hz: \"%s\", the SDK has \"%s\"\n", sample, trigger_sample, sample_rate, fast, sdk );
+    return false;
+}
+
+static bool CheckTimes()
+{
+    static const U32 RATES[] = { 1000000, 12000000, 24000000, 100000000, 500000000, 3125000, 4000000000u };
+    static const U64 TRIGGERS[] = { 0, 1, 1000000007, U64( 1 ) << 40 };
+
+    for( size_t rndx = 0; rndx < sizeof( RATES ) / sizeof( RATES[ 0 ] ); ++rndx )
+    {
+        U32 rate = RATES[ rndx ];
+        for( size_t tndx = 0; tndx < sizeof( TRIGGERS ) / sizeof( TRIGGERS[ 0 ] ); ++tndx )
+        {
+            U64 trigger = TRIGGERS[ tndx ];
+
+            // up to a second around the trigger, sample by sample at the slow rates
+            U64 near = std::min<U64>( rate, 1 << 20 );
+            for( U64 offset = 0; offset <= near; ++offset )
+            {
+                if( !CheckTime( trigger + offset, trigger, rate ) || offset <= trigger && !CheckTime( trigger - offset, trigger, rate ) )
+                    return false;
+            }
+
+            // and the offsets of days of capture, after the trigger and, where there's room, before it
+            U64 val = 1;
+            for( U32 ndx = 0; ndx < ( 1 << 16 ); ++ndx )
+            {
+                val = val * 6364136223846793005ull + 1442695040888963407ull;
+                U64 offset = ( val >> 16 ) % ( U64( rate ) * 86400 * 7 );
+                if( !CheckTime( trigger + offset, trigger, rate ) || offset <= trigger && !CheckTime( trigger - offset, trigger, rate ) )
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// the time a number takes, with the widths mixed
+static void Benchmark( DisplayBase display_base )
+{
+    const U32 NUM_VALUES = 1 << 22;
+
+    // the lengths are added up to keep the calls from being optimized away
+    size_t total_length = 0;
+    double seconds[ 2 ];
+    for( int fast = 0; fast < 2; ++fast )
+    {
+        std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+
+        char number_str[ 256 ];
+        U64 val = 1;
+        for( U32 ndx = 0; ndx < NUM_VALUES; ++ndx )
+        {
+            val = val * 6364136223846793005ull + 1442695040888963407ull;
+            U32 num_bits = WIDTHS[ ndx % ( sizeof( WIDTHS ) / sizeof( WIDTHS[ 0 ] ) ) ];
+            if( fast )
+            {
+                total_length += FormatNumberFast( val >> 32, display_base, num_bits, number_str );
+            }
+            else
+            {
+                AnalyzerHelpers::GetNumberString( val >> 32, display_base, num_bits, number_str, sizeof( number_str ) );
+                total_length += strlen( number_str );
+            }
+        }
+
+        seconds[ fast ] = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    }
+
+    printf( "GetNumberString %.1f ns, FormatNumberFast %.1f ns per number, %llu characters\n", seconds[ 0 ] * 1e9 / NUM_VALUES,
+            seconds[ 1 ] * 1e9 / NUM_VALUES, U64( total_length ) );
+}
+
+int main( int argc, char* argv[] )
+{
+    std::string base_name( argc == 2 ? argv[ 1 ] : "" );
+
+    if( base_name == "time" )
+    {
+        if( !CheckTimes() )
+            return 1;
+
+        printf( "time: %llu times match the SDK\n", gNumChecked );
+        return 0;
+    }
+
+    DisplayBase display_base;
+    if( base_name == "binary" )
+        display_base = Binary;
+    else if( base_name == "decimal" )
+        display_base = Decimal;
+    else if( base_name == "hex" )
+        display_base = Hexadecimal;
+    else
+    {
+        fprintf( stderr, "usage: rvswd_number_format_test binary|decimal|hex|time\n" );
+        return 2;
+    }
+
+    std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+
+    for( size_t ndx = 0; ndx < sizeof( WIDTHS ) / sizeof( WIDTHS[ 0 ] ); ++ndx )
+    {
+        if( !CheckWidth( display_base, WIDTHS[ ndx ] ) )
+            return 1;
+    }
+
+    if( !Check64( display_base ) )
+        return 1;
+
+    printf( "%s: %llu numbers match the SDK, in %.0f s\n", base_name.c_str(), gNumChecked,
+            std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() );
+
+    Benchmark( display_base );
+
+    return 0;
+}